@@ -0,0 +1,183 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <string.h>
+
+#include "HttpException.h"
+#include "ChunkedDecoder.h"
+
+#define MAX_CHUNK_LINE_LENGTH 4096 // chunk extension or trailer field
+
+namespace ngrest {
+
+void ChunkedDecoder::reset(uint64_t maxBodySize_)
+{
+    state = State::Size;
+    chunkRemaining = 0;
+    bodySize = 0;
+    maxBodySize = maxBodySize_;
+    lineLength = 0;
+    hasSize = false;
+}
+
+uint64_t ChunkedDecoder::decode(char* buffer, uint64_t size, uint64_t& decodedSize)
+{
+    const char* curr = buffer;
+    const char* end = buffer + size;
+    char* out = buffer;
+
+    while (curr < end && state != State::Done) {
+        switch (state) {
+        case State::Size: {
+            const char ch = *curr;
+            int digit;
+            if (ch >= '0' && ch <= '9') {
+                digit = ch - '0';
+            } else if (ch >= 'a' && ch <= 'f') {
+                digit = ch - 'a' + 10;
+            } else if (ch >= 'A' && ch <= 'F') {
+                digit = ch - 'A' + 10;
+            } else {
+                NGREST_ASSERT_HTTP(hasSize, HTTP_STATUS_400_BAD_REQUEST, "Invalid chunk size");
+                if (ch == ';' || ch == ' ' || ch == '\t') {
+                    state = State::Extension;
+                    lineLength = 0;
+                } else {
+                    state = State::SizeLf;
+                    if (ch == '\r')
+                        ++curr;
+                }
+                break;
+            }
+            NGREST_ASSERT_HTTP(chunkRemaining <= ((maxBodySize - bodySize) >> 4), HTTP_STATUS_413_REQUEST_ENTITY_TOO_LARGE,
+                               "Request is too large");
+            chunkRemaining = (chunkRemaining << 4) | digit;
+            hasSize = true;
+            ++curr;
+            break;
+        }
+
+        case State::Extension: {
+            const char* lf = reinterpret_cast<const char*>(memchr(curr, '\n', end - curr));
+            lineLength += (lf ? lf : end) - curr;
+            NGREST_ASSERT_HTTP(lineLength <= MAX_CHUNK_LINE_LENGTH, HTTP_STATUS_400_BAD_REQUEST, "Chunk extension is too long");
+            curr = lf ? lf : end;
+            if (lf)
+                state = State::SizeLf;
+            break;
+        }
+
+        case State::SizeLf:
+            NGREST_ASSERT_HTTP(*curr == '\n', HTTP_STATUS_400_BAD_REQUEST, "Invalid chunk size line");
+            ++curr;
+            NGREST_ASSERT_HTTP(chunkRemaining <= (maxBodySize - bodySize), HTTP_STATUS_413_REQUEST_ENTITY_TOO_LARGE,
+                               "Request is too large");
+            hasSize = false;
+            if (chunkRemaining) {
+                state = State::Data;
+            } else {
+                state = State::Trailer; // last chunk
+            }
+            break;
+
+        case State::Data: {
+            const uint64_t available = static_cast<uint64_t>(end - curr);
+            const uint64_t dataSize = (chunkRemaining < available) ? chunkRemaining : available;
+            if (out != curr)
+                memmove(out, curr, dataSize);
+            out += dataSize;
+            curr += dataSize;
+            bodySize += dataSize;
+            chunkRemaining -= dataSize;
+            if (!chunkRemaining)
+                state = State::DataCr;
+            break;
+        }
+
+        case State::DataCr:
+            if (*curr == '\r') {
+                state = State::DataLf;
+                ++curr;
+                break;
+            }
+            state = State::DataLf;
+            // fall through
+
+        case State::DataLf:
+            NGREST_ASSERT_HTTP(*curr == '\n', HTTP_STATUS_400_BAD_REQUEST, "Invalid end of chunk data");
+            ++curr;
+            state = State::Size;
+            break;
+
+        case State::Trailer:
+            if (*curr == '\r') {
+                state = State::LastLf;
+                ++curr;
+            } else if (*curr == '\n') {
+                state = State::Done;
+                ++curr;
+            } else {
+                // trailer fields are not used
+                state = State::TrailerField;
+                lineLength = 0;
+            }
+            break;
+
+        case State::TrailerField: {
+            const char* lf = reinterpret_cast<const char*>(memchr(curr, '\n', end - curr));
+            lineLength += (lf ? lf : end) - curr;
+            NGREST_ASSERT_HTTP(lineLength <= MAX_CHUNK_LINE_LENGTH, HTTP_STATUS_400_BAD_REQUEST, "Trailer field is too long");
+            if (lf) {
+                curr = lf + 1;
+                state = State::Trailer;
+            } else {
+                curr = end;
+            }
+            break;
+        }
+
+        case State::LastLf:
+            NGREST_ASSERT_HTTP(*curr == '\n', HTTP_STATUS_400_BAD_REQUEST, "Invalid end of chunked body");
+            ++curr;
+            state = State::Done;
+            break;
+
+        case State::Done:
+            break;
+        }
+    }
+
+    decodedSize = static_cast<uint64_t>(out - buffer);
+    return static_cast<uint64_t>(curr - buffer);
+}
+
+uint64_t ChunkedDecoder::getRequiredSize() const
+{
+    switch (state) {
+    case State::Data:
+        return chunkRemaining + 1; // chunk data and LF
+    case State::Done:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+}
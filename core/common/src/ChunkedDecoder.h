@@ -0,0 +1,105 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_CHUNKEDDECODER_H
+#define NGREST_CHUNKEDDECODER_H
+
+#include <stdint.h>
+#include "ngrestcommonexport.h"
+
+namespace ngrest {
+
+/**
+ * @brief incremental decoder of HTTP body sent with chunked transfer coding.
+ * Body is decoded in place: chunk data is moved to the beginning of the buffer given,
+ * chunk size lines, chunk extensions and trailer fields are dropped.
+ * Decoder state is kept between calls, so body can be decoded by any pieces it's received.
+ */
+class NGREST_COMMON_EXPORT ChunkedDecoder
+{
+public:
+    /**
+     * @brief reset decoder to handle the next body
+     * @param maxBodySize maximum size of decoded body
+     */
+    void reset(uint64_t maxBodySize);
+
+    /**
+     * @brief decode next part of body in place
+     * @param buffer raw data received, decoded data is written to the beginning of this buffer
+     * @param size size of raw data
+     * @param decodedSize number of bytes of decoded data written
+     * @return number of bytes consumed. May be less than size only when the whole body is decoded,
+     *     the rest of data belongs to the next request
+     * @throws HttpException with status 400 if body is malformed or 413 if body is too large
+     */
+    uint64_t decode(char* buffer, uint64_t size, uint64_t& decodedSize);
+
+    /**
+     * @brief check whether the whole body is decoded
+     * @return true if last chunk and trailer is received
+     */
+    inline bool isDone() const
+    {
+        return state == State::Done;
+    }
+
+    /**
+     * @brief get total size of body decoded so far
+     * @return size of decoded body
+     */
+    inline uint64_t getBodySize() const
+    {
+        return bodySize;
+    }
+
+    /**
+     * @brief get minimum number of bytes required to complete the body.
+     * Reading no more than this number of bytes guarantees that data of the next request is not read
+     * @return number of bytes
+     */
+    uint64_t getRequiredSize() const;
+
+private:
+    enum class State
+    {
+        Size,
+        Extension,
+        SizeLf,
+        Data,
+        DataCr,
+        DataLf,
+        Trailer,
+        TrailerField,
+        LastLf,
+        Done
+    };
+
+    State state = State::Size;
+    uint64_t chunkRemaining = 0;
+    uint64_t bodySize = 0;
+    uint64_t maxBodySize = 0;
+    uint64_t lineLength = 0;
+    bool hasSize = false;
+};
+
+}
+
+#endif // NGREST_CHUNKEDDECODER_H
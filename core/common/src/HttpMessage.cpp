@@ -27,20 +27,51 @@ namespace ngrest {
 
 void HttpRequest::setMethod(const char* method)
 {
-    if (!strcmp(method, "POST")) {
-        this->method = HttpMethod::POST;
-    } else if (!strcmp(method, "GET")) {
-        this->method = HttpMethod::GET;
-    } else if (!strcmp(method, "PUT")) {
-        this->method = HttpMethod::PUT;
-    } else if (!strcmp(method, "DELETE")) {
-        this->method = HttpMethod::DELETE;
-    } else if (!strcmp(method, "PATCH")) {
-        this->method = HttpMethod::PATCH;
-    } else {
-        this->method = HttpMethod::UNKNOWN;
+    setMethod(method, strlen(method));
+}
+
+void HttpRequest::setMethod(const char* method, uint64_t length)
+{
+    HttpMethod result = HttpMethod::UNKNOWN;
+    switch (length) {
+    case 3:
+        if (!memcmp(method, "GET", 3)) {
+            result = HttpMethod::GET;
+        } else if (!memcmp(method, "PUT", 3)) {
+            result = HttpMethod::PUT;
+        }
+        break;
+    case 4:
+        if (!memcmp(method, "POST", 4))
+            result = HttpMethod::POST;
+        break;
+    case 5:
+        if (!memcmp(method, "PATCH", 5))
+            result = HttpMethod::PATCH;
+        break;
+    case 6:
+        if (!memcmp(method, "DELETE", 6))
+            result = HttpMethod::DELETE;
+        break;
+    default:;
     }
+
+    this->method = result;
     methodStr = method;
 }
 
+const char* HttpRequest::getClientHost() const
+{
+    if (!clientHost && clientAddress)
+        return clientAddress->getHost();
+    return clientHost;
+}
+
+const char* HttpRequest::getClientPort() const
+{
+    if (!clientPort && clientAddress)
+        return clientAddress->getPort();
+    return clientPort;
+}
+
 }
@@ -33,6 +33,27 @@ enum class ContentType {
     ApplicationJson
 };
 
+/**
+ * @brief address of client formatted on demand, as only a few requests need it
+ */
+class NGREST_COMMON_EXPORT ClientAddress
+{
+public:
+    virtual ~ClientAddress() {}
+
+    /**
+     * @brief get client host address
+     * @return host address or empty string if unknown
+     */
+    virtual const char* getHost() = 0;
+
+    /**
+     * @brief get client port
+     * @return port or empty string if unknown
+     */
+    virtual const char* getPort() = 0;
+};
+
 /**
  * @brief HTTP request
  */
@@ -41,12 +62,36 @@ struct NGREST_COMMON_EXPORT HttpRequest: public Request
     HttpMethod method = HttpMethod::UNKNOWN;   //!< parsed HTTP method
     const char* methodStr = nullptr;           //!< HTTP method as given by client
 
-    const char* clientHost = nullptr;          //!< client host address
-    const char* clientPort = nullptr;          //!< client port
+    const char* clientHost = nullptr;          //!< client host address, if known in advance
+    const char* clientPort = nullptr;          //!< client port, if known in advance
+    ClientAddress* clientAddress = nullptr;    //!< client address to format host and port from
 
     ContentType contentType = ContentType::NotSet; //!< request content type
 
+    /**
+     * @brief set method of request
+     * @param method method name as given by client
+     */
     void setMethod(const char* method);
+
+    /**
+     * @brief set method of request
+     * @param method method name as given by client, must be terminated by '\0'
+     * @param length length of method name
+     */
+    void setMethod(const char* method, uint64_t length);
+
+    /**
+     * @brief get client host address
+     * @return client host address or nullptr if unknown
+     */
+    const char* getClientHost() const;
+
+    /**
+     * @brief get client port
+     * @return client port or nullptr if unknown
+     */
+    const char* getClientPort() const;
 };
 
 
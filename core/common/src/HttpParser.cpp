@@ -0,0 +1,221 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <string.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <ngrest/utils/MemPool.h>
+
+#include "HttpException.h"
+#include "HttpMessage.h"
+#include "HttpParser.h"
+
+namespace ngrest {
+
+namespace {
+
+// characters allowed in token (RFC 7230) mapped to lower case, 0 - not allowed
+struct TokenTable
+{
+    char lower[256];
+
+    TokenTable()
+    {
+        memset(lower, 0, sizeof(lower));
+        for (int ch = '0'; ch <= '9'; ++ch)
+            lower[ch] = static_cast<char>(ch);
+        for (int ch = 'a'; ch <= 'z'; ++ch)
+            lower[ch] = static_cast<char>(ch);
+        for (int ch = 'A'; ch <= 'Z'; ++ch)
+            lower[ch] = static_cast<char>(ch - 'A' + 'a');
+        for (const char* ch = "!#$%&'*+-.^_`|~"; *ch; ++ch)
+            lower[static_cast<unsigned char>(*ch)] = *ch;
+    }
+};
+
+static const TokenTable tokenTable;
+
+// stops at control chars and DEL. URI also stops at space and HTAB, field value allows them
+template <bool isUri>
+inline bool isStopChar(unsigned char ch)
+{
+    return isUri ? (ch <= ' ' || ch == 0x7f)
+                 : ((ch < ' ' && ch != '\t') || ch == 0x7f);
+}
+
+template <bool isUri>
+inline const char* findStopChar(const char* curr, const char* end)
+{
+#if defined(__AVX2__)
+    const __m256i limit = _mm256_set1_epi8(isUri ? ' ' + 1 : ' ');
+    const __m256i minusOne = _mm256_set1_epi8(-1);
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i del = _mm256_set1_epi8(0x7f);
+    for (; (end - curr) >= 32; curr += 32) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(curr));
+        // comparison is signed, so chars >= 0x80 (obs-text) are not matched
+        __m256i match = _mm256_and_si256(_mm256_cmpgt_epi8(limit, block), _mm256_cmpgt_epi8(block, minusOne));
+        if (!isUri)
+            match = _mm256_andnot_si256(_mm256_cmpeq_epi8(block, tab), match);
+        match = _mm256_or_si256(match, _mm256_cmpeq_epi8(block, del));
+        const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(match));
+        if (mask)
+            return curr + __builtin_ctz(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i limit = _mm_set1_epi8(isUri ? ' ' + 1 : ' ');
+    const __m128i minusOne = _mm_set1_epi8(-1);
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i del = _mm_set1_epi8(0x7f);
+    for (; (end - curr) >= 16; curr += 16) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(curr));
+        // comparison is signed, so chars >= 0x80 (obs-text) are not matched
+        __m128i match = _mm_and_si128(_mm_cmplt_epi8(block, limit), _mm_cmpgt_epi8(block, minusOne));
+        if (!isUri)
+            match = _mm_andnot_si128(_mm_cmpeq_epi8(block, tab), match);
+        match = _mm_or_si128(match, _mm_cmpeq_epi8(block, del));
+        const int mask = _mm_movemask_epi8(match);
+        if (mask)
+            return curr + __builtin_ctz(mask);
+    }
+#endif
+
+    for (; curr < end; ++curr)
+        if (isStopChar<isUri>(static_cast<unsigned char>(*curr)))
+            return curr;
+    return end;
+}
+
+// skip CRLF or LF
+inline char* skipEol(char* curr, const char* end)
+{
+    if (curr < end && *curr == '\r')
+        ++curr;
+    NGREST_ASSERT_HTTP(curr < end && *curr == '\n', HTTP_STATUS_400_BAD_REQUEST, "Invalid end of line in HTTP header");
+    return curr + 1;
+}
+
+}
+
+uint64_t HttpParser::findHeaderEnd(const char* buffer, uint64_t size)
+{
+    // memchr is vectorized and selects the best instruction set at runtime
+    for (;;) {
+        const char* eol = (scanned < size)
+                ? reinterpret_cast<const char*>(memchr(buffer + scanned, '\n', size - scanned))
+                : nullptr;
+        if (!eol) {
+            scanned = size;
+            return 0;
+        }
+
+        const uint64_t pos = eol - buffer;
+        scanned = pos + 1;
+        // empty line: LF LF or LF CR LF; empty lines before request line are ignored
+        if (pos >= 2 && (buffer[pos - 1] == '\n' || (buffer[pos - 1] == '\r' && buffer[pos - 2] == '\n'))) {
+            const char* start = buffer;
+            while (start < eol && (*start == '\r' || *start == '\n'))
+                ++start;
+            if (start != eol)
+                return scanned;
+        }
+    }
+}
+
+uint8_t HttpParser::parse(char* buffer, uint64_t headerSize, HttpRequest* request, MemPool* pool)
+{
+    char* curr = buffer;
+    const char* end = buffer + headerSize;
+
+    // skip empty lines before request line
+    while (curr < end && (*curr == '\r' || *curr == '\n'))
+        ++curr;
+
+    // method
+    char* method = curr;
+    while (curr < end && tokenTable.lower[static_cast<unsigned char>(*curr)])
+        ++curr;
+    NGREST_ASSERT_HTTP(curr != method && curr < end && *curr == ' ', HTTP_STATUS_400_BAD_REQUEST, "Failed to get HTTP method");
+    *curr = '\0';
+    request->setMethod(method, curr - method);
+    ++curr;
+
+    // request URL
+    char* path = curr;
+    curr = const_cast<char*>(findStopChar<true>(curr, end));
+    NGREST_ASSERT_HTTP(curr != path && curr < end && *curr == ' ', HTTP_STATUS_400_BAD_REQUEST, "Failed to get request URL");
+    *curr = '\0';
+    request->path = path;
+    ++curr;
+
+    // version
+    NGREST_ASSERT_HTTP((end - curr) >= 8 && !memcmp(curr, "HTTP/", 5)
+                       && curr[5] >= '0' && curr[5] <= '9' && curr[6] == '.' && curr[7] >= '0' && curr[7] <= '9',
+                       HTTP_STATUS_400_BAD_REQUEST, "Invalid HTTP version");
+    const uint8_t httpVersion = static_cast<uint8_t>((curr[5] - '0') * 10 + (curr[7] - '0'));
+    curr = skipEol(curr + 8, end);
+
+    // header fields
+    Header* lastHeader = nullptr;
+    while (curr < end && *curr != '\r' && *curr != '\n') {
+        char* name = curr;
+        for (; curr < end; ++curr) {
+            const char lower = tokenTable.lower[static_cast<unsigned char>(*curr)];
+            if (!lower)
+                break;
+            *curr = lower;
+        }
+        NGREST_ASSERT_HTTP(curr != name && curr < end && *curr == ':', HTTP_STATUS_400_BAD_REQUEST,
+                           "Failed to parse HTTP header: invalid name");
+        *curr = '\0';
+        ++curr;
+
+        while (curr < end && (*curr == ' ' || *curr == '\t'))
+            ++curr;
+
+        char* value = curr;
+        char* valueEnd = const_cast<char*>(findStopChar<false>(curr, end));
+        NGREST_ASSERT_HTTP(valueEnd < end && (*valueEnd == '\r' || *valueEnd == '\n'), HTTP_STATUS_400_BAD_REQUEST,
+                           "Failed to parse HTTP header: invalid value");
+        curr = skipEol(valueEnd, end);
+
+        while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+            --valueEnd;
+        *valueEnd = '\0';
+
+        Header* header = pool->alloc<Header>();
+        header->name = name;
+        header->value = value;
+        if (lastHeader == nullptr) {
+            request->headers = header;
+        } else {
+            lastHeader->next = header;
+        }
+        lastHeader = header;
+    }
+
+    return httpVersion;
+}
+
+}
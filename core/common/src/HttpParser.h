@@ -0,0 +1,77 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_HTTPPARSER_H
+#define NGREST_HTTPPARSER_H
+
+#include <stdint.h>
+#include "ngrestcommonexport.h"
+
+namespace ngrest {
+
+class MemPool;
+struct HttpRequest;
+
+/**
+ * @brief incremental HTTP/1.x request header parser.
+ * Search for the end of header is resumable: position reached is kept between calls,
+ * so every byte of header is scanned once regardless of number of reads it took to receive it.
+ * When header is complete, request line and header fields are parsed and validated in-place
+ * using SSE2/AVX2 when available.
+ */
+class NGREST_COMMON_EXPORT HttpParser
+{
+public:
+    /**
+     * @brief reset parser to handle the next request
+     */
+    inline void reset()
+    {
+        scanned = 0;
+    }
+
+    /**
+     * @brief find the end of HTTP header continuing from position reached by previous call
+     * @param buffer begin of request
+     * @param size number of bytes of request received so far
+     * @return size of HTTP header including terminating empty line or 0 if header is not complete yet
+     */
+    uint64_t findHeaderEnd(const char* buffer, uint64_t size);
+
+    /**
+     * @brief parse complete HTTP header in-place.
+     * Method, path, header names and values are terminated with '\0' inside of the buffer,
+     * header names are converted to lower case
+     * @param buffer begin of request
+     * @param headerSize size of HTTP header as returned by findHeaderEnd
+     * @param request request to store method, path and headers to
+     * @param pool memory pool to allocate headers in
+     * @return HTTP version: 10 = 1.0, 11 = 1.1
+     * @throws HttpException with status 400 if header is malformed
+     */
+    static uint8_t parse(char* buffer, uint64_t headerSize, HttpRequest* request, MemPool* pool);
+
+private:
+    uint64_t scanned = 0;
+};
+
+}
+
+#endif // NGREST_HTTPPARSER_H
@@ -31,6 +31,7 @@ namespace ngrest {
 
 class Exception;
 class Transport;
+class ResponseProducer;
 struct Node;
 struct MessageContext;
 
@@ -89,6 +90,10 @@ struct NGREST_COMMON_EXPORT Response
     Node* node = nullptr;               //!< response body node
 
     MemPool* poolBody = nullptr;        //!< response body
+
+    ResponseProducer* producer = nullptr; //!< producer to send response body by parts instead of poolBody
+
+    bool handled = false;               //!< response is prepared by PreDispatch filter, request is not dispatched
 };
 
 /**
@@ -111,6 +116,7 @@ struct NGREST_COMMON_EXPORT MessageContext
     Response* response = nullptr;           //!< response
     MessageCallback* callback = nullptr;    //!< callback to send message after processing
     MemPool* pool = nullptr;                //!< pool to store temporary data upon message processing
+    Header* attributes = nullptr;           //!< data passed between filters, allocated in pool
 };
 
 } // namespace ngrest
@@ -22,7 +22,11 @@
 #define NGREST_OBJECTMODELUTILS_H
 
 #include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 #include <ngrest/utils/fromcstring.h>
+#include <ngrest/utils/StringRef.h>
 #include <ngrest/utils/Exception.h>
 #include "ObjectModel.h"
 
@@ -94,6 +98,45 @@ public:
         value = getChildValue(object, name);
     }
 
+    /**
+     * @brief get string value of child into string with custom allocator.
+     * @param object object where perform the search of the child
+     * @param name child name to find
+     * @param value reference to variable where result is to be placed
+     */
+    template <typename Alloc>
+    static inline void getChildValue(const Object* object, const char* name,
+                                     std::basic_string<char, std::char_traits<char>, Alloc>& value)
+    {
+        value = getChildValue(object, name);
+    }
+
+    /**
+     * @brief get reference to string value of child. no data is copied,
+     *   reference is valid while the object model is alive
+     * @param object object where perform the search of the child
+     * @param name child name to find
+     * @param value reference to variable where result is to be placed
+     */
+    static inline void getChildValue(const Object* object, const char* name, StringRef& value)
+    {
+        value = StringRef(getChildValue(object, name));
+    }
+
+#if __cplusplus >= 201703L
+    /**
+     * @brief get view of string value of child. no data is copied,
+     *   view is valid while the object model is alive
+     * @param object object where perform the search of the child
+     * @param name child name to find
+     * @param value reference to variable where result is to be placed
+     */
+    static inline void getChildValue(const Object* object, const char* name, std::string_view& value)
+    {
+        value = getChildValue(object, name);
+    }
+#endif
+
     /**
      * @brief get C-string value of child
      * @param object object where perform the search of the child
@@ -136,6 +179,41 @@ public:
         value = getValue(node);
     }
 
+    /**
+     * @brief get string node value into string with custom allocator
+     * @param node Value node to get data from
+     * @param value reference to variable where result is to be placed
+     */
+    template <typename Alloc>
+    static inline void getValue(const Node* node, std::basic_string<char, std::char_traits<char>, Alloc>& value)
+    {
+        value = getValue(node);
+    }
+
+    /**
+     * @brief get reference to string node value. no data is copied,
+     *   reference is valid while the object model is alive
+     * @param node Value node to get data from
+     * @param value reference to variable where result is to be placed
+     */
+    static inline void getValue(const Node* node, StringRef& value)
+    {
+        value = StringRef(getValue(node));
+    }
+
+#if __cplusplus >= 201703L
+    /**
+     * @brief get view of string node value. no data is copied,
+     *   view is valid while the object model is alive
+     * @param node Value node to get data from
+     * @param value reference to variable where result is to be placed
+     */
+    static inline void getValue(const Node* node, std::string_view& value)
+    {
+        value = getValue(node);
+    }
+#endif
+
     /**
      * @brief get C-string node value
      * @param node Value node to get data from
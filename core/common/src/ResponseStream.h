@@ -0,0 +1,92 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_RESPONSESTREAM_H
+#define NGREST_RESPONSESTREAM_H
+
+#include <stdint.h>
+
+namespace ngrest {
+
+/**
+ * @brief stream to send response body by parts.
+ * Implemented by transport. Must be used only from the event loop thread which handles the request.
+ */
+class ResponseStream
+{
+public:
+    /**
+     * @brief destructor
+     */
+    virtual ~ResponseStream() {}
+
+    /**
+     * @brief write the next part of response body.
+     * Data is copied to the send window of the client, so it can be freed right after the call
+     * @param data data to write
+     * @param size size of data
+     * @return true - more data can be written now, false - send window is full:
+     *   producer must stop writing and wait for the next ResponseProducer::produce call
+     */
+    virtual bool write(const char* data, uint64_t size) = 0;
+
+    /**
+     * @brief finish response body. Stream must not be used after this call
+     */
+    virtual void finish() = 0;
+};
+
+
+/**
+ * @brief producer of response body sent by parts.
+ * Set Response::producer to send the body using chunked transfer encoding instead of
+ * writing it to Response::poolBody. Peak memory used by response is bounded by
+ * the send window of the server, regardless of the size of the body.
+ */
+class ResponseProducer
+{
+public:
+    /**
+     * @brief destructor
+     */
+    virtual ~ResponseProducer() {}
+
+    /**
+     * @brief called when the stream is ready to accept the next part of the body:
+     *   right after response header is written and every time the send window drains.
+     * Producer may write parts until ResponseStream::write returns false,
+     * or return without writing and write later from the same event loop thread
+     * (in that case produce will not be called until the next write)
+     * @param stream stream to write the body to
+     */
+    virtual void produce(ResponseStream* stream) = 0;
+
+    /**
+     * @brief called when client connection is closed before the body is finished.
+     * Stream must not be used after this call
+     */
+    virtual void abort()
+    {
+    }
+};
+
+} // namespace ngrest
+
+#endif // NGREST_RESPONSESTREAM_H
@@ -32,5 +32,10 @@ Service::~Service()
 
 }
 
+const char* Service::getVersionTag(const std::string&, MessageContext*)
+{
+    return nullptr;
+}
+
 } // namespace ngrest
 
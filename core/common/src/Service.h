@@ -26,6 +26,8 @@
 
 namespace ngrest {
 
+struct MessageContext;
+
 /**
  * @brief abstract parent for all ngrest services
  */
@@ -41,6 +43,15 @@ public:
      * @brief destructor
      */
     virtual ~Service();
+
+    /**
+     * @brief get version tag of the resource to answer conditional requests without invoking the operation.
+     * Service must declare override as virtual, so it is not treated as an operation
+     * @param operation name of operation which handles the request
+     * @param context message context, request is not yet parsed
+     * @return version tag or nullptr if resource has no version tag
+     */
+    virtual const char* getVersionTag(const std::string& operation, MessageContext* context);
 };
 
 } // namespace ngrest
@@ -42,8 +42,8 @@ public:
     void success() override
     {
         context->engine->runPhase(Phase::PostDispatch, context);
-        // only write response in case of it was not written
-        if (!context->response->poolBody->getSize())
+        // only write response in case of it was not written or streamed
+        if (!context->response->poolBody->getSize() && !context->response->producer)
             context->transport->writeResponse(context->pool, context->request, context->response);
         context->engine->runPhase(Phase::PreSend, context);
         context->callback = origCallback;
@@ -87,6 +87,13 @@ void Engine::dispatchMessage(MessageContext* context)
     runPhase(Phase::PreDispatch, context);
 
     try {
+        // response is already prepared by filter, e.g. taken from the cache
+        if (context->response->handled) {
+            runPhase(Phase::PreSend, context);
+            context->callback->success();
+            return;
+        }
+
         // this will replace context callback and restore it after dispatching the message
         context->pool->alloc<EngineHookCallback>(context);
 
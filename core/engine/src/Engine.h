@@ -35,6 +35,7 @@ class FilterDispatcher;
  * - parse body of request using supplied transport parser to OM
  * - dispatch message using service dispatcher
  * - write response and pass it to the transport
+ * Message is not dispatched if response is marked as handled by PreDispatch filter.
  */
 class NGREST_ENGINE_EXPORT Engine
 {
@@ -25,9 +25,9 @@ namespace ngrest {
 
 void Handler::post(Task task)
 {
-    Looper* mainLooper = Looper::getMainLooper();
-    NGREST_ASSERT(mainLooper, "Unable to post, main looper is not set!");
-    mainLooper->post(task);
+    Looper* looper = Looper::getCurrentLooper();
+    NGREST_ASSERT(looper, "Unable to post, main looper is not set!");
+    looper->post(task);
 }
 
 } // namespace ngrest
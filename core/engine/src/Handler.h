@@ -33,8 +33,9 @@ class NGREST_ENGINE_EXPORT Handler
 {
 public:
     /**
-     * @brief post task to event loop (main thread).
-     * This function is thread-safe if ngrest is compiled with WITH_THREAD_LOCK
+     * @brief post task to event loop of the current thread (or to the main event loop
+     * if the current thread has no event loop).
+     * This function is thread-safe
      * @param task task to post
      */
     static void post(Task task);
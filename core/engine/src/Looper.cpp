@@ -18,6 +18,10 @@
  *  This file is part of ngrest: http://github.com/loentar/ngrest
  */
 
+#include <memory>
+
+#include <ngrest/common/HttpException.h>
+
 #include "Looper.h"
 
 namespace ngrest {
@@ -28,4 +32,33 @@ Looper::~Looper()
 
 Looper* Looper::mainLooper = nullptr;
 
+static thread_local Looper* currentLooper = nullptr;
+
+Looper* Looper::getCurrentLooper()
+{
+    return currentLooper ? currentLooper : mainLooper;
+}
+
+void Looper::setCurrentLooper(Looper* looper)
+{
+    currentLooper = looper;
+}
+
+void Looper::postError(ErrorTask task, const Exception& error)
+{
+    // error may be passed by service from its own thread with no exception in flight,
+    // so it's copied instead of capturing current exception
+    std::shared_ptr<const Exception> errorCopy;
+    const HttpException* httpError = dynamic_cast<const HttpException*>(&error);
+    if (httpError) {
+        errorCopy = std::make_shared<HttpException>(*httpError);
+    } else {
+        errorCopy = std::make_shared<Exception>(error);
+    }
+
+    post([task, errorCopy] {
+        task(*errorCopy);
+    });
+}
+
 } // namespace ngrest
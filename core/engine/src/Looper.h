@@ -26,7 +26,10 @@
 
 namespace ngrest {
 
+class Exception;
+
 typedef std::function<void()> Task; //!< a task to execute on event loop
+typedef std::function<void(const Exception&)> ErrorTask; //!< a task to handle error on event loop
 
 /**
  * @brief Base class for event loop
@@ -41,11 +44,20 @@ public:
 
     /**
      * @brief post task to event loop.
-     * This function is thread-safe if ngrest is compiled with WITH_THREAD_LOCK
+     * This function is thread-safe
      * @param task
      */
     virtual void post(Task task) = 0;
 
+    /**
+     * @brief post task to handle error on event loop.
+     * Error is copied, so it's not required to be thrown. HttpException keeps its status.
+     * This function is thread-safe
+     * @param task error handler
+     * @param error error to pass to the handler
+     */
+    void postError(ErrorTask task, const Exception& error);
+
     /**
      * @brief get instance of main looper
      * @return main event looper
@@ -64,6 +76,18 @@ public:
         mainLooper = looper;
     }
 
+    /**
+     * @brief get event loop running in the current thread
+     * @return event loop of the current thread or main looper if current thread has no event loop
+     */
+    static Looper* getCurrentLooper();
+
+    /**
+     * @brief set event loop running in the current thread
+     * @param looper event loop of the current thread
+     */
+    static void setCurrentLooper(Looper* looper);
+
 private:
     static Looper* mainLooper;
 };
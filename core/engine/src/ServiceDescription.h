@@ -66,6 +66,8 @@ struct OperationDescription
     std::vector<ParameterDescription> parameters;  //!< parameters
     ParameterDescription::Type result;             //!< type of result value
     bool resultNullable;                           //!< result can be null
+    int cacheTtl;                                  //!< time in seconds response can be cached for, 0 - no caching
+    bool coalesce;                                 //!< identical concurrent requests share one invocation
 };
 
 /**
@@ -21,11 +21,15 @@
 #include <string.h>
 
 #include <string>
+#include <vector>
 #include <unordered_map>
+#include <mutex>
 
 #include <ngrest/utils/Exception.h>
 #include <ngrest/utils/Log.h>
 #include <ngrest/utils/stringutils.h>
+#include <ngrest/utils/tostring.h>
+#include <ngrest/utils/MemPool.h>
 #include <ngrest/common/Service.h>
 #include <ngrest/common/Message.h>
 #include <ngrest/common/ObjectModel.h>
@@ -36,6 +40,7 @@
 #include "ServiceWrapper.h"
 #include "Phase.h"
 #include "Engine.h"
+#include "Looper.h"
 #include "Transport.h"
 #include "ServiceDispatcher.h"
 
@@ -107,10 +112,155 @@ struct ResourcePath
     std::unordered_map<std::string, ResourcePath*> children;
 };
 
+// invocation of coalescing operation and identical requests waiting for its result
+struct Flight
+{
+    ServiceWrapper* wrapper = nullptr;
+    const OperationDescription* operation = nullptr;
+    std::vector<MessageContext*> followers;
+};
+
+// flights are kept per event loop: responses of followers must be written
+// from the thread owning their clients, so only requests of the same loop are coalesced
+class Flights
+{
+public:
+    // returns true if identical request is in flight and the context is attached to it
+    bool join(const Looper* looper, const std::string& key, ServiceWrapper* wrapper,
+              const OperationDescription* operation, MessageContext* context)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Flight>& loopFlights = flights[looper];
+        auto it = loopFlights.find(key);
+        if (it != loopFlights.end()) {
+            it->second.followers.push_back(context);
+            return true;
+        }
+
+        Flight& flight = loopFlights[key];
+        flight.wrapper = wrapper;
+        flight.operation = operation;
+        return false;
+    }
+
+    // removes the flight, so the next identical request starts a new invocation
+    void land(const Looper* looper, const std::string& key, Flight& flight)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unordered_map<std::string, Flight>& loopFlights = flights[looper];
+        auto it = loopFlights.find(key);
+        NGREST_ASSERT(it != loopFlights.end(), "No flight found for " + key); // should never happen
+        flight = std::move(it->second);
+        loopFlights.erase(it);
+    }
+
+private:
+    std::mutex mutex;
+    std::unordered_map<const Looper*, std::unordered_map<std::string, Flight>> flights;
+};
+
+inline void invokeOperation(ServiceWrapper* wrapper, const OperationDescription* operation,
+                            MessageContext* context)
+{
+    if (context->engine)
+        context->engine->runPhase(Phase::PreInvoke, context);
+    LogDebug() << "Invoking service operation " << wrapper->getDescription()->name
+               << "/" << operation->name;
+    wrapper->invoke(operation, context);
+}
+
+// replaces callback of the first request to share its response with identical requests
+class FlightCallback: public MessageCallback
+{
+public:
+    FlightCallback(Flights* flights_, MessageContext* context_, const char* key_):
+        flights(flights_), context(context_), origCallback(context_->callback), key(key_),
+        looper(Looper::getCurrentLooper())
+    {
+        context->callback = this;
+    }
+
+    void success() override
+    {
+        // followers must be finished from the event loop owning them
+        if (Looper::getCurrentLooper() != looper) {
+            FlightCallback* callback = this;
+            looper->post([callback] {
+                callback->success();
+            });
+            return;
+        }
+
+        context->callback = origCallback;
+        Flight flight;
+        flights->land(looper, key, flight);
+
+        const Response* response = context->response;
+        for (MessageContext* follower : flight.followers) {
+            try {
+                if (response->producer) {
+                    // streamed response cannot be shared
+                    invokeOperation(flight.wrapper, flight.operation, follower);
+                    continue;
+                }
+
+                // response is written by the follower's engine while the request is still alive
+                follower->response->node = response->node;
+                Header** followerHeader = &follower->response->headers;
+                for (const Header* header = response->headers; header; header = header->next) {
+                    *followerHeader = follower->pool->alloc<Header>(follower->pool->putCString(header->name, true),
+                                                                    follower->pool->putCString(header->value, true),
+                                                                    *followerHeader);
+                    followerHeader = &(*followerHeader)->next;
+                }
+                if (response->poolBody && response->poolBody->getSize()) {
+                    const MemPool::Chunk* lastChunk = response->poolBody->getLastChunk();
+                    for (const MemPool::Chunk* chunk = response->poolBody->getChunks(); chunk <= lastChunk; ++chunk)
+                        follower->response->poolBody->putData(chunk->buffer, chunk->size);
+                }
+                follower->callback->success();
+            } catch (const Exception& err) {
+                LogWarning() << err.getFileLine() << " " << err.getFunction() << " : " << err.what();
+                follower->callback->error(err);
+            }
+        }
+
+        origCallback->success();
+    }
+
+    void error(const Exception& error) override
+    {
+        if (Looper::getCurrentLooper() != looper) {
+            FlightCallback* callback = this;
+            looper->postError([callback] (const Exception& error) {
+                callback->error(error);
+            }, error);
+            return;
+        }
+
+        context->callback = origCallback;
+        Flight flight;
+        flights->land(looper, key, flight);
+
+        for (MessageContext* follower : flight.followers)
+            follower->callback->error(error);
+
+        origCallback->error(error);
+    }
+
+private:
+    Flights* const flights;
+    MessageContext* const context;
+    MessageCallback* const origCallback;
+    const char* const key;
+    Looper* const looper;
+};
+
 struct ServiceDispatcher::Impl
 {
     std::unordered_map<std::string, DeployedService> deployedServices;
     ResourcePath root;
+    Flights flights;
 
     std::string getServiceLocation(const ServiceDescription* serviceDescr)
     {
@@ -234,6 +384,62 @@ struct ServiceDispatcher::Impl
         return service;
     }
 
+    // returns static resource or parametrized resource with the longest base path matched
+    // matchLength is set to the length of base path, or to npos for static resource
+    Resource* findResource(DeployedService* service, const std::string& path, std::string::size_type begin,
+                           int method, std::string::size_type& matchLength)
+    {
+        // first look path in static resources
+        auto itOpLocation = service->staticResources.equal_range(path.substr(begin));
+        for (auto it = itOpLocation.first; it != itOpLocation.second; ++it) {
+            Resource& resource = it->second;
+            if (resource.operation->method == method) {
+                // found it!
+                matchLength = std::string::npos;
+                return &resource;
+            }
+        }
+
+        // search for suitable parametrized resource
+        Resource* resource = nullptr;
+        matchLength = 0;
+
+        for (auto& paramResource : service->paramResources) {
+            const std::string& basePath = paramResource.first;
+            const std::string::size_type basePathSize = basePath.size();
+            // '=' is required in case of base path is empty
+            if (!path.compare(begin, basePathSize, basePath) && (matchLength <= basePathSize)) {
+                Resource& currResource = paramResource.second;
+                if (currResource.operation->method == method) {
+                    matchLength = basePathSize;
+                    resource = &currResource;
+                }
+            }
+        }
+
+        return resource;
+    }
+
+    void invoke(DeployedService* service, const OperationDescription* operation, MessageContext* context)
+    {
+        // without event loop (e.g. in apache module) the transport expects the response
+        // to be ready when dispatching returns, so the request cannot wait for another one
+        Looper* looper = Looper::getCurrentLooper();
+        if (operation->coalesce && !context->request->body && looper) {
+            // request is identified by method and full path including query
+            const std::string& key = toString(context->transport->getRequestMethod(context->request))
+                    + " " + context->request->path;
+            if (flights.join(looper, key, service->wrapper, operation, context)) {
+                LogDebug() << "Request " << key << " is coalesced with the one in flight";
+                return;
+            }
+
+            context->pool->alloc<FlightCallback>(&flights, context,
+                                                 context->pool->putCString(key.c_str(), key.size(), true));
+        }
+
+        invokeOperation(service->wrapper, operation, context);
+    }
 };
 
 
@@ -363,47 +569,21 @@ void ServiceDispatcher::dispatchMessage(MessageContext* context)
     DeployedService* service = impl->findServiceByPath(path, begin);
     NGREST_ASSERT(service, "No service found to handle resource " + path);
 
-    const std::string& opLocation = path.substr(begin);
-    NGREST_ASSERT(opLocation.find_first_of(" \n\r\t") == std::string::npos,
-                  "Operation location is not valid: " + opLocation);
+    NGREST_ASSERT(path.find_first_of(" \n\r\t", begin) == std::string::npos,
+                  "Operation location is not valid: " + path.substr(begin));
 
     int method = context->transport->getRequestMethod(context->request);
 
-    // first look path in static resources
-    auto itOpLocation = service->staticResources.equal_range(opLocation);
-    for (auto it = itOpLocation.first; it != itOpLocation.second; ++it) {
-        const Resource& resource = it->second;
-        if (resource.operation->method == method) {
-            // found it!
-            if (context->engine)
-                context->engine->runPhase(Phase::PreInvoke, context);
-            LogDebug() << "Invoking service operation " << service->wrapper->getDescription()->name
-                       << "/" << resource.operation->name;
-            service->wrapper->invoke(resource.operation, context);
-            return;
-        }
-    }
-
-
-    // search for suitable parametrized resource
-    Resource* resource = nullptr;
     std::string::size_type matchLength = 0;
+    Resource* resource = impl->findResource(service, path, begin, method, matchLength);
+    NGREST_ASSERT(resource, "Resource not found for path: " + path);
 
-    for (auto& paramResource : service->paramResources) {
-        const std::string& basePath = paramResource.first;
-        const std::string::size_type basePathSize = basePath.size();
-        // '=' is required in case of base path is empty
-        if (!path.compare(begin, basePathSize, basePath) && (matchLength <= basePathSize)) {
-            Resource& currResource = paramResource.second;
-            if (currResource.operation->method == method) {
-                matchLength = basePathSize;
-                resource = &currResource;
-            }
-        }
+    if (matchLength == std::string::npos) {
+        // static resource: no parameters to read from path
+        impl->invoke(service, resource->operation, context);
+        return;
     }
 
-    NGREST_ASSERT(resource, "Resource not found for path: " + path);
-
     // generate OM from request
 
     // path = "/calc/add?a={a}&b={b}"
@@ -484,18 +664,34 @@ void ServiceDispatcher::dispatchMessage(MessageContext* context)
 
 #ifdef DEBUG
     json::JsonWriter::write(requestNode, context->response->poolBody);
+    std::string generatedRequest;
+    for (const MemPool::Chunk& chunk : context->response->poolBody->getSegments())
+        generatedRequest.append(chunk.buffer, chunk.size);
     LogDebug() << "Generated request:\n---------------------\n"
-               << context->response->poolBody->flatten()->buffer
+               << generatedRequest
                << "\n---------------------\n";
     context->response->poolBody->reset();
 #endif
 
-    if (context->engine)
-        context->engine->runPhase(Phase::PreInvoke, context);
+    impl->invoke(service, resource->operation, context);
+}
+
+const OperationDescription* ServiceDispatcher::findOperation(const std::string& path, int method,
+                                                             ServiceWrapper** wrapper) const
+{
+    std::string::size_type begin = std::string::npos;
+    DeployedService* service = impl->findServiceByPath(path, begin);
+    if (!service)
+        return nullptr;
+
+    std::string::size_type matchLength = 0;
+    const Resource* resource = impl->findResource(service, path, begin, method, matchLength);
+    if (!resource)
+        return nullptr;
 
-    LogDebug() << "Invoking service operation " << service->wrapper->getDescription()->name
-               << "/" << resource->operation->name;
-    service->wrapper->invoke(resource->operation, context);
+    if (wrapper)
+        *wrapper = service->wrapper;
+    return resource->operation;
 }
 
 std::vector<ServiceWrapper*> ServiceDispatcher::getServices() const
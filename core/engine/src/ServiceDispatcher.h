@@ -21,12 +21,14 @@
 #ifndef NGREST_SERVICEDISPATCHER_H
 #define NGREST_SERVICEDISPATCHER_H
 
+#include <string>
 #include <vector>
 #include "ngrestengineexport.h"
 
 namespace ngrest {
 
 class ServiceWrapper;
+struct OperationDescription;
 struct MessageContext;
 
 /**
@@ -66,6 +68,16 @@ public:
      */
     void dispatchMessage(MessageContext* context);
 
+    /**
+     * @brief find operation which handles the resource, without dispatching the message
+     * @param path path to the resource
+     * @param method request method depending on transport
+     * @param wrapper if not nullptr, receives wrapper of the service which provides the operation
+     * @return operation description or nullptr if no operation found
+     */
+    const OperationDescription* findOperation(const std::string& path, int method,
+                                              ServiceWrapper** wrapper = nullptr) const;
+
 
     /**
      * @brief get all registered services
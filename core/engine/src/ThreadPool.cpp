@@ -0,0 +1,191 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/Log.h>
+#include <ngrest/common/Message.h>
+#include <ngrest/common/HttpException.h>
+
+#include "ThreadPool.h"
+
+#define NGREST_THREAD_POOL_QUEUE_LIMIT 4096
+
+namespace ngrest {
+
+struct Job
+{
+    MessageContext* context;
+    Operation operation;
+    Looper* looper;
+};
+
+struct ThreadPool::Impl
+{
+    int threadCount = 0;
+    int queueLimit = NGREST_THREAD_POOL_QUEUE_LIMIT;
+    bool stopping = false;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::queue<Job> jobs;
+    std::vector<std::thread> threads;
+
+    void start()
+    {
+        int count = threadCount;
+        if (count <= 0)
+            count = std::max(std::thread::hardware_concurrency(), 1u) * 2;
+
+        LogDebug() << "Starting " << count << " worker threads";
+        threads.reserve(count);
+        for (int i = 0; i < count; ++i)
+            threads.emplace_back(&Impl::run, this);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for (std::thread& thread : threads)
+            thread.join();
+        threads.clear();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::queue<Job>().swap(jobs);
+        stopping = false;
+    }
+
+    void run()
+    {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping)
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+
+            Task complete;
+            std::exception_ptr exception;
+            try {
+                complete = job.operation();
+            } catch (...) {
+                exception = std::current_exception();
+            }
+
+            // response must be written from the event loop the operation was invoked from
+            MessageContext* context = job.context;
+            job.looper->post([context, complete, exception] {
+                try {
+                    if (exception)
+                        std::rethrow_exception(exception);
+                    if (complete)
+                        complete();
+                } catch (const Exception& error) {
+                    context->callback->error(error);
+                    return;
+                } catch (const std::exception& error) {
+                    context->callback->error(Exception(NGREST_FILE_LINE, __FUNCTION__, error.what()));
+                    return;
+                } catch (...) {
+                    context->callback->error(Exception(NGREST_FILE_LINE, __FUNCTION__, "Unknown exception"));
+                    return;
+                }
+
+                context->callback->success();
+            });
+        }
+    }
+};
+
+
+ThreadPool& ThreadPool::inst()
+{
+    static ThreadPool instance;
+    return instance;
+}
+
+ThreadPool::ThreadPool():
+    impl(new Impl())
+{
+}
+
+ThreadPool::~ThreadPool()
+{
+    impl->stop();
+    delete impl;
+}
+
+void ThreadPool::setThreadCount(int count)
+{
+    impl->threadCount = count;
+}
+
+void ThreadPool::setQueueLimit(int limit)
+{
+    impl->queueLimit = limit;
+}
+
+void ThreadPool::stop()
+{
+    impl->stop();
+}
+
+void ThreadPool::invoke(MessageContext* context, Operation operation)
+{
+    NGREST_ASSERT_PARAM(context);
+    NGREST_ASSERT_NULL(context->callback);
+
+    Looper* looper = Looper::getCurrentLooper();
+    if (looper) {
+        {
+            std::lock_guard<std::mutex> lock(impl->mutex);
+            NGREST_ASSERT_HTTP(static_cast<int>(impl->jobs.size()) < impl->queueLimit,
+                               HTTP_STATUS_503_SERVICE_UNAVAILABLE, "Too many requests are pending");
+            if (impl->threads.empty())
+                impl->start();
+            impl->jobs.push({context, operation, looper});
+        }
+        impl->condition.notify_one();
+        return;
+    }
+
+    // no event loop to return to: invoke synchronously
+    Task complete = operation();
+    if (complete)
+        complete();
+    context->callback->success();
+}
+
+} // namespace ngrest
@@ -0,0 +1,91 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_THREADPOOL_H
+#define NGREST_THREADPOOL_H
+
+#include "Looper.h"
+#include "ngrestengineexport.h"
+
+namespace ngrest {
+
+struct MessageContext;
+
+typedef std::function<Task()> Operation; //!< blocking operation, returns task to complete it in event loop
+
+/**
+ * @brief Bounded pool of worker threads to run blocking service operations.
+ * Operation is executed in worker thread, then message callback is called
+ * from the event loop the operation was invoked from.
+ */
+class NGREST_ENGINE_EXPORT ThreadPool
+{
+public:
+    /**
+     * @brief get thread pool instance
+     * @return thread pool instance
+     */
+    static ThreadPool& inst();
+
+    /**
+     * @brief set the number of worker threads. Must be called before the first invoke
+     * @param count number of worker threads, 0 - twice the number of CPU cores
+     */
+    void setThreadCount(int count);
+
+    /**
+     * @brief set maximum number of operations waiting for a free worker thread
+     * @param limit maximum queue size. When limit is reached, HTTP 503 error is returned to client
+     */
+    void setQueueLimit(int limit);
+
+    /**
+     * @brief run operation in worker thread, then run the task returned by operation
+     * and call context callback from the current event loop.
+     * If operation or task throws an exception, context->callback->error is called,
+     * else context->callback->success.
+     * Operation runs in the current thread if there is no event loop to return to
+     * @param context message context
+     * @param operation operation to run in worker thread
+     */
+    void invoke(MessageContext* context, Operation operation);
+
+    /**
+     * @brief stop worker threads and wait until running operations are finished.
+     * Operations waiting for a free worker thread are discarded.
+     * Must be called before event loops are destroyed, because worker thread
+     * posts completion of operation to the event loop it was invoked from
+     */
+    void stop();
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+private:
+    struct Impl;
+    Impl* const impl;
+};
+
+} // namespace ngrest
+
+#endif // NGREST_THREADPOOL_H
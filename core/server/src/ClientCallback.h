@@ -81,6 +81,14 @@ public:
      */
     virtual void connected(Socket fd, const sockaddr_storage* addr) = 0;
 
+    /**
+     * @brief client connection is about to be closed
+     * @param fd client socket descriptor
+     * @return true - handler keeps the socket open to complete pending sends and closes it itself,
+     *   false - socket must be closed by server
+     */
+    virtual bool closing(Socket fd) = 0;
+
     /**
      * @brief client disconnected event
      * @param fd client socket descriptor
@@ -90,8 +98,10 @@ public:
     /**
      * @brief client error event
      * @param fd client socket descriptor
+     * @return true - error was caused by notifications in socket error queue
+     *   which were handled (e.g. zero copy send completions), false - socket error
      */
-    virtual void error(Socket fd) = 0;
+    virtual bool error(Socket fd) = 0;
 
     /**
      * @brief data available from client
@@ -112,6 +122,11 @@ public:
      * @param callback callback
      */
     virtual void setCloseConnectionCallback(CloseConnectionCallback* callback) = 0;
+
+    /**
+     * @brief check timeouts of clients. Called by server on every event loop iteration
+     */
+    virtual void checkTimeouts() = 0;
 };
 
 }
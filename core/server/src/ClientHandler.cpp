@@ -25,7 +25,12 @@
 #include <error.h>
 #endif
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netdb.h>
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#include <linux/errqueue.h>
+#define NGREST_ZEROCOPY
+#endif
 #else
 #include <Ws2tcpip.h>
 #undef DELETE // conflicts with HttpMethod::DELETE
@@ -33,6 +38,8 @@
 #include <time.h>
 
 #include <list>
+#include <deque>
+#include <utility>
 
 #include <ngrest/utils/Log.h>
 #include <ngrest/utils/MemPool.h>
@@ -45,19 +52,44 @@
 #include <ngrest/common/Message.h>
 #include <ngrest/common/HttpMessage.h>
 #include <ngrest/common/HttpException.h>
+#include <ngrest/common/HttpParser.h>
+#include <ngrest/common/ChunkedDecoder.h>
+#include <ngrest/common/ResponseStream.h>
 #include <ngrest/engine/Engine.h>
 #include <ngrest/engine/Phase.h>
+#include <ngrest/engine/Looper.h>
 
-#include "strutils.h"
+#include "TimingWheel.h"
+#include "SocketAddress.h"
+#include "Http2Session.h"
 #include "ClientHandler.h"
 
-#define TRY_BLOCK_SIZE 512
+#define READ_BLOCK_SIZE 1024 // minimum free space to read HTTP header into
+#define MAX_READ_BLOCK_SIZE 65536
 #define MAX_REQUEST_SIZE 10485760 // 10 Mb
+#define MAX_WRITE_IOV 64
+
+#define DEFAULT_IDLE_TIMEOUT 60000 // 60 s
+#define DEFAULT_HEADER_TIMEOUT 30000 // 30 s
+#define DEFAULT_BODY_TIMEOUT 60000 // 60 s
+#define DEFAULT_STREAM_WINDOW 65536
+#define DEFAULT_PIPELINE_DEPTH 16
+#define MAX_FREE_CLIENTS 128 // contexts of closed connections kept to serve the next ones
+#define LINGER_TIMEOUT 60000 // maximum time to wait for zero copy completions of closed connection, 60 s
+#define LINGER_CHECK_PERIOD 100 // 100 ms
 
 namespace ngrest {
 
 static const uint64_t INVALID_VALUE = static_cast<uint64_t>(-1);
 
+enum class TimeoutState
+{
+    None,   // request is being processed
+    Idle,   // waiting for the next request
+    Header, // receiving HTTP header
+    Body    // receiving HTTP body
+};
+
 struct MessageWriteState
 {
     const MemPool::Chunk* chunk = nullptr;
@@ -65,11 +97,108 @@ struct MessageWriteState
     uint64_t pos = 0;
 };
 
+struct ClientContext;
+
+// request received while the previous one is being processed. It's dispatched at once,
+// and its response is taken over by client context when all the previous responses are sent
+struct PipelinedRequest
+{
+    ClientContext* clientContext; // nullptr if connection is closed while processing
+    bool processing = false;
+    uint64_t id = 0;
+    ElapsedTimer timer;
+    MessageContext context;
+    HttpRequest request;
+    HttpResponse response;
+    MemPooler* pooler;
+    MemPool* poolWrite; // response body
+    uint8_t httpVersion = 0;
+    bool keepAliveConnection = true;
+    SocketAddress address; // request may outlive client context
+
+    PipelinedRequest(ClientContext* clientContext_, Transport* transport, Engine* engine, MemPooler* pooler_,
+                     const SocketAddress& address_):
+        clientContext(clientContext_),
+        pooler(pooler_),
+        poolWrite(pooler->obtain(4096))
+    {
+        address.set(address_);
+        request.clientAddress = &address;
+        response.poolBody = poolWrite;
+
+        // stores copy of request as the read buffer is reused for the next requests
+        context.pool = pooler->obtain();
+        context.engine = engine;
+        context.transport = transport;
+        context.request = &request;
+        context.response = &response;
+    }
+
+    ~PipelinedRequest()
+    {
+        pooler->recycle(poolWrite);
+        pooler->recycle(context.pool);
+    }
+};
+
+#ifdef NGREST_ZEROCOPY
+struct ZeroCopyPools
+{
+    uint32_t sent = 0;
+    MemPool* poolBody = nullptr;
+    MemPool* poolWrite = nullptr;
+};
+
+// reads notifications of completed sends from socket error queue
+// returns true if any notification is read
+static bool readZeroCopyNotifications(Socket fd, uint32_t& completed)
+{
+    bool handled = false;
+    char control[128];
+    msghdr msg;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE) == -1)
+            break;
+
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                  (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+                continue;
+
+            const sock_extended_err* err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(cmsg));
+            if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            // [ee_info, ee_data] is the range of completed sends
+            completed = err->ee_data + 1;
+            handled = true;
+        }
+    }
+
+    return handled;
+}
+#endif
+
+// connection closed by server, but socket is kept open until kernel completes
+// zero copy sends: pages of the pools are pinned and must not be reused before that
+struct LingeringClient
+{
+    Socket fd = NGREST_SOCKET_ERROR;
+    uint64_t deadline = 0;
+#ifdef NGREST_ZEROCOPY
+    uint32_t completed = 0;
+    std::deque<ZeroCopyPools> pools;
+#endif
+};
+
 struct ClientContext
 {
-    Socket fd;
-    char host[NI_MAXHOST];
-    char port[NI_MAXSERV];
+    Socket fd = NGREST_SOCKET_ERROR;
+    SocketAddress address;
     bool deleteLater = false;
 
     // due to http only one message can be processed at once per client
@@ -91,27 +220,59 @@ struct ClientContext
     uint64_t nextRequestOffset = INVALID_VALUE;
     uint64_t contentLength = INVALID_VALUE;
     uint64_t httpBodyOffset = 0;
-    uint64_t httpBodyRemaining = INVALID_VALUE;
+    uint64_t httpBodyRemaining = INVALID_VALUE; // for chunked body: minimum number of bytes remaining
+    uint64_t readBlockSize = READ_BLOCK_SIZE; // grows if client sends large headers or many requests at once
     bool processing = false;
     bool pipeline = false;
     bool needTryNext = false;
     uint8_t httpVersion = 0; // 0=unknown, 10 = 1.0, 11 = 1.1 ...
+    HttpParser parser;
+    bool chunked = false; // chunked body is being received into poolBody
+    ChunkedDecoder chunkedDecoder;
+
+    Timer timeoutTimer;
+    TimeoutState timeoutState = TimeoutState::None;
 
     // response data
     bool writing = false;
     MessageWriteState headerState;
     MessageWriteState bodyState;
 
-    ClientContext(Socket fd_, Transport* transport, Engine* engine, MemPooler* pooler_):
-        fd(fd_),
+    // streamed response: poolWrite is being sent while producer writes the next part to poolStream
+    ResponseProducer* producer = nullptr;
+    ResponseStream* stream = nullptr;
+    MemPool* poolStream = nullptr;
+    bool producePending = false; // producer is called and hasn't written anything yet
+    bool streamWaiting = false; // everything is sent, waiting for producer to write the next part
+    bool streamFinished = false;
+
+#ifdef NGREST_ZEROCOPY
+    int zeroCopyMode = 0; // 0 = SO_ZEROCOPY is not set yet, 1 = enabled, -1 = not supported
+    bool useZeroCopy = false; // send current response with MSG_ZEROCOPY
+    uint32_t zeroCopySent = 0; // number of zero copy sends
+    uint32_t zeroCopyCompleted = 0; // number of sends completed by kernel
+    // response pools which can't be reused until kernel completes zero copy sends
+    std::deque<ZeroCopyPools> zeroCopyPools;
+    ZeroCopyPools spareZeroCopyPools; // completed pools to use for the next response
+#endif
+
+    // requests dispatched while the current one is processed, in order of receiving
+    std::deque<PipelinedRequest*> pipelined;
+    bool pipelineWaiting = false; // current response is sent, waiting for the first pipelined request
+
+    // connection can be switched to HTTP/2 only before the first request
+    bool upgradable = true;
+    Http2Session* http2 = nullptr;
+
+    ClientContext(Transport* transport, Engine* engine, MemPooler* pooler_):
         pooler(pooler_),
         poolRead(pooler->obtain(2048)),
         poolBody(pooler->obtain(1024)),
         poolWrite(pooler->obtain(4096))
     {
-        request.clientHost = host;
-        request.clientPort = port;
+        request.clientAddress = &address;
         response.poolBody = poolWrite;
+        timeoutTimer.data = this;
 
         context.pool = pooler->obtain();
         context.engine = engine;
@@ -122,12 +283,84 @@ struct ClientContext
 
     ~ClientContext()
     {
+        close();
+#ifdef NGREST_ZEROCOPY
+        if (spareZeroCopyPools.poolBody) {
+            pooler->recycle(spareZeroCopyPools.poolBody);
+            pooler->recycle(spareZeroCopyPools.poolWrite);
+        }
+#endif
         pooler->recycle(poolRead);
         pooler->recycle(poolBody);
         pooler->recycle(poolWrite);
+        if (poolStream)
+            pooler->recycle(poolStream);
         pooler->recycle(context.pool);
     }
 
+    // start serving new connection
+    void open(Socket fd_, const sockaddr_storage* addr)
+    {
+        fd = fd_;
+        address.set(addr);
+        deleteLater = false;
+        keepAliveConnection = true;
+        currentRequestOffset = 0;
+        nextRequestOffset = INVALID_VALUE;
+        readBlockSize = READ_BLOCK_SIZE;
+        upgradable = true;
+    }
+
+    // release everything related to closed connection, keeping allocated memory to serve the next one
+    void close()
+    {
+        delete http2;
+        http2 = nullptr;
+
+        for (PipelinedRequest* request : pipelined) {
+            if (request->processing) {
+                request->clientContext = nullptr; // request deletes itself when processing is finished
+            } else {
+                delete request;
+            }
+        }
+        pipelined.clear();
+        pipelineWaiting = false;
+        processing = false;
+        timeoutState = TimeoutState::None;
+
+        reset();
+        // context is kept for the next connection, release memory grown by large requests
+        shrinkPool(poolRead);
+        shrinkPool(poolBody);
+        shrinkPool(poolWrite);
+        shrinkPool(context.pool);
+
+#ifdef NGREST_ZEROCOPY
+        // pools of unfinished sends are taken by ClientHandler::closing, so these are left only
+        // when socket is closed without it. kernel may still send from their pages: never reuse them
+        for (const ZeroCopyPools& pools : zeroCopyPools) {
+            pooler->discard(pools.poolBody);
+            pooler->discard(pools.poolWrite);
+        }
+        zeroCopyPools.clear();
+        zeroCopyMode = 0;
+        zeroCopySent = 0;
+        zeroCopyCompleted = 0;
+#endif
+    }
+
+    static inline void shrinkPool(MemPool* pool)
+    {
+        pool->shrink(pool->getChunkSize() * NGREST_MEMPOOLER_MAX_RETAINED_CHUNKS);
+    }
+
+    // nothing is processed on behalf of client, so it can be deleted
+    bool isIdle() const
+    {
+        return (!processing || pipelineWaiting) && !pipeline;
+    }
+
     void reset()
     {
         // keep data in poolRead for the next request
@@ -136,130 +369,387 @@ struct ClientContext
         httpBodyOffset = 0;
         httpBodyRemaining = INVALID_VALUE;
         httpVersion = 0;
+        parser.reset();
+        chunked = false;
         writing = false;
         needTryNext = false;
         headerState = MessageWriteState();
         bodyState = MessageWriteState();
-
+        producer = nullptr;
+        stream = nullptr;
+        producePending = false;
+        streamWaiting = false;
+        streamFinished = false;
+        if (poolStream)
+            poolStream->reset();
+
+#ifdef NGREST_ZEROCOPY
+        useZeroCopy = false;
+        retainZeroCopyPools();
+#endif
         poolBody->reset();
         poolWrite->reset();
         context.pool->reset();
+        context.attributes = nullptr;
         request = HttpRequest();
-        request.clientHost = host;
-        request.clientPort = port;
+        request.clientAddress = &address;
         response = HttpResponse();
         response.poolBody = poolWrite;
     }
+
+#ifdef NGREST_ZEROCOPY
+    bool enableZeroCopy()
+    {
+        if (zeroCopyMode == 0) {
+            int enable = 1;
+            zeroCopyMode = (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) == 0) ? 1 : -1;
+            if (zeroCopyMode == -1)
+                LogDebug() << "Zero copy is not supported for client #" << fd << ": " << Error::getLastError();
+        }
+        return zeroCopyMode == 1;
+    }
+
+    void retainZeroCopyPools()
+    {
+        if (zeroCopySent != zeroCopyCompleted) {
+            // kernel may still read response from these pools, replace them with the spare ones
+            ZeroCopyPools pools;
+            pools.sent = zeroCopySent;
+            pools.poolBody = poolBody;
+            pools.poolWrite = poolWrite;
+            zeroCopyPools.push_back(pools);
+
+            if (spareZeroCopyPools.poolBody) {
+                poolBody = spareZeroCopyPools.poolBody;
+                poolWrite = spareZeroCopyPools.poolWrite;
+                spareZeroCopyPools = ZeroCopyPools();
+            } else {
+                poolBody = pooler->obtain(1024);
+                poolWrite = pooler->obtain(4096);
+            }
+        }
+    }
+
+    bool readZeroCopyCompletions()
+    {
+        bool handled = readZeroCopyNotifications(fd, zeroCopyCompleted);
+
+        while (!zeroCopyPools.empty()
+               && static_cast<int32_t>(zeroCopyCompleted - zeroCopyPools.front().sent) >= 0) {
+            const ZeroCopyPools& pools = zeroCopyPools.front();
+            if (!spareZeroCopyPools.poolBody) {
+                // keep allocated memory for the next response
+                spareZeroCopyPools = pools;
+            } else {
+                pooler->recycle(pools.poolBody);
+                pooler->recycle(pools.poolWrite);
+            }
+            zeroCopyPools.pop_front();
+        }
+
+        return handled;
+    }
+#endif
 };
 
 
 class ClientHandlerCallback: public MessageCallback
 {
 public:
-    ClientHandlerCallback(ClientHandler* handler_, ClientContext* clientContext_):
-        handler(handler_), clientContext(clientContext_)
+    ClientHandlerCallback(ClientHandler* handler_, ClientContext* clientContext_, Looper* looper_):
+        handler(handler_), clientContext(clientContext_), looper(looper_)
     {
     }
 
     void success()
     {
+        // in multithreaded mode the response must be sent from the thread owning the client
+        if (Looper::getCurrentLooper() != looper) {
+            ClientHandler* handler = this->handler;
+            ClientContext* clientContext = this->clientContext;
+            looper->post([handler, clientContext] {
+                handler->processResponse(clientContext);
+            });
+            return;
+        }
+
         handler->processResponse(clientContext);
     }
 
     void error(const Exception& error)
     {
+        if (Looper::getCurrentLooper() != looper) {
+            ClientHandler* handler = this->handler;
+            ClientContext* clientContext = this->clientContext;
+            looper->postError([handler, clientContext] (const Exception& error) {
+                handler->processError(clientContext, error);
+            }, error);
+            return;
+        }
+
         handler->processError(clientContext, error);
     }
 
+    ClientHandler* handler;
+    ClientContext* clientContext;
+    Looper* looper;
+};
+
+class PipelinedRequestCallback: public MessageCallback
+{
+public:
+    PipelinedRequestCallback(ClientHandler* handler_, PipelinedRequest* request_, Looper* looper_):
+        handler(handler_), request(request_), looper(looper_)
+    {
+    }
+
+    void success()
+    {
+        if (Looper::getCurrentLooper() != looper) {
+            ClientHandler* handler = this->handler;
+            PipelinedRequest* request = this->request;
+            looper->post([handler, request] {
+                handler->processPipelined(request);
+            });
+            return;
+        }
+
+        handler->processPipelined(request);
+    }
+
+    void error(const Exception& error)
+    {
+        if (Looper::getCurrentLooper() != looper) {
+            ClientHandler* handler = this->handler;
+            PipelinedRequest* request = this->request;
+            looper->postError([handler, request] (const Exception& error) {
+                handler->processPipelinedError(request, error);
+            }, error);
+            return;
+        }
+
+        handler->processPipelinedError(request, error);
+    }
+
+    ClientHandler* handler;
+    PipelinedRequest* request;
+    Looper* looper;
+};
+
+class ClientResponseStream: public ResponseStream
+{
+public:
+    ClientResponseStream(ClientHandler* handler_, ClientContext* clientContext_):
+        handler(handler_), clientContext(clientContext_)
+    {
+    }
+
+    bool write(const char* data, uint64_t size) override
+    {
+        return handler->writeStream(clientContext, data, size);
+    }
+
+    void finish() override
+    {
+        handler->finishStream(clientContext);
+    }
+
     ClientHandler* handler;
     ClientContext* clientContext;
 };
 
 
 ClientHandler::ClientHandler(Engine& engine_, Transport& transport_):
-    engine(engine_), transport(transport_), pooler(new MemPooler())
+    engine(engine_), transport(transport_), pooler(new MemPooler()),
+    timingWheel(new TimingWheel(getMonotonicTime())),
+    idleTimeout(DEFAULT_IDLE_TIMEOUT), headerTimeout(DEFAULT_HEADER_TIMEOUT), bodyTimeout(DEFAULT_BODY_TIMEOUT),
+    streamWindow(DEFAULT_STREAM_WINDOW), pipelineDepth(DEFAULT_PIPELINE_DEPTH)
 {
 }
 
 ClientHandler::~ClientHandler()
 {
+    for (ClientContext* clientContext : freeClients)
+        delete clientContext;
+    for (LingeringClient* client : lingering) {
+#ifdef NGREST_ZEROCOPY
+        for (const ZeroCopyPools& pools : client->pools) {
+            pooler->discard(pools.poolBody);
+            pooler->discard(pools.poolWrite);
+        }
+#endif
+        close(client->fd);
+        delete client;
+    }
+    delete timingWheel;
     delete pooler;
 }
 
 void ClientHandler::connected(Socket fd, const sockaddr_storage* addr)
 {
-    ClientContext*& clientContext = clients[fd];
-    if (clientContext == nullptr) {
-        clientContext = new ClientContext(fd, &transport, &engine, pooler);
-
-        int res = getnameinfo(reinterpret_cast<const sockaddr*>(addr), sizeof(*addr),
-                              clientContext->host, sizeof(clientContext->host),
-                              clientContext->port, sizeof(clientContext->port),
-                              NI_NUMERICHOST | NI_NUMERICSERV);
-        if (res == 0) {
-            LogDebug() << "Accepted connection on client #" << fd
-                       << " (host=" << clientContext->host << ", port=" << clientContext->port << ")";
+    if (findClient(fd) == nullptr) {
+        ClientContext* clientContext;
+        if (freeClients.empty()) {
+            clientContext = new ClientContext(&transport, &engine, pooler);
         } else {
-            LogWarning() << "Failed to get client info: " << gai_strerror(res);
-            clientContext->host[0] = '\0';
-            clientContext->port[0] = '\0';
+            clientContext = freeClients.back();
+            freeClients.pop_back();
         }
+        // client address is formatted only when requested
+        clientContext->open(fd, addr);
+        addClient(fd, clientContext);
+
+        LogDebug() << "Accepted connection on client #" << fd;
+
+        // client must send HTTP header in time
+        clientContext->timeoutState = TimeoutState::Header;
+        if (headerTimeout)
+            timingWheel->arm(&clientContext->timeoutTimer, getMonotonicTime(), headerTimeout);
     } else {
         LogError() << "Client #" << fd << " is already connected";
     }
 }
 
+bool ClientHandler::closing(Socket fd)
+{
+#ifdef NGREST_ZEROCOPY
+    ClientContext* clientContext = findClient(fd);
+    if (!clientContext || clientContext->zeroCopyMode != 1)
+        return false;
+
+    // response being written may be sent from the current pools
+    if (clientContext->useZeroCopy)
+        clientContext->retainZeroCopyPools();
+    clientContext->readZeroCopyCompletions();
+    if (clientContext->zeroCopyPools.empty())
+        return false;
+
+    // closing the socket won't stop kernel from sending from pinned pages of the pools,
+    // but it makes impossible to know when the pools can be reused.
+    // stop receiving and send FIN after the queued data, then wait for completions
+    shutdown(fd, SHUT_RDWR);
+
+    LingeringClient* client = new LingeringClient();
+    client->fd = fd;
+    client->deadline = getMonotonicTime() + LINGER_TIMEOUT;
+    client->completed = clientContext->zeroCopyCompleted;
+    client->pools.swap(clientContext->zeroCopyPools);
+    clientContext->zeroCopyCompleted = clientContext->zeroCopySent;
+    lingering.push_back(client);
+
+    LogDebug() << "Client #" << fd << " is closed, waiting for zero copy sends to complete";
+    return true;
+#else
+    (void) fd;
+    return false;
+#endif
+}
+
 void ClientHandler::disconnected(Socket fd)
 {
-    auto it = clients.find(fd);
-    if (it != clients.end()) {
-        ClientContext* clientContext = clients[fd];
-        if (!clientContext->processing && !clientContext->pipeline) {
-            delete clientContext;
+    ClientContext* clientContext = findClient(fd);
+    if (clientContext) {
+        timingWheel->disarm(&clientContext->timeoutTimer);
+        if (clientContext->http2 && !clientContext->http2->close()) {
+            // session deletes itself when processing of its streams is finished
+            clientContext->http2 = nullptr;
+        }
+        if (clientContext->producer) {
+            // streamed response is interrupted. producer is the only one who could still refer to the client
+            ResponseProducer* producer = clientContext->producer;
+            clientContext->producer = nullptr;
+            producer->abort();
+        }
+        removeClient(fd);
+        if (clientContext->isIdle() || (clientContext->stream && !clientContext->pipeline)) {
+            releaseClient(clientContext);
         } else {
             clientContext->deleteLater = true;
         }
-        clients.erase(fd);
     }
     LogDebug() << "client #" << fd << " disconnected";
 }
 
-void ClientHandler::error(Socket fd)
+bool ClientHandler::error(Socket fd)
 {
-//    LogError() << "Error client #" << fd;
+#ifdef NGREST_ZEROCOPY
+    ClientContext* clientContext = findClient(fd);
+    if (clientContext && clientContext->zeroCopyMode == 1) {
+        if (clientContext->readZeroCopyCompletions())
+            return true;
+
+        // notifications could be read already while handling previous event
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        return getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) == 0 && err == 0;
+    }
+#endif
+    return false;
 }
 
 bool ClientHandler::readyRead(Socket fd)
 {
-    auto it = clients.find(fd);
-    if (it == clients.end()) {
+    ClientContext* clientContext = findClient(fd);
+    if (clientContext == nullptr) {
         LogWarning() << "Failed to process request: non-existing client: " << fd;
         return false;
     }
 
-    ClientContext* clientContext = it->second;
-    NGREST_ASSERT_NULL(clientContext);
-
     return readyRead(clientContext);
 }
 
 bool ClientHandler::readyRead(ClientContext* clientContext)
 {
+    if (clientContext->http2)
+        return clientContext->http2->readyRead();
+
+    if (clientContext->processing)
+        return readPipelined(clientContext);
+
+    const Socket fd = clientContext->fd;
     for (;;) {
         MemPool* pool = clientContext->usePoolBody ? clientContext->poolBody : clientContext->poolRead;
         uint64_t prevSize = pool->getSize();
-        uint64_t sizeToRead = (clientContext->httpBodyRemaining != INVALID_VALUE)
-                ? clientContext->httpBodyRemaining : TRY_BLOCK_SIZE;
+        uint64_t sizeToRead;
+        if (clientContext->chunked) {
+            // read no more than the rest of the body plus free space of poolRead,
+            // so the data of the next request read along with the end of the body always fits to poolRead
+            const MemPool::Chunk* readChunk = clientContext->poolRead->getLastChunk();
+            const uint64_t readFree = readChunk->bufferSize - readChunk->size;
+            sizeToRead = clientContext->httpBodyRemaining + (readFree > 1 ? readFree - 1 : 0);
+
+            const MemPool::Chunk* chunk = pool->getLastChunk();
+            if ((prevSize + sizeToRead + 1) > chunk->bufferSize) {
+                // grow geometrically to avoid reallocation for each chunk
+                const uint64_t requiredSize = prevSize + sizeToRead + 1;
+                const uint64_t doubleSize = chunk->bufferSize * 2;
+                pool->reserve(requiredSize > doubleSize ? requiredSize : doubleSize);
+            }
+        } else if (clientContext->httpBodyRemaining != INVALID_VALUE) {
+            // space for the body is already reserved by tryParseHeaders
+            sizeToRead = clientContext->httpBodyRemaining;
+        } else {
+            // read HTTP header into the single chunk, so it's never needed to be flattened.
+            // read as much as free space allows, keeping one byte for terminating '\0' of the body
+            const MemPool::Chunk* chunk = pool->getLastChunk();
+            if (!chunk || (chunk->bufferSize - chunk->size) <= clientContext->readBlockSize)
+                pool->reserve(prevSize + clientContext->readBlockSize + 1);
+            chunk = pool->getLastChunk();
+            sizeToRead = chunk->bufferSize - chunk->size - 1;
+        }
+
         char* buffer = pool->grow(sizeToRead);
         ssize_t received = ::recv(clientContext->fd, buffer, sizeToRead, 0);
         if (received == 0) {
-            // this should only happen in case of ioctl(fd, FIONREAD...) failure
             // EOF. The remote has closed the connection.
+            pool->shrinkLastChunk(sizeToRead);
             LogDebug() << "client #" << clientContext->fd << " closed connection";
             return false;
         }
 
         if (received == -1) {
+            pool->shrinkLastChunk(sizeToRead);
+
             // some error
             if (errno != EAGAIN) {
                 LogError() << "failed to read block from client #" << clientContext->fd
@@ -268,26 +758,43 @@ bool ClientHandler::readyRead(ClientContext* clientContext)
             }
 
             // all available data read
-            pool->shrinkLastChunk(sizeToRead);
+            updateTimeout(clientContext);
             break;
         }
 
         if (received < static_cast<int64_t>(sizeToRead))
             pool->shrinkLastChunk(sizeToRead - received);
 
-        if (clientContext->httpBodyRemaining != INVALID_VALUE)
+        if (clientContext->chunked) {
+            try {
+                readChunkedBody(clientContext, buffer, received);
+            } catch (const Exception& ex) {
+                processError(clientContext, ex);
+                return false; // close connection to client
+            }
+        } else if (clientContext->httpBodyRemaining != INVALID_VALUE) {
             clientContext->httpBodyRemaining -= received;
+        } else if (received == static_cast<int64_t>(sizeToRead)
+                   && clientContext->readBlockSize < MAX_READ_BLOCK_SIZE) {
+            // whole buffer is filled, grow it geometrically to avoid many small reads and reallocations
+            clientContext->readBlockSize *= 2;
+        }
 
         if (clientContext->httpBodyOffset == 0) {
-            pool->flatten();
+            // HTTP/2 connection with prior knowledge starts with connection preface
+            if (clientContext->upgradable && http2Enabled) {
+                const MemPool::Chunk* chunk = pool->getChunks();
+                if (chunk->size >= 4 && Http2Session::isPreface(chunk->buffer, chunk->size))
+                    return startHttp2(clientContext);
+            }
 
-            uint64_t findOffset = prevSize ? (prevSize - 3) : 0;
-            Status res = tryParseHeaders(clientContext, pool, findOffset);
+            Status res = tryParseHeaders(clientContext, pool);
             switch (res) {
             case Status::Again:
-                // if HTTP header is larger than default read size
+                // if HTTP header is larger than free space
                 if (received == static_cast<int64_t>(sizeToRead))
                     continue;
+                updateTimeout(clientContext);
                 return true;
             case Status::Close:
                 return false;
@@ -296,12 +803,21 @@ bool ClientHandler::readyRead(ClientContext* clientContext)
         }
 
         if (clientContext->httpBodyRemaining == 0) {
+            if (clientContext->upgradable && http2Enabled && isHttp2Upgrade(clientContext))
+                return startHttp2(clientContext);
+
             try {
                 processRequest(clientContext);
             } catch (const Exception& ex) {
                 processError(clientContext, ex);
                 return false; // close connection to client
             }
+
+            // connection could be closed while sending response
+            if (findClient(fd) == clientContext && clientContext->processing) {
+                // request is processed asynchronously, meanwhile the next requests can be dispatched
+                return readPipelined(clientContext);
+            }
             break;
         }
     }
@@ -309,26 +825,21 @@ bool ClientHandler::readyRead(ClientContext* clientContext)
     return true;
 }
 
-Status ClientHandler::tryParseHeaders(ClientContext* clientContext, MemPool* pool, uint64_t findOffset)
+Status ClientHandler::tryParseHeaders(ClientContext* clientContext, MemPool* pool)
 {
     MemPool::Chunk* chunk = pool->getChunks();
 
-    const char* pos = strstr(chunk->buffer + findOffset, "\r\n\r\n");
-    if (pos) {
-        uint64_t httpHeaderSize = pos - chunk->buffer - clientContext->currentRequestOffset;
-        clientContext->httpBodyOffset = clientContext->currentRequestOffset + httpHeaderSize + 4;
-
-        chunk->buffer[clientContext->httpBodyOffset - 2] = '\0'; // terminate HTTP header
+    // search continues from the position reached by the previous read
+    uint64_t httpHeaderSize = clientContext->parser.findHeaderEnd(chunk->buffer + clientContext->currentRequestOffset,
+                                                                  chunk->size - clientContext->currentRequestOffset);
+    if (!httpHeaderSize)
+        return Status::Again;
 
-        // parse HTTP header
-        parseHttpHeader(chunk->buffer + clientContext->currentRequestOffset, clientContext);
+    clientContext->httpBodyOffset = clientContext->currentRequestOffset + httpHeaderSize;
 
-        try {
-            engine.runPhase(Phase::Header, &clientContext->context);
-        } catch (const Exception& ex) {
-            processError(clientContext, ex);
-            return Status::Close; // close connection to client
-        }
+    try {
+        parseHttpHeader(chunk->buffer + clientContext->currentRequestOffset, httpHeaderSize, clientContext);
+        engine.runPhase(Phase::Header, &clientContext->context);
 
         Header* headerConnection = clientContext->request.getHeader("connection");
         if (headerConnection) {
@@ -339,17 +850,30 @@ Status ClientHandler::tryParseHeaders(ClientContext* clientContext, MemPool* poo
             clientContext->keepAliveConnection = clientContext->httpVersion >= 11;
         }
 
+        bool chunked = false;
+        const Header* headerEncoding = clientContext->request.getHeader("transfer-encoding");
+        if (headerEncoding) {
+            chunked = !strcasecmp(headerEncoding->value, "chunked");
+            NGREST_ASSERT_HTTP(chunked || !strcasecmp(headerEncoding->value, "identity"), HTTP_STATUS_501_NOT_IMPLEMENTED,
+                               "This transfer-encoding is not supported: " + std::string(headerEncoding->value));
+        }
+
         const Header* headerLength = clientContext->request.getHeader("content-length");
-        if (headerLength) {
+        if (chunked) {
+            // ambiguous message length may be used to smuggle requests
+            NGREST_ASSERT_HTTP(!headerLength, HTTP_STATUS_400_BAD_REQUEST,
+                               "Both content-length and transfer-encoding are given");
+            startChunkedBody(clientContext);
+        } else if (headerLength) {
             NGREST_ASSERT(fromCString(headerLength->value, clientContext->contentLength), "Invalid value of content-length");
             NGREST_ASSERT(clientContext->contentLength < MAX_REQUEST_SIZE, "Request is too large!");
             const uint64_t totalRequestLength = clientContext->httpBodyOffset + clientContext->contentLength;
             clientContext->httpBodyRemaining = totalRequestLength - chunk->size;
 
             // if we didn't receive the whole body yet and chunk don't have enough space
-            // store received part of body to another pool to avoid
-            // Header* pointers damage on poolStr->flatten
-            if (clientContext->httpBodyRemaining && (clientContext->httpBodyRemaining > (chunk->bufferSize - chunk->size))) {
+            // (including terminating '\0') store received part of body to another pool to avoid
+            // Header* pointers damage on reallocation of poolRead
+            if (clientContext->httpBodyRemaining && (clientContext->httpBodyRemaining >= (chunk->bufferSize - chunk->size))) {
                 clientContext->poolBody->reserve(clientContext->contentLength + 1);
                 // copy already received part of data to poolBody
                 clientContext->poolBody->putData(chunk->buffer + clientContext->httpBodyOffset,
@@ -360,34 +884,78 @@ Status ClientHandler::tryParseHeaders(ClientContext* clientContext, MemPool* poo
                 clientContext->nextRequestOffset = totalRequestLength;
             }
         } else {
-            Header* headerEncoding = clientContext->request.getHeader("transfer-encoding");
-            if (headerEncoding) {
-                if (!!strcasecmp(headerEncoding->value, "identity")) {
-                    // FIXME: add support for transfer encodings
-                    NGREST_THROW_ASSERT("This transfer-encoding is not supported:" + std::string(headerEncoding->value));
-                }
-            }
             // message has no body and ready to process now
             clientContext->httpBodyRemaining = 0;
             clientContext->nextRequestOffset = clientContext->httpBodyOffset;
         }
+    } catch (const Exception& ex) {
+        processError(clientContext, ex);
+        return Status::Close; // close connection to client
+    }
 
-        return Status::Success;
+    return Status::Success;
+}
+
+void ClientHandler::startChunkedBody(ClientContext* clientContext)
+{
+    MemPool::Chunk* chunk = clientContext->poolRead->getChunks();
+    ChunkedDecoder& decoder = clientContext->chunkedDecoder;
+    decoder.reset(MAX_REQUEST_SIZE);
+
+    // decode the part of body received along with the header in place
+    char* body = chunk->buffer + clientContext->httpBodyOffset;
+    uint64_t decodedSize = 0;
+    const uint64_t consumed = decoder.decode(body, chunk->size - clientContext->httpBodyOffset, decodedSize);
+    clientContext->contentLength = decodedSize;
+
+    if (decoder.isDone()) {
+        // whole body is received. terminating chunk is at least 3 bytes long, so there is space for '\0'
+        body[decodedSize] = '\0';
+        clientContext->httpBodyRemaining = 0;
+        clientContext->nextRequestOffset = clientContext->httpBodyOffset + consumed;
     } else {
-        return Status::Again;
+        // the rest of the body will be received directly into poolBody,
+        // poolRead is kept for the data of the next request which can be received along with the end of the body
+        clientContext->poolBody->reserve(decodedSize + clientContext->readBlockSize + 1);
+        clientContext->poolBody->putData(body, decodedSize);
+        chunk->size = clientContext->httpBodyOffset;
+        clientContext->usePoolBody = true;
+        clientContext->chunked = true;
+        clientContext->httpBodyRemaining = decoder.getRequiredSize();
+        clientContext->nextRequestOffset = INVALID_VALUE; // no next request yet
+    }
+}
+
+void ClientHandler::readChunkedBody(ClientContext* clientContext, char* buffer, uint64_t size)
+{
+    ChunkedDecoder& decoder = clientContext->chunkedDecoder;
+    uint64_t decodedSize = 0;
+    const uint64_t consumed = decoder.decode(buffer, size, decodedSize);
+    clientContext->poolBody->shrinkLastChunk(size - decodedSize);
+    clientContext->contentLength += decodedSize;
+
+    if (decoder.isDone()) {
+        // the rest of data is the beginning of the next request
+        clientContext->nextRequestOffset = clientContext->poolRead->getSize();
+        clientContext->poolRead->putData(buffer + consumed, size - consumed);
+        clientContext->chunked = false;
+        clientContext->httpBodyRemaining = 0;
+    } else {
+        clientContext->httpBodyRemaining = decoder.getRequiredSize();
     }
 }
 
 Status ClientHandler::readyWrite(Socket fd)
 {
-    auto it = clients.find(fd);
-    if (it == clients.end()) {
-        LogWarning() << "Failed to process request: non-existing client: " << fd;
-        return Status::Close;
+    ClientContext* clientContext = findClient(fd);
+    if (clientContext == nullptr) {
+        // connection could be closed while handling incoming data of the same event
+        LogDebug() << "Nothing to write: non-existing client: " << fd;
+        return Status::Done;
     }
 
-    ClientContext* clientContext = it->second;
-    NGREST_ASSERT_NULL(clientContext);
+    if (clientContext->http2)
+        return clientContext->http2->readyWrite();
 
     if (!clientContext->writing)
         return Status::Success;
@@ -407,71 +975,195 @@ void ClientHandler::setCloseConnectionCallback(CloseConnectionCallback* callback
     closeCallback = callback;
 }
 
-void ClientHandler::parseHttpHeader(char* buffer, ClientContext* clientContext)
+void ClientHandler::checkTimeouts()
 {
-    char* curr = buffer;
+    const uint64_t now = getMonotonicTime();
+    if (!lingering.empty() && now >= lingerCheckTime) {
+        lingerCheckTime = now + LINGER_CHECK_PERIOD;
+        checkLingering(now);
+    }
 
-    // parse method
+    timingWheel->advance(now, [this](Timer* timer) {
+        ClientContext* clientContext = static_cast<ClientContext*>(timer->data);
+        LogDebug() << "Client #" << clientContext->fd << " timed out";
+        clientContext->timeoutState = TimeoutState::None;
+        NGREST_ASSERT_NULL(closeCallback);
+        closeCallback->closeConnection(clientContext->fd);
+    });
+}
 
-    const char* method = token(curr);
-    NGREST_ASSERT(method >= buffer, "Failed to get HTTP method");
-    HttpRequest* httpRequest = static_cast<HttpRequest*>(clientContext->context.request);
-    NGREST_ASSERT_NULL(httpRequest);
+void ClientHandler::checkLingering(uint64_t now)
+{
+    for (auto it = lingering.begin(); it != lingering.end();) {
+        LingeringClient* client = *it;
+#ifdef NGREST_ZEROCOPY
+        readZeroCopyNotifications(client->fd, client->completed);
+        while (!client->pools.empty()
+               && static_cast<int32_t>(client->completed - client->pools.front().sent) >= 0) {
+            pooler->recycle(client->pools.front().poolBody);
+            pooler->recycle(client->pools.front().poolWrite);
+            client->pools.pop_front();
+        }
 
-    httpRequest->setMethod(method);
+        if (!client->pools.empty()) {
+            if (now < client->deadline) {
+                ++it;
+                continue;
+            }
 
-    // parse request url
+            LogWarning() << "Zero copy sends to closed client #" << client->fd << " are not completed in time";
+            for (const ZeroCopyPools& pools : client->pools) {
+                pooler->discard(pools.poolBody);
+                pooler->discard(pools.poolWrite);
+            }
+        }
+#else
+        (void) now;
+#endif
+
+        close(client->fd);
+        delete client;
+        it = lingering.erase(it);
+    }
+}
 
-    skipWs(curr);
-    httpRequest->path = token(curr);
-    NGREST_ASSERT(httpRequest->path > buffer, "Failed to get request URL");
+void ClientHandler::setTimeouts(uint64_t idleTimeoutMs, uint64_t headerTimeoutMs, uint64_t bodyTimeoutMs)
+{
+    idleTimeout = idleTimeoutMs;
+    headerTimeout = headerTimeoutMs;
+    bodyTimeout = bodyTimeoutMs;
+}
 
-    skipWs(curr);
-    char* httpVersionStr = curr;
+void ClientHandler::updateTimeout(ClientContext* clientContext)
+{
+    TimeoutState state;
+    uint64_t timeout = 0;
+    if (clientContext->processing || clientContext->writing) {
+        state = TimeoutState::None;
+    } else if (clientContext->httpBodyOffset != 0) {
+        state = TimeoutState::Body;
+        timeout = bodyTimeout;
+    } else if (clientContext->poolRead->getSize() != 0) {
+        state = TimeoutState::Header;
+        timeout = headerTimeout;
+    } else {
+        state = TimeoutState::Idle;
+        timeout = idleTimeout;
+    }
 
-    // seek to the first http header
-    NGREST_ASSERT(seekTo(curr, '\n'), "Failed to seek to first HTTP header");
+    // header timeout counts from the first byte of request, body timeout - from the last read
+    if (state == clientContext->timeoutState && state != TimeoutState::Body)
+        return;
 
-    // parse http version;
-    if (!strncmp(httpVersionStr, "HTTP/", 5)) {
-        httpVersionStr += 5;
-        int len = curr - httpVersionStr;
-        if ((len == 4 || len == 3) && httpVersionStr[1] == '.') { // "1.0\r"
-            clientContext->httpVersion = (httpVersionStr[0] - '0') * 10 + (httpVersionStr[2] - '0');
-        }
+    clientContext->timeoutState = state;
+    if (timeout) {
+        timingWheel->arm(&clientContext->timeoutTimer, getMonotonicTime(), timeout);
+    } else {
+        timingWheel->disarm(&clientContext->timeoutTimer);
     }
+}
 
-    skipWs(curr);
+void ClientHandler::setZeroCopyThreshold(uint64_t threshold)
+{
+#ifndef NGREST_ZEROCOPY
+    if (threshold)
+        LogWarning() << "This version compiled without zero copy support";
+#endif
+    zeroCopyThreshold = threshold;
+}
 
-    // read http headers
+void ClientHandler::setStreamWindow(uint64_t size)
+{
+    streamWindow = size;
+}
 
-    Header* lastHeader = nullptr;
-    while (*curr != '\0') {
-        char* name = token(curr, ':');
-        NGREST_ASSERT(*curr, "Failed to parse HTTP header: unable to read name");
-        trimRight(name, curr - 2);
-        toLowerCase(name);
-        skipWs(curr);
-        NGREST_ASSERT(*curr, "Failed to parse HTTP header: unable to read value");
-        char* value = token(curr, '\n');
-        trimRight(value, curr - 2);
-        Header* header = clientContext->context.pool->alloc<Header>();
-        header->name = name;
-        header->value = value;
-        if (lastHeader == nullptr) {
-            httpRequest->headers = header;
-        } else {
-            lastHeader->next = header;
-        }
-        lastHeader = header;
+void ClientHandler::setHttp2Enabled(bool enabled)
+{
+    http2Enabled = enabled;
+}
+
+void ClientHandler::setPipelineDepth(uint64_t depth)
+{
+    pipelineDepth = depth;
+}
+
+inline bool hasToken(const char* value, const char* token)
+{
+    // comma separated list of case-insensitive tokens
+    const size_t tokenSize = strlen(token);
+    for (const char* curr = value; *curr;) {
+        while (*curr == ' ' || *curr == '\t' || *curr == ',')
+            ++curr;
+        const char* end = curr;
+        while (*end && *end != ',')
+            ++end;
+        const char* tokenEnd = end;
+        while (tokenEnd > curr && (tokenEnd[-1] == ' ' || tokenEnd[-1] == '\t'))
+            --tokenEnd;
+        if (static_cast<size_t>(tokenEnd - curr) == tokenSize && !strncasecmp(curr, token, tokenSize))
+            return true;
+        curr = end;
     }
+    return false;
+}
+
+bool ClientHandler::isHttp2Upgrade(ClientContext* clientContext)
+{
+    // request with body can't be upgraded as body would be sent in HTTP/1.1
+    const HttpRequest& request = clientContext->request;
+    if (clientContext->usePoolBody || (clientContext->contentLength != INVALID_VALUE && clientContext->contentLength))
+        return false;
+
+    const Header* headerUpgrade = request.getHeader("upgrade");
+    const Header* headerConnection = request.getHeader("connection");
+    return headerUpgrade && hasToken(headerUpgrade->value, "h2c")
+            && headerConnection && hasToken(headerConnection->value, "upgrade")
+            && request.getHeader("http2-settings");
+}
+
+bool ClientHandler::startHttp2(ClientContext* clientContext)
+{
+    clientContext->upgradable = false;
+    clientContext->timeoutState = TimeoutState::None;
+    clientContext->http2 = new Http2Session(this, clientContext->fd, clientContext->address,
+                                            &clientContext->timeoutTimer);
+
+    bool res;
+    MemPool::Chunk* chunk = clientContext->poolRead->getChunks();
+    if (clientContext->httpBodyOffset == 0) {
+        res = clientContext->http2->start(chunk->buffer, chunk->size);
+    } else {
+        // the data after the request belongs to HTTP/2
+        const uint64_t offset = clientContext->nextRequestOffset;
+        res = clientContext->http2->upgrade(&clientContext->request,
+                                            clientContext->request.getHeader("http2-settings")->value,
+                                            chunk->buffer + offset, chunk->size - offset);
+    }
+
+    // buffers of HTTP/1 are not used anymore
+    clientContext->reset();
+    clientContext->poolRead->reset();
+    return res;
+}
+
+void ClientHandler::parseHttpHeader(char* buffer, uint64_t size, ClientContext* clientContext)
+{
+    HttpRequest* httpRequest = static_cast<HttpRequest*>(clientContext->context.request);
+    NGREST_ASSERT_NULL(httpRequest);
+
+    clientContext->httpVersion = HttpParser::parse(buffer, size, httpRequest, clientContext->context.pool);
 }
 
 void ClientHandler::processRequest(ClientContext* clientContext)
 {
     clientContext->processing = true;
+    clientContext->upgradable = false;
+    clientContext->timeoutState = TimeoutState::None;
+    timingWheel->disarm(&clientContext->timeoutTimer);
     clientContext->id = ++lastId;
     clientContext->timer.start();
+    // header is parsed already, parser is used to find the next request while this one is processed
+    clientContext->parser.reset();
 
     HttpRequest* httpRequest = static_cast<HttpRequest*>(clientContext->context.request);
     NGREST_ASSERT_NULL(httpRequest);
@@ -488,8 +1180,8 @@ void ClientHandler::processRequest(ClientContext* clientContext)
             NGREST_ASSERT_NULL(clientContext->poolRead->getChunkCount() == 1); // should never happen
 
             const MemPool::Chunk* chunk = clientContext->poolRead->flatten(); // already flat, but we need NUL
-            NGREST_ASSERT(clientContext->httpBodyOffset <= chunk->size, "Request > size");
-            httpRequest->bodySize = chunk->size - clientContext->httpBodyOffset;
+            NGREST_ASSERT(clientContext->httpBodyOffset + clientContext->contentLength <= chunk->size, "Request > size");
+            httpRequest->bodySize = clientContext->contentLength;
             if (httpRequest->bodySize)
                 httpRequest->body = chunk->buffer + clientContext->httpBodyOffset;
         } else {
@@ -499,7 +1191,7 @@ void ClientHandler::processRequest(ClientContext* clientContext)
     }
 
     clientContext->context.callback = clientContext->context.pool
-            ->alloc<ClientHandlerCallback>(this, clientContext);
+            ->alloc<ClientHandlerCallback>(this, clientContext, Looper::getCurrentLooper());
     engine.dispatchMessage(&clientContext->context);
 }
 
@@ -558,6 +1250,26 @@ Status ClientHandler::tryNextRequest(ClientContext* clientContext)
 {
     clientContext->reset();
 
+    if (!clientContext->pipelined.empty()) {
+        // the next request is dispatched already and nothing refers to the read buffer anymore,
+        // move the rest of data to the beginning to free space for the following requests
+        MemPool::Chunk* chunk = clientContext->poolRead->getChunks();
+        const uint64_t remaining = chunk->size - clientContext->nextRequestOffset;
+        memmove(chunk->buffer, chunk->buffer + clientContext->nextRequestOffset, remaining);
+        chunk->size = remaining;
+        clientContext->currentRequestOffset = 0;
+        clientContext->nextRequestOffset = 0;
+
+        clientContext->processing = true;
+        if (clientContext->pipelined.front()->processing) {
+            // response will be sent as soon as it's ready
+            clientContext->pipelineWaiting = true;
+        } else {
+            sendPipelined(clientContext);
+        }
+        return Status::Success;
+    }
+
     clientContext->currentRequestOffset = clientContext->nextRequestOffset;
     NGREST_ASSERT(clientContext->poolRead->getChunkCount() == 1, "Inconsistent mempool");
     MemPool::Chunk* chunk = clientContext->poolRead->getChunks();
@@ -574,7 +1286,7 @@ Status ClientHandler::tryNextRequest(ClientContext* clientContext)
     // there is a part of the next request or even the next full request
 
     uint64_t remaining = chunk->size - clientContext->currentRequestOffset;
-    Status status = tryParseHeaders(clientContext, clientContext->poolRead, clientContext->currentRequestOffset);
+    Status status = tryParseHeaders(clientContext, clientContext->poolRead);
     switch (status) {
     case Status::Again:
         // only part of the next request, copy it to the beginning of mempool
@@ -604,6 +1316,14 @@ Status ClientHandler::tryNextRequest(ClientContext* clientContext)
 
 void ClientHandler::processResponse(ClientContext* clientContext)
 {
+    if (clientContext->deleteLater) {
+        // connection is closed while processing, the socket may belong to another client already
+        clientContext->processing = false;
+        if (clientContext->isIdle())
+            releaseClient(clientContext);
+        return;
+    }
+
     clientContext->writing = true;
     clientContext->poolBody->reset();
 
@@ -620,12 +1340,21 @@ void ClientHandler::processResponse(ClientContext* clientContext)
     // server
     writeHttpHeader(clientContext->poolBody, "Server", "ngrest");
 
-    // content-length
     uint64_t bodySize = response->poolBody->getSize();
-    const int buffSize = 32;
-    char buff[buffSize];
-    NGREST_ASSERT(toCString(bodySize, buff, buffSize), "Failed to write Content-Length");
-    writeHttpHeader(clientContext->poolBody, "Content-Length", buff);
+    if (response->producer) {
+        // size of streamed body is unknown: send it by chunks. HTTP/1.0 client reads it until connection is closed
+        if (clientContext->httpVersion >= 11) {
+            writeHttpHeader(clientContext->poolBody, "Transfer-Encoding", "chunked");
+        } else {
+            clientContext->keepAliveConnection = false;
+        }
+    } else if (response->statusCode != HTTP_STATUS_304_NOT_MODIFIED) {
+        // content-length
+        const int buffSize = 32;
+        char buff[buffSize];
+        NGREST_ASSERT(toCString(bodySize, buff, buffSize), "Failed to write Content-Length");
+        writeHttpHeader(clientContext->poolBody, "Content-Length", buff);
+    }
     const char* serverDate = getServerDate();
     if (serverDate)
         writeHttpHeader(clientContext->poolBody, "Date", serverDate);
@@ -637,28 +1366,156 @@ void ClientHandler::processResponse(ClientContext* clientContext)
     clientContext->headerState.chunk = clientContext->poolBody->getChunks();
     clientContext->headerState.end = clientContext->poolBody->getLastChunk() + 1;
     clientContext->headerState.pos = 0;
-    if (!response->poolBody->isClean()) {
+    if (response->producer) {
+        startStream(clientContext);
+    } else if (!response->poolBody->isClean()) {
         clientContext->bodyState.chunk = response->poolBody->getChunks();
         clientContext->bodyState.end = response->poolBody->getLastChunk() + 1;
         clientContext->bodyState.pos = 0;
     }
 
+#ifdef NGREST_ZEROCOPY
+    // pages are pinned until kernel completes sending, that is only worth it for large responses.
+    // response closing the connection is copied: socket would have to be kept open until completion
+    clientContext->useZeroCopy = zeroCopyThreshold && bodySize >= zeroCopyThreshold && !clientContext->producer
+            && clientContext->keepAliveConnection && clientContext->enableZeroCopy();
+#endif
+
+    sendResponse(clientContext);
+}
+
+bool ClientHandler::sendResponse(ClientContext* clientContext)
+{
+    const Socket fd = clientContext->fd;
     bool closeConnection = !clientContext->keepAliveConnection;
 
     Status res = writeNextPart(clientContext);
-    // clientContext and clientContext is freed here when res=Done
+    // clientContext is freed here when res=Done
     if (res == Status::Close || (res == Status::Done && closeConnection)) {
         NGREST_ASSERT_NULL(closeCallback);
         LogDebug() << "Closing connection to client";
-        closeCallback->closeConnection(clientContext->fd);
+        closeCallback->closeConnection(fd);
+        return false;
     }
+
+    return true;
 }
 
-void ClientHandler::processError(ClientContext* clientContext, const Exception& error)
+void ClientHandler::startStream(ClientContext* clientContext)
 {
-    LogDebug() << "Error while handling request " << clientContext->context.request->path;
+    if (!clientContext->poolStream)
+        clientContext->poolStream = clientContext->pooler->obtain(4096);
+    clientContext->producer = clientContext->response.producer;
+    clientContext->stream = clientContext->context.pool->alloc<ClientResponseStream>(this, clientContext);
+
+    // body written before the producer was set is sent as the first part
+    MemPool* poolBody = clientContext->response.poolBody;
+    if (!poolBody->isClean()) {
+        for (const MemPool::Chunk* chunk = poolBody->getChunks(); chunk <= poolBody->getLastChunk(); ++chunk)
+            putStreamData(clientContext, chunk->buffer, chunk->size);
+        poolBody->reset();
+    }
+}
 
-    HttpResponse* response = static_cast<HttpResponse*>(clientContext->context.response);
+void ClientHandler::putStreamData(ClientContext* clientContext, const char* data, uint64_t size)
+{
+    if (!size)
+        return;
+
+    MemPool* pool = clientContext->poolStream;
+    if (clientContext->httpVersion >= 11) {
+        // chunk size in hex
+        char buff[20];
+        char* end = buff + sizeof(buff);
+        char* pos = end;
+        *--pos = '\n';
+        *--pos = '\r';
+        for (uint64_t value = size; value; value >>= 4)
+            *--pos = "0123456789abcdef"[value & 0xf];
+        pool->putData(pos, end - pos);
+        pool->putData(data, size);
+        pool->putData("\r\n", 2);
+    } else {
+        pool->putData(data, size);
+    }
+}
+
+bool ClientHandler::writeStream(ClientContext* clientContext, const char* data, uint64_t size)
+{
+    if (!clientContext->producer || clientContext->streamFinished)
+        return false;
+
+    clientContext->producePending = false;
+    putStreamData(clientContext, data, size);
+
+    if (clientContext->streamWaiting) {
+        // asynchronous write: nothing is being sent at the moment.
+        // producer is not called back from its own write
+        clientContext->streamWaiting = false;
+        clientContext->producePending = true;
+        if (!sendResponse(clientContext))
+            return false; // connection is closed and producer is aborted
+        clientContext->producePending = false;
+    }
+
+    return (clientContext->poolStream->getSize() + clientContext->poolWrite->getSize()) < streamWindow;
+}
+
+void ClientHandler::finishStream(ClientContext* clientContext)
+{
+    if (!clientContext->producer || clientContext->streamFinished)
+        return;
+
+    clientContext->producePending = false;
+    clientContext->streamFinished = true;
+    if (clientContext->httpVersion >= 11)
+        clientContext->poolStream->putData("0\r\n\r\n", 5); // last chunk
+
+    if (clientContext->streamWaiting) {
+        clientContext->streamWaiting = false;
+        sendResponse(clientContext);
+    }
+}
+
+Status ClientHandler::nextStreamPart(ClientContext* clientContext)
+{
+    // the previous part is sent
+    clientContext->poolWrite->reset();
+
+    for (;;) {
+        if (!clientContext->poolStream->isClean()) {
+            std::swap(clientContext->poolWrite, clientContext->poolStream);
+            clientContext->response.poolBody = clientContext->poolWrite;
+            clientContext->bodyState.chunk = clientContext->poolWrite->getChunks();
+            clientContext->bodyState.end = clientContext->poolWrite->getLastChunk() + 1;
+            clientContext->bodyState.pos = 0;
+
+            // let producer fill the window while this part is being sent
+            if (!clientContext->streamFinished && !clientContext->producePending) {
+                clientContext->producePending = true;
+                clientContext->producer->produce(clientContext->stream);
+            }
+            return Status::Success;
+        }
+
+        if (clientContext->streamFinished) {
+            clientContext->producer = nullptr;
+            return Status::Done;
+        }
+
+        if (clientContext->producePending) {
+            // producer will write the next part asynchronously
+            clientContext->streamWaiting = true;
+            return Status::Again;
+        }
+
+        clientContext->producePending = true;
+        clientContext->producer->produce(clientContext->stream);
+    }
+}
+
+inline void setErrorResponse(HttpResponse* response, MemPool* pool, const Exception& error)
+{
     if (response->statusCode == HTTP_STATUS_UNDEFINED) {
         try {
              throw; // we're called from catch block
@@ -668,13 +1525,269 @@ void ClientHandler::processError(ClientContext* clientContext, const Exception&
             response->statusCode = HTTP_STATUS_500_INTERNAL_SERVER_ERROR;
         }
     }
-    Header headerContentType("Content-Type", "text/plain");
-    response->headers = &headerContentType;
+    response->headers = pool->alloc<Header>("Content-Type", "text/plain");
     response->poolBody->reset();
     response->poolBody->putCString(error.what());
+}
+
+void ClientHandler::processError(ClientContext* clientContext, const Exception& error)
+{
+    const char* path = clientContext->context.request->path;
+    LogDebug() << "Error while handling request " << (path ? path : "<invalid>");
+
+    setErrorResponse(&clientContext->response, clientContext->context.pool, error);
     processResponse(clientContext);
 }
 
+bool ClientHandler::readPipelined(ClientContext* clientContext)
+{
+    MemPool* pool = clientContext->poolRead;
+    if (clientContext->nextRequestOffset == INVALID_VALUE) {
+        // request body is received into poolBody, the next request follows the data in read buffer
+        clientContext->nextRequestOffset = pool->getSize();
+    }
+
+    for (;;) {
+        // current request may refer to the read buffer, so it can't be reallocated.
+        // read into free space only, the rest is read when the current request is processed
+        const MemPool::Chunk* chunk = pool->getLastChunk();
+        if (!chunk || (chunk->bufferSize - chunk->size) <= 1)
+            break;
+
+        const uint64_t sizeToRead = chunk->bufferSize - chunk->size - 1;
+        char* buffer = pool->grow(sizeToRead);
+        ssize_t received = ::recv(clientContext->fd, buffer, sizeToRead, 0);
+        if (received == 0) {
+            pool->shrinkLastChunk(sizeToRead);
+            LogDebug() << "client #" << clientContext->fd << " closed connection";
+            return false;
+        }
+
+        if (received == -1) {
+            pool->shrinkLastChunk(sizeToRead);
+            if (errno != EAGAIN) {
+                LogError() << "failed to read block from client #" << clientContext->fd
+                           << ": " << strerror(errno);
+                return false;
+            }
+            break;
+        }
+
+        if (received < static_cast<int64_t>(sizeToRead))
+            pool->shrinkLastChunk(sizeToRead - received);
+    }
+
+    dispatchPipelined(clientContext);
+    return true;
+}
+
+void ClientHandler::dispatchPipelined(ClientContext* clientContext)
+{
+    const MemPool::Chunk* chunk = clientContext->poolRead->getChunks();
+    if (!chunk)
+        return;
+
+    while ((clientContext->pipelined.size() + 1) < pipelineDepth) {
+        // no requests are expected after the one with connection: close
+        if (!(clientContext->pipelined.empty() ? clientContext->keepAliveConnection
+              : clientContext->pipelined.back()->keepAliveConnection))
+            break;
+
+        const uint64_t offset = clientContext->nextRequestOffset;
+        const uint64_t httpHeaderSize = clientContext->parser.findHeaderEnd(chunk->buffer + offset, chunk->size - offset);
+        if (!httpHeaderSize)
+            break;
+
+        PipelinedRequest* request = new PipelinedRequest(clientContext, &transport, &engine, pooler,
+                                                         clientContext->address);
+        MemPool* pool = request->context.pool;
+        try {
+            // header is parsed in the copy, so it can be parsed again if body is not received yet
+            char* header = pool->putData(chunk->buffer + offset, httpHeaderSize);
+            request->httpVersion = HttpParser::parse(header, httpHeaderSize, &request->request, pool);
+
+            const Header* headerEncoding = request->request.getHeader("transfer-encoding");
+            if (headerEncoding && strcasecmp(headerEncoding->value, "identity")) {
+                // chunked body is handled when the current request is finished
+                delete request;
+                break;
+            }
+
+            uint64_t contentLength = 0;
+            const Header* headerLength = request->request.getHeader("content-length");
+            if (headerLength)
+                NGREST_ASSERT(fromCString(headerLength->value, contentLength), "Invalid value of content-length");
+
+            if (contentLength > (chunk->size - offset - httpHeaderSize)) {
+                // the rest of body will be received later
+                delete request;
+                break;
+            }
+
+            if (headerLength) {
+                char* body = pool->grow(contentLength + 1);
+                memcpy(body, chunk->buffer + offset + httpHeaderSize, contentLength);
+                body[contentLength] = '\0';
+                request->request.body = body;
+                request->request.bodySize = contentLength;
+            }
+
+            const Header* headerConnection = request->request.getHeader("connection");
+            request->keepAliveConnection = headerConnection ? !strcasecmp(headerConnection->value, "keep-alive")
+                                                            : request->httpVersion >= 11;
+
+            clientContext->nextRequestOffset = offset + httpHeaderSize + contentLength;
+            clientContext->parser.reset();
+            clientContext->pipelined.push_back(request);
+
+            request->processing = true;
+            request->id = ++lastId;
+            request->timer.start();
+            request->context.callback = pool->alloc<PipelinedRequestCallback>(this, request,
+                                                                              Looper::getCurrentLooper());
+            engine.runPhase(Phase::Header, &request->context);
+            engine.dispatchMessage(&request->context);
+        } catch (const Exception& ex) {
+            // connection is closed after error is sent
+            request->keepAliveConnection = false;
+            if (!request->processing) {
+                request->processing = true;
+                clientContext->pipelined.push_back(request);
+            }
+            processPipelinedError(request, ex);
+        }
+    }
+}
+
+void ClientHandler::processPipelined(PipelinedRequest* request)
+{
+    request->processing = false;
+
+    ClientContext* clientContext = request->clientContext;
+    if (!clientContext) {
+        // connection is closed
+        delete request;
+        return;
+    }
+
+    // response is sent when all the previous responses are sent
+    if (clientContext->pipelineWaiting && clientContext->pipelined.front() == request)
+        sendPipelined(clientContext);
+}
+
+void ClientHandler::processPipelinedError(PipelinedRequest* request, const Exception& error)
+{
+    const char* path = request->request.path;
+    LogDebug() << "Error while handling request " << (path ? path : "<invalid>");
+
+    setErrorResponse(&request->response, request->context.pool, error);
+    processPipelined(request);
+}
+
+void ClientHandler::sendPipelined(ClientContext* clientContext)
+{
+    PipelinedRequest* request = clientContext->pipelined.front();
+    clientContext->pipelined.pop_front();
+    clientContext->pipelineWaiting = false;
+
+    // take over the message, released buffers of client context are recycled along with the request
+    std::swap(clientContext->context.pool, request->context.pool);
+    std::swap(clientContext->poolWrite, request->poolWrite);
+    clientContext->request = request->request;
+    clientContext->request.clientAddress = &clientContext->address;
+    clientContext->response = request->response;
+    clientContext->id = request->id;
+    clientContext->timer = request->timer;
+    clientContext->httpVersion = request->httpVersion;
+    clientContext->keepAliveConnection = request->keepAliveConnection;
+    delete request;
+
+    processResponse(clientContext);
+}
+
+#ifndef WIN32
+inline void advanceState(MessageWriteState& state, uint64_t& sent)
+{
+    while (state.chunk != state.end) {
+        const uint64_t left = state.chunk->size - state.pos;
+        if (sent < left) {
+            state.pos += sent;
+            sent = 0;
+            return;
+        }
+
+        sent -= left;
+        state.pos = 0;
+        ++state.chunk;
+    }
+}
+
+inline Status writeStates(ClientContext* clientContext)
+{
+    MessageWriteState* states[] = {&clientContext->headerState, &clientContext->bodyState};
+    iovec iov[MAX_WRITE_IOV];
+
+    for (;;) {
+        // gather header and body chunks to send them with one syscall
+        int iovCount = 0;
+        for (MessageWriteState* state : states) {
+            for (const MemPool::Chunk* chunk = state->chunk;
+                 chunk != state->end && iovCount < MAX_WRITE_IOV; ++chunk) {
+                const uint64_t pos = (chunk == state->chunk) ? state->pos : 0;
+                iov[iovCount].iov_base = chunk->buffer + pos;
+                iov[iovCount].iov_len = chunk->size - pos;
+                ++iovCount;
+            }
+        }
+
+        if (!iovCount)
+            return Status::Success;
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovCount;
+
+        int flags = 0;
+#ifdef NGREST_ZEROCOPY
+        if (clientContext->useZeroCopy)
+            flags |= MSG_ZEROCOPY;
+#endif
+
+        ssize_t sent = ::sendmsg(clientContext->fd, &msg, flags);
+        if (sent == -1) {
+            // output buffer is full.
+            if (errno == EAGAIN)
+                return Status::Again;
+
+            if (errno == EINTR)
+                continue;
+
+#ifdef NGREST_ZEROCOPY
+            // socket option memory limit for pinned pages is reached: send the rest with copying
+            if (errno == ENOBUFS && clientContext->useZeroCopy) {
+                clientContext->useZeroCopy = false;
+                continue;
+            }
+#endif
+
+            // other error
+            if (errno != EPIPE && errno != ECONNRESET)
+                LogError() << "Failed to write response: " << Error::getLastError();
+            return Status::Close;
+        }
+
+#ifdef NGREST_ZEROCOPY
+        if (clientContext->useZeroCopy)
+            ++clientContext->zeroCopySent;
+#endif
+
+        uint64_t remaining = static_cast<uint64_t>(sent);
+        for (MessageWriteState* state : states)
+            advanceState(*state, remaining);
+    }
+}
+#else
 inline Status writeChunks(Socket fd, MessageWriteState& state)
 {
     while (state.chunk != state.end) {
@@ -700,21 +1813,37 @@ inline Status writeChunks(Socket fd, MessageWriteState& state)
 
     return Status::Success;
 }
+#endif
 
 Status ClientHandler::writeNextPart(ClientContext* clientContext)
 {
-    // write header to client
-    Status writeStatus = writeChunks(clientContext->fd, clientContext->headerState);
-    if (writeStatus == Status::Again)
-        return writeStatus;
-
-    if (writeStatus == Status::Success) {
-        if (clientContext->bodyState.chunk) {
+    for (;;) {
+#ifndef WIN32
+        // write header and body to client
+        Status writeStatus = writeStates(clientContext);
+#else
+        // write header to client
+        Status writeStatus = writeChunks(clientContext->fd, clientContext->headerState);
+        if (writeStatus == Status::Success && clientContext->bodyState.chunk) {
             // write response body to client
             writeStatus = writeChunks(clientContext->fd, clientContext->bodyState);
-            if (writeStatus == Status::Again)
-                return writeStatus;
         }
+#endif
+        if (writeStatus == Status::Again)
+            return writeStatus;
+
+        if (!clientContext->producer)
+            break;
+
+        // streamed response: producer is aborted when connection is closed
+        if (writeStatus == Status::Close)
+            return writeStatus;
+
+        const Status streamStatus = nextStreamPart(clientContext);
+        if (streamStatus == Status::Again)
+            return streamStatus;
+        if (streamStatus == Status::Done)
+            break;
     }
 
     LogDebug() << "Request " << clientContext->id << " handled in "
@@ -730,7 +1859,7 @@ Status ClientHandler::writeNextPart(ClientContext* clientContext)
 
     // delayed deletion of ClientContext if connection was closed meanwhile processing
     if (clientContext->deleteLater) {
-        delete clientContext;
+        releaseClient(clientContext);
         return res;
     }
 
@@ -745,9 +1874,9 @@ Status ClientHandler::writeNextPart(ClientContext* clientContext)
                 res = Status::Close;
                 clientContext->needTryNext = false;
             }
-        } while (clientContext->needTryNext);
+        } while (clientContext->needTryNext && !clientContext->deleteLater);
 
-        if (tryRes == Status::Again) {
+        if (tryRes == Status::Again && !clientContext->deleteLater) {
             clientContext->nextRequestOffset = INVALID_VALUE;
             // request with body read, try to continue reqding the next request
             // we don't get event for it in edge trigger mode
@@ -757,10 +1886,63 @@ Status ClientHandler::writeNextPart(ClientContext* clientContext)
                 res = Status::Close;
             }
         }
-    } while (clientContext->needTryNext);
+    } while (clientContext->needTryNext && !clientContext->deleteLater);
     clientContext->pipeline = false;
 
+    if (clientContext->deleteLater) {
+        // connection is closed while handling the next requests
+        if (clientContext->isIdle())
+            releaseClient(clientContext);
+        return Status::Success;
+    }
+
+    if (res != Status::Close) {
+        // the next request is processed asynchronously, meanwhile the following requests can be dispatched
+        if (clientContext->processing && !readPipelined(clientContext))
+            res = Status::Close;
+        updateTimeout(clientContext);
+    }
+
     return res;
 }
 
+ClientContext* ClientHandler::findClient(Socket fd) const
+{
+#ifndef WIN32
+    return (static_cast<uint64_t>(fd) < clients.size()) ? clients[fd] : nullptr;
+#else
+    auto it = clients.find(fd);
+    return (it != clients.end()) ? it->second : nullptr;
+#endif
+}
+
+void ClientHandler::addClient(Socket fd, ClientContext* clientContext)
+{
+#ifndef WIN32
+    // descriptors are allocated lowest-first so the table stays dense
+    if (static_cast<uint64_t>(fd) >= clients.size())
+        clients.resize(fd + 1, nullptr);
+#endif
+    clients[fd] = clientContext;
+}
+
+void ClientHandler::removeClient(Socket fd)
+{
+#ifndef WIN32
+    clients[fd] = nullptr;
+#else
+    clients.erase(fd);
+#endif
+}
+
+void ClientHandler::releaseClient(ClientContext* clientContext)
+{
+    if (freeClients.size() < MAX_FREE_CLIENTS) {
+        clientContext->close();
+        freeClients.push_back(clientContext);
+    } else {
+        delete clientContext;
+    }
+}
+
 }
@@ -22,6 +22,7 @@
 #define CLIENTHANDLER_H
 
 #include <unordered_map>
+#include <vector>
 
 #include "ClientCallback.h"
 
@@ -32,7 +33,10 @@ class Engine;
 class Transport;
 class MemPooler;
 class MemPool;
+class TimingWheel;
 struct ClientContext;
+struct PipelinedRequest;
+struct LingeringClient;
 
 /**
  * @brief Client handler. Manages clients messages
@@ -59,6 +63,13 @@ public:
      */
     virtual void connected(Socket fd, const sockaddr_storage* addr) override;
 
+    /**
+     * @brief client connection is about to be closed
+     * @param fd client socket descriptor
+     * @return true - socket is kept open until kernel completes zero copy sends
+     */
+    virtual bool closing(Socket fd) override;
+
     /**
      * @brief client disconnected event
      * @param fd client socket descriptor
@@ -68,8 +79,9 @@ public:
     /**
      * @brief client error event
      * @param fd client socket descriptor
+     * @return true - error was caused by zero copy send completions which were handled
      */
-    virtual void error(Socket fd) override;
+    virtual bool error(Socket fd) override;
 
     /**
      * @brief data available from client
@@ -92,12 +104,52 @@ public:
      */
     virtual void setCloseConnectionCallback(CloseConnectionCallback* callback) override;
 
+    /**
+     * @brief check timeouts of clients and close timed out connections
+     */
+    virtual void checkTimeouts() override;
+
+    /**
+     * @brief set client timeouts. 0 - disable timeout
+     * @param idleTimeoutMs maximum time keep-alive connection can wait for the next request
+     * @param headerTimeoutMs maximum time to receive HTTP header counting from connection
+     *   or the first byte of request
+     * @param bodyTimeoutMs maximum time between two reads of HTTP body
+     */
+    void setTimeouts(uint64_t idleTimeoutMs, uint64_t headerTimeoutMs, uint64_t bodyTimeoutMs);
+
+    /**
+     * @brief set minimum response body size to send with MSG_ZEROCOPY
+     * @param threshold response body size in bytes, 0 - never use zero copy
+     */
+    void setZeroCopyThreshold(uint64_t threshold);
+
+    /**
+     * @brief set maximum size of streamed response data buffered per client
+     * @param size size in bytes
+     */
+    void setStreamWindow(uint64_t size);
+
+    /**
+     * @brief enable or disable HTTP/2 over cleartext connections (h2c)
+     * @param enabled true - accept HTTP/2 connection preface and upgrade from HTTP/1.1
+     */
+    void setHttp2Enabled(bool enabled);
+
+    /**
+     * @brief set maximum number of pipelined requests processed concurrently per connection.
+     * Responses are sent in order of requests
+     * @param depth number of requests, 1 - process requests one by one
+     */
+    void setPipelineDepth(uint64_t depth);
+
     /**
      * @brief parse http header from buffer
      * @param buffer mutable buffer which stores http header
+     * @param size size of http header including terminating empty line
      * @param clientContext message data to write header to
      */
-    void parseHttpHeader(char* buffer, ClientContext* clientContext);
+    void parseHttpHeader(char* buffer, uint64_t size, ClientContext* clientContext);
 
     /**
      * @brief prepare and process received request from client
@@ -118,18 +170,80 @@ public:
      */
     void processError(ClientContext* clientContext, const Exception& error);
 
+    /**
+     * @brief write the next part of streamed response body
+     * @param clientContext client message data
+     * @param data data to write
+     * @param size size of data
+     * @return true - more data can be written, false - send window is full or connection is closed
+     */
+    bool writeStream(ClientContext* clientContext, const char* data, uint64_t size);
+
+    /**
+     * @brief finish streamed response body
+     * @param clientContext client message data
+     */
+    void finishStream(ClientContext* clientContext);
+
+    /**
+     * @brief pipelined request is processed, send its response if all the previous responses are sent
+     * @param request pipelined request
+     */
+    void processPipelined(PipelinedRequest* request);
+
+    /**
+     * @brief build error response to pipelined request
+     * @param request pipelined request
+     * @param error error description
+     */
+    void processPipelinedError(PipelinedRequest* request, const Exception& error);
+
 private:
-    Status tryParseHeaders(ClientContext* clientContext, MemPool* pool, uint64_t findOffset);
+    friend class Http2Session;
+
+    Status tryParseHeaders(ClientContext* clientContext, MemPool* pool);
+    void startChunkedBody(ClientContext* clientContext);
+    void readChunkedBody(ClientContext* clientContext, char* buffer, uint64_t size);
     Status writeNextPart(ClientContext* clientContext);
+    bool sendResponse(ClientContext* clientContext);
+    void startStream(ClientContext* clientContext);
+    void putStreamData(ClientContext* clientContext, const char* data, uint64_t size);
+    Status nextStreamPart(ClientContext* clientContext);
     const char* getServerDate();
     Status tryNextRequest(ClientContext* clientContext);
+    void updateTimeout(ClientContext* clientContext);
+    bool isHttp2Upgrade(ClientContext* clientContext);
+    bool startHttp2(ClientContext* clientContext);
+    bool readPipelined(ClientContext* clientContext);
+    void dispatchPipelined(ClientContext* clientContext);
+    void sendPipelined(ClientContext* clientContext);
+    ClientContext* findClient(Socket fd) const;
+    void addClient(Socket fd, ClientContext* clientContext);
+    void removeClient(Socket fd);
+    void releaseClient(ClientContext* clientContext);
+    void checkLingering(uint64_t now);
 
 private:
     uint64_t lastId = 0;
+    uint64_t zeroCopyThreshold = 0;
+#ifndef WIN32
+    std::vector<ClientContext*> clients; // indexed by socket descriptor
+#else
     std::unordered_map<Socket, ClientContext*> clients;
+#endif
+    std::vector<ClientContext*> freeClients; // contexts of closed connections ready for reuse
+    std::vector<LingeringClient*> lingering; // closed connections kept open until zero copy sends complete
+    uint64_t lingerCheckTime = 0;
     Engine& engine;
     Transport& transport;
     MemPooler* pooler;
+    TimingWheel* timingWheel;
+    uint64_t idleTimeout;
+    uint64_t headerTimeout;
+    uint64_t bodyTimeout;
+    uint64_t streamWindow;
+    uint64_t pipelineDepth;
+    bool http2Enabled = true;
     CloseConnectionCallback* closeCallback = nullptr;
 #ifdef WIN32
     SYSTEMTIME lastDate = {0, 0, 0, 0, 0, 0, 0, 0};
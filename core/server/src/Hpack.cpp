@@ -0,0 +1,421 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <string.h>
+
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/common/Message.h>
+
+#include "Hpack.h"
+
+namespace ngrest {
+
+#define HPACK_STATIC_TABLE_SIZE 61
+#define HPACK_ENTRY_OVERHEAD 32
+
+struct StaticEntry
+{
+    const char* name;
+    uint64_t nameSize;
+    const char* value;
+    uint64_t valueSize;
+};
+
+// RFC 7541, Appendix A
+static const StaticEntry staticTable[HPACK_STATIC_TABLE_SIZE] = {
+    {":authority", 10, "", 0},
+    {":method", 7, "GET", 3},
+    {":method", 7, "POST", 4},
+    {":path", 5, "/", 1},
+    {":path", 5, "/index.html", 11},
+    {":scheme", 7, "http", 4},
+    {":scheme", 7, "https", 5},
+    {":status", 7, "200", 3},
+    {":status", 7, "204", 3},
+    {":status", 7, "206", 3},
+    {":status", 7, "304", 3},
+    {":status", 7, "400", 3},
+    {":status", 7, "404", 3},
+    {":status", 7, "500", 3},
+    {"accept-charset", 14, "", 0},
+    {"accept-encoding", 15, "gzip, deflate", 13},
+    {"accept-language", 15, "", 0},
+    {"accept-ranges", 13, "", 0},
+    {"accept", 6, "", 0},
+    {"access-control-allow-origin", 27, "", 0},
+    {"age", 3, "", 0},
+    {"allow", 5, "", 0},
+    {"authorization", 13, "", 0},
+    {"cache-control", 13, "", 0},
+    {"content-disposition", 19, "", 0},
+    {"content-encoding", 16, "", 0},
+    {"content-language", 16, "", 0},
+    {"content-length", 14, "", 0},
+    {"content-location", 16, "", 0},
+    {"content-range", 13, "", 0},
+    {"content-type", 12, "", 0},
+    {"cookie", 6, "", 0},
+    {"date", 4, "", 0},
+    {"etag", 4, "", 0},
+    {"expect", 6, "", 0},
+    {"expires", 7, "", 0},
+    {"from", 4, "", 0},
+    {"host", 4, "", 0},
+    {"if-match", 8, "", 0},
+    {"if-modified-since", 17, "", 0},
+    {"if-none-match", 13, "", 0},
+    {"if-range", 8, "", 0},
+    {"if-unmodified-since", 19, "", 0},
+    {"last-modified", 13, "", 0},
+    {"link", 4, "", 0},
+    {"location", 8, "", 0},
+    {"max-forwards", 12, "", 0},
+    {"proxy-authenticate", 18, "", 0},
+    {"proxy-authorization", 19, "", 0},
+    {"range", 5, "", 0},
+    {"referer", 7, "", 0},
+    {"refresh", 7, "", 0},
+    {"retry-after", 11, "", 0},
+    {"server", 6, "", 0},
+    {"set-cookie", 10, "", 0},
+    {"strict-transport-security", 25, "", 0},
+    {"transfer-encoding", 17, "", 0},
+    {"user-agent", 10, "", 0},
+    {"vary", 4, "", 0},
+    {"via", 3, "", 0},
+    {"www-authenticate", 16, "", 0},
+};
+
+// RFC 7541, Appendix B as canonical Huffman code:
+// number of codes of given length, first code of given length
+// and index of first symbol of given length in symbols table
+static const uint16_t huffmanCount[31] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+    0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+static const uint32_t huffmanFirstCode[31] = {
+    0, 0, 0, 0, 0, 0, 20, 92,
+    248, 508, 1016, 2042, 4090, 8184, 16380, 32764,
+    65534, 131068, 262136, 524272, 1048550, 2097116, 4194258, 8388568,
+    16777194, 33554412, 67108832, 134217694, 268435426, 536870910, 1073741820,
+};
+
+static const uint16_t huffmanFirstIndex[31] = {
+    0, 0, 0, 0, 0, 0, 10, 36, 68, 74, 74, 79, 82, 84, 90, 92,
+    95, 95, 95, 95, 98, 106, 119, 145, 174, 186, 190, 205, 224, 253, 253,
+};
+
+static const uint16_t huffmanSymbols[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37, 45, 46, 47, 51,
+    52, 53, 54, 55, 56, 57, 61, 65, 95, 98, 100, 102, 103, 104, 108, 109,
+    110, 112, 114, 117, 58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89, 106, 107, 113, 118,
+    119, 120, 121, 122, 38, 42, 44, 59, 88, 90, 33, 34, 40, 41, 63, 39,
+    43, 124, 35, 62, 0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161, 167, 172, 176, 177,
+    179, 209, 216, 217, 227, 229, 230, 129, 132, 133, 134, 136, 146, 154, 156, 160,
+    163, 164, 169, 170, 173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150, 151, 152, 155, 157,
+    158, 165, 166, 168, 174, 175, 180, 182, 183, 188, 191, 197, 231, 239, 9, 142,
+    144, 145, 148, 159, 171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243, 255, 203, 204, 211,
+    212, 214, 221, 222, 223, 241, 244, 245, 246, 247, 248, 250, 251, 252, 253, 254,
+    2, 3, 4, 5, 6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220, 249, 10, 13, 22,
+    256,
+};
+
+inline bool decodeInt(const uint8_t*& pos, const uint8_t* end, int prefixBits, uint64_t& value)
+{
+    const uint8_t mask = (1 << prefixBits) - 1;
+    value = *pos & mask;
+    ++pos;
+    if (value < mask)
+        return true;
+
+    for (int shift = 0; pos != end && shift <= 28; shift += 7) {
+        const uint8_t byte = *pos;
+        ++pos;
+        value += static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+inline void encodeInt(MemPool* pool, uint8_t first, int prefixBits, uint64_t value)
+{
+    const uint8_t mask = (1 << prefixBits) - 1;
+    if (value < mask) {
+        pool->putChar(static_cast<char>(first | value));
+        return;
+    }
+
+    pool->putChar(static_cast<char>(first | mask));
+    value -= mask;
+    for (; value >= 0x80; value >>= 7)
+        pool->putChar(static_cast<char>((value & 0x7f) | 0x80));
+    pool->putChar(static_cast<char>(value));
+}
+
+bool huffmanDecode(const uint8_t* data, uint64_t size, char* out, uint64_t& length)
+{
+    const uint8_t* end = data + size;
+    char* curr = out;
+    uint64_t bits = 0;
+    int bitCount = 0;
+
+    for (;;) {
+        while (bitCount <= 56 && data != end) {
+            bits = (bits << 8) | *data;
+            ++data;
+            bitCount += 8;
+        }
+
+        if (!bitCount)
+            break;
+
+        bool found = false;
+        for (int len = 5; len <= 30 && len <= bitCount; ++len) {
+            const uint32_t code = (bits >> (bitCount - len)) & ((1u << len) - 1);
+            const uint32_t offset = code - huffmanFirstCode[len];
+            if (offset < huffmanCount[len]) {
+                const uint16_t symbol = huffmanSymbols[huffmanFirstIndex[len] + offset];
+                if (symbol == 256) // EOS must not appear in string
+                    return false;
+                *curr = static_cast<char>(symbol);
+                ++curr;
+                bitCount -= len;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            // the rest must be padding: most significant bits of EOS, no longer than 7 bits
+            const uint64_t mask = (1ull << bitCount) - 1;
+            if (bitCount > 7 || (bits & mask) != mask)
+                return false;
+            break;
+        }
+    }
+
+    length = curr - out;
+    return true;
+}
+
+inline const char* copyString(const char* string, uint64_t size, MemPool* pool)
+{
+    char* result = pool->grow(size + 1);
+    memcpy(result, string, size);
+    result[size] = '\0';
+    return result;
+}
+
+const char* decodeString(const uint8_t*& pos, const uint8_t* end, MemPool* pool, uint64_t& length)
+{
+    NGREST_ASSERT(pos != end, "Unexpected end of header block");
+    const bool huffman = (*pos & 0x80) != 0;
+    uint64_t size = 0;
+    NGREST_ASSERT(decodeInt(pos, end, 7, size) && size <= static_cast<uint64_t>(end - pos),
+                  "Invalid string length in header block");
+
+    char* result;
+    if (huffman) {
+        // shortest huffman code is 5 bits long
+        const uint64_t maxLength = size * 8 / 5;
+        result = pool->grow(maxLength + 1);
+        NGREST_ASSERT(huffmanDecode(pos, size, result, length), "Invalid Huffman encoded string");
+        pool->shrinkLastChunk(maxLength - length);
+    } else {
+        result = pool->grow(size + 1);
+        memcpy(result, pos, size);
+        length = size;
+    }
+    result[length] = '\0';
+    pos += size;
+    return result;
+}
+
+
+HpackDecoder::HpackDecoder(uint64_t maxTableSize_):
+    tableLimit(maxTableSize_), maxTableSize(maxTableSize_)
+{
+}
+
+Header* HpackDecoder::decode(const uint8_t* data, uint64_t size, MemPool* pool)
+{
+    Header* first = nullptr;
+    Header** last = &first;
+    const uint8_t* pos = data;
+    const uint8_t* end = data + size;
+
+    while (pos != end) {
+        const uint8_t byte = *pos;
+        uint64_t index = 0;
+        const char* name;
+        const char* value;
+        uint64_t nameSize;
+        uint64_t valueSize;
+
+        if (byte & 0x80) {
+            // indexed header field
+            NGREST_ASSERT(decodeInt(pos, end, 7, index) && index, "Invalid header index");
+            getEntry(index, name, nameSize, value, valueSize);
+            name = copyString(name, nameSize, pool);
+            value = copyString(value, valueSize, pool);
+        } else if ((byte & 0xe0) == 0x20) {
+            // dynamic table size update
+            NGREST_ASSERT(decodeInt(pos, end, 5, index) && index <= maxTableSize,
+                          "Invalid dynamic table size update");
+            tableLimit = index;
+            evict(0);
+            continue;
+        } else {
+            // literal header field with incremental indexing, without indexing or never indexed
+            const bool indexing = (byte & 0xc0) == 0x40;
+            NGREST_ASSERT(decodeInt(pos, end, indexing ? 6 : 4, index), "Invalid header index");
+            if (index) {
+                getEntry(index, name, nameSize, value, valueSize);
+                name = copyString(name, nameSize, pool);
+            } else {
+                name = decodeString(pos, end, pool, nameSize);
+            }
+            value = decodeString(pos, end, pool, valueSize);
+            if (indexing)
+                insert(name, nameSize, value, valueSize);
+        }
+
+        *last = pool->alloc<Header>(name, value);
+        last = &(*last)->next;
+    }
+
+    return first;
+}
+
+void HpackDecoder::getEntry(uint64_t index, const char*& name, uint64_t& nameSize,
+                            const char*& value, uint64_t& valueSize) const
+{
+    if (index <= HPACK_STATIC_TABLE_SIZE) {
+        const StaticEntry& entry = staticTable[index - 1];
+        name = entry.name;
+        nameSize = entry.nameSize;
+        value = entry.value;
+        valueSize = entry.valueSize;
+    } else {
+        index -= HPACK_STATIC_TABLE_SIZE + 1;
+        NGREST_ASSERT(index < table.size(), "Header index is out of dynamic table");
+        const Entry& entry = table[index];
+        name = entry.name.data();
+        nameSize = entry.name.size();
+        value = entry.value.data();
+        valueSize = entry.value.size();
+    }
+}
+
+void HpackDecoder::insert(const char* name, uint64_t nameSize, const char* value, uint64_t valueSize)
+{
+    const uint64_t entrySize = nameSize + valueSize + HPACK_ENTRY_OVERHEAD;
+    // entry larger than table causes table to be emptied
+    evict(entrySize);
+    if (entrySize > tableLimit)
+        return;
+
+    table.push_front(Entry());
+    Entry& entry = table.front();
+    entry.name.assign(name, nameSize);
+    entry.value.assign(value, valueSize);
+    tableSize += entrySize;
+}
+
+void HpackDecoder::evict(uint64_t sizeRequired)
+{
+    while (!table.empty() && (tableSize + sizeRequired) > tableLimit) {
+        const Entry& entry = table.back();
+        tableSize -= entry.name.size() + entry.value.size() + HPACK_ENTRY_OVERHEAD;
+        table.pop_back();
+    }
+}
+
+
+void HpackEncoder::encodeStatus(MemPool* pool, int status)
+{
+    // indexed representation for statuses from static table
+    int index = 0;
+    switch (status) {
+    case 200: index = 8; break;
+    case 204: index = 9; break;
+    case 206: index = 10; break;
+    case 304: index = 11; break;
+    case 400: index = 12; break;
+    case 404: index = 13; break;
+    case 500: index = 14; break;
+    default:;
+    }
+
+    if (index) {
+        encodeInt(pool, 0x80, 7, index);
+        return;
+    }
+
+    // literal without indexing, name is :status from static table
+    NGREST_ASSERT(status >= 100 && status <= 999, "Invalid status code");
+    encodeInt(pool, 0x00, 4, 8);
+    pool->putChar(3);
+    char* value = pool->grow(3);
+    value[0] = '0' + status / 100;
+    value[1] = '0' + status / 10 % 10;
+    value[2] = '0' + status % 10;
+}
+
+void HpackEncoder::encodeHeader(MemPool* pool, const char* name, const char* value)
+{
+    const uint64_t nameSize = strlen(name);
+    const uint64_t valueSize = strlen(value);
+
+    // first static entry which isn't pseudo header is accept-charset
+    int index = 0;
+    for (int i = 14; i < HPACK_STATIC_TABLE_SIZE; ++i) {
+        const StaticEntry& entry = staticTable[i];
+        if (entry.nameSize == nameSize && !strncasecmp(entry.name, name, nameSize)) {
+            index = i + 1;
+            break;
+        }
+    }
+
+    // literal without indexing
+    encodeInt(pool, 0x00, 4, index);
+    if (!index) {
+        encodeInt(pool, 0x00, 7, nameSize);
+        char* lowerName = pool->grow(nameSize);
+        for (uint64_t i = 0; i < nameSize; ++i) {
+            const char ch = name[i];
+            lowerName[i] = (ch >= 'A' && ch <= 'Z') ? (ch | 0x20) : ch;
+        }
+    }
+
+    encodeInt(pool, 0x00, 7, valueSize);
+    pool->putData(value, valueSize);
+}
+
+}
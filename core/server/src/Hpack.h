@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_HPACK_H
+#define NGREST_HPACK_H
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+namespace ngrest {
+
+class MemPool;
+struct Header;
+
+/**
+ * @brief HPACK (RFC 7541) header block decoder. One decoder is used per HTTP/2 connection
+ */
+class HpackDecoder
+{
+public:
+    /**
+     * @brief constructor
+     * @param maxTableSize maximum size of dynamic table as announced in SETTINGS_HEADER_TABLE_SIZE
+     */
+    HpackDecoder(uint64_t maxTableSize = 4096);
+
+    /**
+     * @brief decode header block. Throws in case of compression error
+     * @param data header block
+     * @param size size of header block
+     * @param pool pool to allocate headers in. Names and values are '\0' terminated
+     * @return list of headers in order of appearance
+     */
+    Header* decode(const uint8_t* data, uint64_t size, MemPool* pool);
+
+private:
+    struct Entry
+    {
+        std::string name;
+        std::string value;
+    };
+
+    void getEntry(uint64_t index, const char*& name, uint64_t& nameSize,
+                  const char*& value, uint64_t& valueSize) const;
+    void insert(const char* name, uint64_t nameSize, const char* value, uint64_t valueSize);
+    void evict(uint64_t sizeRequired);
+
+private:
+    std::deque<Entry> table; // the newest entry is at the front
+    uint64_t tableSize = 0;
+    uint64_t tableLimit;
+    const uint64_t maxTableSize;
+};
+
+/**
+ * @brief HPACK (RFC 7541) header block encoder.
+ * Headers are encoded as literals without indexing, so encoder has no state
+ */
+class HpackEncoder
+{
+public:
+    /**
+     * @brief encode :status pseudo header
+     * @param pool pool to write header block to
+     * @param status HTTP status code
+     */
+    static void encodeStatus(MemPool* pool, int status);
+
+    /**
+     * @brief encode header. Header name is converted to lower case
+     * @param pool pool to write header block to
+     * @param name header name
+     * @param value header value
+     */
+    static void encodeHeader(MemPool* pool, const char* name, const char* value);
+};
+
+}
+
+#endif // NGREST_HPACK_H
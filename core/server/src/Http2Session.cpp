@@ -0,0 +1,1506 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <string.h>
+#ifndef WIN32
+#include <sys/socket.h>
+#include <sys/uio.h>
+#endif
+
+#include <ngrest/utils/Log.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/utils/MemPooler.h>
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/fromcstring.h>
+#include <ngrest/utils/tocstring.h>
+#include <ngrest/utils/ElapsedTimer.h>
+#include <ngrest/utils/Error.h>
+#include <ngrest/common/Message.h>
+#include <ngrest/common/HttpMessage.h>
+#include <ngrest/common/HttpException.h>
+#include <ngrest/common/ResponseStream.h>
+#include <ngrest/engine/Engine.h>
+#include <ngrest/engine/Phase.h>
+#include <ngrest/engine/Looper.h>
+
+#include "TimingWheel.h"
+#include "ClientHandler.h"
+#include "Http2Session.h"
+
+#define HTTP2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define HTTP2_PREFACE_SIZE 24
+#define HTTP2_FRAME_HEADER_SIZE 9
+#define HTTP2_DEFAULT_FRAME_SIZE 16384
+#define HTTP2_DEFAULT_WINDOW_SIZE 65535
+#define HTTP2_MAX_WINDOW_SIZE 0x7fffffff
+#define HTTP2_RECV_WINDOW_SIZE 1048576 // receive window of connection and every stream
+#define HTTP2_MAX_CONCURRENT_STREAMS 100
+#define HTTP2_MAX_HEADER_BLOCK_SIZE 65536
+#define HTTP2_OUTPUT_LIMIT 65536 // DATA frames are generated until this much data is waiting to be sent
+#define HTTP2_MAX_OUTPUT_SIZE 1048576 // client which doesn't read control frames replies is disconnected
+#define HTTP2_READ_SIZE 32768
+#define HTTP2_MAX_REQUEST_SIZE 10485760 // 10 Mb
+#define HTTP2_MAX_WRITE_IOV 64
+
+namespace ngrest {
+
+static const uint64_t INVALID_VALUE = static_cast<uint64_t>(-1);
+
+enum FrameType
+{
+    FRAME_DATA = 0x0,
+    FRAME_HEADERS = 0x1,
+    FRAME_PRIORITY = 0x2,
+    FRAME_RST_STREAM = 0x3,
+    FRAME_SETTINGS = 0x4,
+    FRAME_PUSH_PROMISE = 0x5,
+    FRAME_PING = 0x6,
+    FRAME_GOAWAY = 0x7,
+    FRAME_WINDOW_UPDATE = 0x8,
+    FRAME_CONTINUATION = 0x9
+};
+
+enum FrameFlag
+{
+    FLAG_END_STREAM = 0x1,
+    FLAG_ACK = 0x1,
+    FLAG_END_HEADERS = 0x4,
+    FLAG_PADDED = 0x8,
+    FLAG_PRIORITY = 0x20
+};
+
+enum Setting
+{
+    SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    SETTINGS_ENABLE_PUSH = 0x2,
+    SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    SETTINGS_MAX_FRAME_SIZE = 0x5
+};
+
+enum ErrorCode
+{
+    ERROR_NO_ERROR = 0x0,
+    ERROR_PROTOCOL_ERROR = 0x1,
+    ERROR_INTERNAL_ERROR = 0x2,
+    ERROR_FLOW_CONTROL_ERROR = 0x3,
+    ERROR_STREAM_CLOSED = 0x5,
+    ERROR_FRAME_SIZE_ERROR = 0x6,
+    ERROR_REFUSED_STREAM = 0x7,
+    ERROR_CANCEL = 0x8,
+    ERROR_COMPRESSION_ERROR = 0x9,
+    ERROR_ENHANCE_YOUR_CALM = 0xb
+};
+
+enum class StreamState
+{
+    Receiving,  // receiving request
+    Processing, // request is being processed by engine
+    Sending     // sending response
+};
+
+inline uint32_t readUint32(const uint8_t* data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16)
+            | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+inline void writeUint32(uint8_t* data, uint32_t value)
+{
+    data[0] = static_cast<uint8_t>(value >> 24);
+    data[1] = static_cast<uint8_t>(value >> 16);
+    data[2] = static_cast<uint8_t>(value >> 8);
+    data[3] = static_cast<uint8_t>(value);
+}
+
+inline const char* copyString(MemPool* pool, const char* string)
+{
+    return pool->putData(string, strlen(string) + 1);
+}
+
+// strip padding of DATA and HEADERS frames
+inline bool removePadding(uint8_t flags, const uint8_t*& payload, uint32_t& length)
+{
+    if (!(flags & FLAG_PADDED))
+        return true;
+
+    if (!length || payload[0] >= length)
+        return false;
+
+    length -= 1 + payload[0];
+    ++payload;
+    return true;
+}
+
+// HTTP2-Settings header is base64url encoded SETTINGS payload
+bool decodeBase64Url(const char* data, MemPool* pool)
+{
+    uint32_t bits = 0;
+    int bitCount = 0;
+    for (const char* curr = data; *curr && *curr != '='; ++curr) {
+        const char ch = *curr;
+        uint32_t value;
+        if (ch >= 'A' && ch <= 'Z') {
+            value = ch - 'A';
+        } else if (ch >= 'a' && ch <= 'z') {
+            value = ch - 'a' + 26;
+        } else if (ch >= '0' && ch <= '9') {
+            value = ch - '0' + 52;
+        } else if (ch == '-' || ch == '+') {
+            value = 62;
+        } else if (ch == '_' || ch == '/') {
+            value = 63;
+        } else {
+            return false;
+        }
+
+        bits = (bits << 6) | value;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            pool->putChar(static_cast<char>(bits >> bitCount));
+        }
+    }
+    return true;
+}
+
+// connection-specific headers are not allowed in HTTP/2
+inline bool isConnectionHeader(const char* name)
+{
+    return !strcasecmp(name, "connection") || !strcasecmp(name, "keep-alive")
+            || !strcasecmp(name, "proxy-connection") || !strcasecmp(name, "transfer-encoding")
+            || !strcasecmp(name, "upgrade");
+}
+
+
+struct Http2Stream
+{
+    uint32_t id;
+    StreamState state = StreamState::Receiving;
+    bool reset = false; // stream is reset while being processed, response will be discarded
+    uint64_t requestId = 0;
+    ElapsedTimer timer;
+    MessageContext context;
+    HttpRequest request;
+    HttpResponse response;
+    MemPooler* pooler;
+    MemPool* poolBody = nullptr; // request body
+    MemPool* poolWrite; // response body
+    uint64_t contentLength = INVALID_VALUE;
+    uint64_t bodySize = 0;
+
+    // flow control
+    int64_t sendWindow;
+    int64_t recvWindow = HTTP2_RECV_WINDOW_SIZE;
+
+    // position of the data to send in poolWrite
+    int chunkIndex = 0;
+    uint64_t chunkPos = 0;
+    bool queued = false;
+
+    // streamed response: poolWrite is being sent while producer writes the next part to poolStream
+    ResponseProducer* producer = nullptr;
+    ResponseStream* stream = nullptr;
+    MemPool* poolStream = nullptr;
+    bool producePending = false; // producer is called and hasn't written anything yet
+    bool streamWaiting = false; // everything is sent, waiting for producer to write the next part
+    bool streamFinished = false;
+
+    Http2Stream(uint32_t id_, ClientHandler* handler, Engine* engine, Transport* transport, MemPooler* pooler_,
+                ClientAddress* address, int64_t sendWindow_):
+        id(id_),
+        pooler(pooler_),
+        poolWrite(pooler->obtain(4096)),
+        sendWindow(sendWindow_)
+    {
+        request.clientAddress = address;
+        response.poolBody = poolWrite;
+
+        context.pool = pooler->obtain();
+        context.engine = engine;
+        context.transport = transport;
+        context.request = &request;
+        context.response = &response;
+    }
+
+    ~Http2Stream()
+    {
+        if (poolBody)
+            pooler->recycle(poolBody);
+        pooler->recycle(poolWrite);
+        if (poolStream)
+            pooler->recycle(poolStream);
+        pooler->recycle(context.pool);
+    }
+
+    uint64_t getPendingData() const
+    {
+        const MemPool::Chunk* last = poolWrite->getLastChunk();
+        if (!last)
+            return 0;
+
+        uint64_t size = 0;
+        for (const MemPool::Chunk* chunk = poolWrite->getChunks() + chunkIndex; chunk <= last; ++chunk)
+            size += chunk->size;
+        return size - chunkPos;
+    }
+};
+
+
+class Http2StreamCallback: public MessageCallback
+{
+public:
+    Http2StreamCallback(Http2Session* session_, Http2Stream* stream_, Looper* looper_):
+        session(session_), stream(stream_), looper(looper_)
+    {
+    }
+
+    void success()
+    {
+        // in multithreaded mode the response must be sent from the thread owning the client
+        if (Looper::getCurrentLooper() != looper) {
+            Http2Session* session = this->session;
+            Http2Stream* stream = this->stream;
+            looper->post([session, stream] {
+                session->processResponse(stream);
+            });
+            return;
+        }
+
+        session->processResponse(stream);
+    }
+
+    void error(const Exception& error)
+    {
+        if (Looper::getCurrentLooper() != looper) {
+            Http2Session* session = this->session;
+            Http2Stream* stream = this->stream;
+            looper->postError([session, stream] (const Exception& error) {
+                session->processError(stream, error);
+            }, error);
+            return;
+        }
+
+        session->processError(stream, error);
+    }
+
+    Http2Session* session;
+    Http2Stream* stream;
+    Looper* looper;
+};
+
+class Http2ResponseStream: public ResponseStream
+{
+public:
+    Http2ResponseStream(Http2Session* session_, Http2Stream* stream_):
+        session(session_), stream(stream_)
+    {
+    }
+
+    bool write(const char* data, uint64_t size) override
+    {
+        return session->writeStream(stream, data, size);
+    }
+
+    void finish() override
+    {
+        session->finishStream(stream);
+    }
+
+    Http2Session* session;
+    Http2Stream* stream;
+};
+
+
+Http2Session::Http2Session(ClientHandler* handler_, Socket fd_, const SocketAddress& address_, Timer* timer_):
+    handler(handler_), fd(fd_), timer(timer_),
+    headerBlock(handler->pooler->obtain()),
+    sendWindow(HTTP2_DEFAULT_WINDOW_SIZE),
+    recvWindow(HTTP2_DEFAULT_WINDOW_SIZE),
+    initialWindowSize(HTTP2_DEFAULT_WINDOW_SIZE),
+    maxFrameSize(HTTP2_DEFAULT_FRAME_SIZE),
+    poolRead(handler->pooler->obtain(HTTP2_READ_SIZE)),
+    poolOut(handler->pooler->obtain(HTTP2_OUTPUT_LIMIT)),
+    poolHeaders(handler->pooler->obtain())
+{
+    // session may outlive client context when connection is closed while processing streams
+    address.set(address_);
+    poolRead->reserve(HTTP2_READ_SIZE);
+}
+
+Http2Session::~Http2Session()
+{
+    for (auto& it : streams)
+        delete it.second;
+
+    MemPooler* pooler = handler->pooler;
+    pooler->recycle(headerBlock);
+    pooler->recycle(poolRead);
+    pooler->recycle(poolOut);
+    pooler->recycle(poolHeaders);
+}
+
+bool Http2Session::isPreface(const char* data, uint64_t size)
+{
+    return !memcmp(data, HTTP2_PREFACE, size < HTTP2_PREFACE_SIZE ? size : HTTP2_PREFACE_SIZE);
+}
+
+bool Http2Session::start(const char* data, uint64_t size)
+{
+    LogDebug() << "Starting HTTP/2 session on client #" << fd;
+    poolRead->getLastChunk()->size = 0;
+    poolRead->putData(data, size);
+    writeSettings();
+    return readyRead();
+}
+
+bool Http2Session::upgrade(const HttpRequest* request, const char* settings, const char* data, uint64_t size)
+{
+    LogDebug() << "Upgrading client #" << fd << " to HTTP/2";
+    poolOut->putCString("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    writeSettings();
+
+    // settings of client are acknowledged implicitly by 101 response
+    poolHeaders->reset();
+    if (!decodeBase64Url(settings, poolHeaders)) {
+        LogDebug() << "Invalid HTTP2-Settings header";
+        return false;
+    }
+    const MemPool::Chunk* chunk = poolHeaders->flatten(false);
+    const bool settingsValid = !chunk || applySettings(reinterpret_cast<const uint8_t*>(chunk->buffer), chunk->size);
+    poolHeaders->reset();
+    if (!settingsValid)
+        return false;
+
+    // the request is the first stream, half closed by client
+    Http2Stream* stream = new Http2Stream(1, handler, &handler->engine, &handler->transport, handler->pooler,
+                                          &address, initialWindowSize);
+    streams[1] = stream;
+    lastStreamId = 1;
+
+    MemPool* pool = stream->context.pool;
+    stream->request.setMethod(copyString(pool, request->methodStr));
+    stream->request.path = copyString(pool, request->path);
+    Header** last = &stream->request.headers;
+    for (const Header* header = request->headers; header; header = header->next) {
+        if (isConnectionHeader(header->name) || !strcmp(header->name, "http2-settings"))
+            continue;
+        *last = pool->alloc<Header>(copyString(pool, header->name), copyString(pool, header->value));
+        last = &(*last)->next;
+    }
+
+    poolRead->getLastChunk()->size = 0;
+    poolRead->putData(data, size);
+
+    inRead = true;
+    dispatch(stream);
+    inRead = false;
+
+    return readyRead();
+}
+
+bool Http2Session::readyRead()
+{
+    inRead = true;
+    const bool res = readFrames();
+    inRead = false;
+
+    if (!res) {
+        // try to send GOAWAY before connection is closed
+        flush();
+        return false;
+    }
+
+    if (flush() == Status::Close)
+        return false;
+
+    updateTimeout();
+    return true;
+}
+
+Status Http2Session::readyWrite()
+{
+    return flush();
+}
+
+bool Http2Session::close()
+{
+    closed = true;
+    for (auto it = streams.begin(); it != streams.end();) {
+        Http2Stream* stream = it->second;
+        ++it;
+        // processed streams are deleted when processing is finished
+        if (stream->state != StreamState::Processing)
+            deleteStream(stream);
+    }
+
+    return !processingCount;
+}
+
+bool Http2Session::readFrames()
+{
+    for (;;) {
+        if (!processInput())
+            return false;
+
+        // keep free space for the largest frame, so every frame is received into single chunk
+        MemPool::Chunk* chunk = poolRead->getLastChunk();
+        const uint64_t requiredSize = chunk->size + HTTP2_FRAME_HEADER_SIZE + HTTP2_DEFAULT_FRAME_SIZE;
+        if (chunk->bufferSize < requiredSize) {
+            poolRead->reserve(requiredSize);
+            chunk = poolRead->getLastChunk();
+        }
+
+        const uint64_t sizeToRead = chunk->bufferSize - chunk->size;
+        ssize_t received = ::recv(fd, chunk->buffer + chunk->size, sizeToRead, 0);
+        if (received == 0) {
+            // EOF. The remote has closed the connection.
+            LogDebug() << "client #" << fd << " closed connection";
+            return false;
+        }
+
+        if (received == -1) {
+            // all available data read
+            if (errno == EAGAIN)
+                return true;
+
+            if (errno == EINTR)
+                continue;
+
+            LogError() << "failed to read block from client #" << fd << ": " << strerror(errno);
+            return false;
+        }
+
+        chunk->size += static_cast<uint64_t>(received);
+    }
+}
+
+bool Http2Session::processInput()
+{
+    MemPool::Chunk* chunk = poolRead->getLastChunk();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(chunk->buffer);
+    const uint64_t size = chunk->size;
+    uint64_t offset = 0;
+
+    if (!prefaceReceived) {
+        if (!isPreface(chunk->buffer, size)) {
+            LogDebug() << "Invalid HTTP/2 connection preface from client #" << fd;
+            return false;
+        }
+
+        if (size < HTTP2_PREFACE_SIZE)
+            return true;
+
+        prefaceReceived = true;
+        offset = HTTP2_PREFACE_SIZE;
+    }
+
+    bool res = true;
+    while ((size - offset) >= HTTP2_FRAME_HEADER_SIZE) {
+        const uint8_t* header = data + offset;
+        const uint32_t length = (static_cast<uint32_t>(header[0]) << 16)
+                | (static_cast<uint32_t>(header[1]) << 8) | header[2];
+        if (length > HTTP2_DEFAULT_FRAME_SIZE) {
+            res = connectionError(ERROR_FRAME_SIZE_ERROR, "Frame is too large");
+            break;
+        }
+
+        if ((size - offset - HTTP2_FRAME_HEADER_SIZE) < length)
+            break; // frame is not received completely
+
+        offset += HTTP2_FRAME_HEADER_SIZE + length;
+        if (!processFrame(header[3], header[4], readUint32(header + 5) & HTTP2_MAX_WINDOW_SIZE,
+                          header + HTTP2_FRAME_HEADER_SIZE, length)) {
+            res = false;
+            break;
+        }
+
+        if (getOutputSize() > HTTP2_MAX_OUTPUT_SIZE) {
+            res = connectionError(ERROR_ENHANCE_YOUR_CALM, "Client doesn't read replies");
+            break;
+        }
+    }
+
+    // move incomplete frame to the beginning of buffer
+    if (offset) {
+        memmove(chunk->buffer, chunk->buffer + offset, size - offset);
+        chunk->size = size - offset;
+    }
+
+    return res;
+}
+
+bool Http2Session::processFrame(uint8_t type, uint8_t flags, uint32_t streamId,
+                                const uint8_t* payload, uint32_t length)
+{
+    if (expectContinuation && type != FRAME_CONTINUATION)
+        return connectionError(ERROR_PROTOCOL_ERROR, "CONTINUATION frame expected");
+
+    switch (type) {
+    case FRAME_DATA:
+        return processData(flags, streamId, payload, length);
+
+    case FRAME_HEADERS:
+        return processHeaders(flags, streamId, payload, length);
+
+    case FRAME_PRIORITY:
+        // priorities are not used
+        if (!streamId)
+            return connectionError(ERROR_PROTOCOL_ERROR, "PRIORITY frame on stream 0");
+        if (length != 5)
+            resetStream(streamId, ERROR_FRAME_SIZE_ERROR);
+        return true;
+
+    case FRAME_RST_STREAM:
+        return processReset(streamId, length);
+
+    case FRAME_SETTINGS:
+        return processSettings(flags, streamId, payload, length);
+
+    case FRAME_PUSH_PROMISE:
+        return connectionError(ERROR_PROTOCOL_ERROR, "Client must not send PUSH_PROMISE");
+
+    case FRAME_PING:
+        if (streamId)
+            return connectionError(ERROR_PROTOCOL_ERROR, "PING frame on stream");
+        if (length != 8)
+            return connectionError(ERROR_FRAME_SIZE_ERROR, "Invalid size of PING frame");
+        if (!(flags & FLAG_ACK)) {
+            writeFrameHeader(8, FRAME_PING, FLAG_ACK, 0);
+            poolOut->putData(reinterpret_cast<const char*>(payload), 8);
+        }
+        return true;
+
+    case FRAME_GOAWAY:
+        if (streamId)
+            return connectionError(ERROR_PROTOCOL_ERROR, "GOAWAY frame on stream");
+        if (length < 8)
+            return connectionError(ERROR_FRAME_SIZE_ERROR, "Invalid size of GOAWAY frame");
+        LogDebug() << "Client #" << fd << " is going away, error code: " << readUint32(payload + 4);
+        goingAway = true;
+        return true;
+
+    case FRAME_WINDOW_UPDATE:
+        return processWindowUpdate(streamId, payload, length);
+
+    case FRAME_CONTINUATION:
+        return processContinuation(flags, streamId, payload, length);
+
+    default:
+        // unknown frames must be ignored
+        return true;
+    }
+}
+
+bool Http2Session::processData(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length)
+{
+    if (!streamId)
+        return connectionError(ERROR_PROTOCOL_ERROR, "DATA frame on stream 0");
+
+    // flow control counts the whole payload including padding
+    const uint32_t frameSize = length;
+    if (frameSize > recvWindow)
+        return connectionError(ERROR_FLOW_CONTROL_ERROR, "Connection flow control window exceeded");
+    recvWindow -= frameSize;
+    if (recvWindow <= HTTP2_RECV_WINDOW_SIZE / 2) {
+        writeWindowUpdate(0, static_cast<uint32_t>(HTTP2_RECV_WINDOW_SIZE - recvWindow));
+        recvWindow = HTTP2_RECV_WINDOW_SIZE;
+    }
+
+    if (!removePadding(flags, payload, length))
+        return connectionError(ERROR_PROTOCOL_ERROR, "Invalid padding");
+
+    Http2Stream* stream = findStream(streamId);
+    if (!stream || stream->state != StreamState::Receiving) {
+        if (streamId > lastStreamId)
+            return connectionError(ERROR_PROTOCOL_ERROR, "DATA frame on idle stream");
+        resetStream(streamId, ERROR_STREAM_CLOSED);
+        return true;
+    }
+
+    if (frameSize > stream->recvWindow) {
+        resetStream(streamId, ERROR_FLOW_CONTROL_ERROR);
+        return true;
+    }
+    stream->recvWindow -= frameSize;
+
+    stream->bodySize += length;
+    if (stream->bodySize > HTTP2_MAX_REQUEST_SIZE) {
+        LogDebug() << "Request is too large!";
+        resetStream(streamId, ERROR_CANCEL);
+        return true;
+    }
+
+    if (length) {
+        if (!stream->poolBody) {
+            stream->poolBody = stream->pooler->obtain(1024);
+            // receive body of known size into single chunk
+            if (stream->contentLength != INVALID_VALUE && stream->contentLength < HTTP2_MAX_REQUEST_SIZE)
+                stream->poolBody->reserve(stream->contentLength + 1);
+        }
+        // keep body in single chunk so it's not copied on flatten
+        memcpy(stream->poolBody->growContiguous(length), payload, length);
+    }
+
+    if (flags & FLAG_END_STREAM) {
+        finishRequest(stream);
+    } else if (stream->recvWindow <= HTTP2_RECV_WINDOW_SIZE / 2) {
+        writeWindowUpdate(streamId, static_cast<uint32_t>(HTTP2_RECV_WINDOW_SIZE - stream->recvWindow));
+        stream->recvWindow = HTTP2_RECV_WINDOW_SIZE;
+    }
+
+    return true;
+}
+
+bool Http2Session::processHeaders(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length)
+{
+    if (!streamId)
+        return connectionError(ERROR_PROTOCOL_ERROR, "HEADERS frame on stream 0");
+
+    if (!removePadding(flags, payload, length))
+        return connectionError(ERROR_PROTOCOL_ERROR, "Invalid padding");
+
+    if (flags & FLAG_PRIORITY) {
+        if (length < 5)
+            return connectionError(ERROR_FRAME_SIZE_ERROR, "Invalid size of HEADERS frame");
+        payload += 5;
+        length -= 5;
+    }
+
+    headerBlock->reset();
+    headerBlock->putData(reinterpret_cast<const char*>(payload), length);
+    headerStreamId = streamId;
+    headerFlags = flags;
+
+    if (flags & FLAG_END_HEADERS)
+        return processHeaderBlock();
+
+    expectContinuation = true;
+    return true;
+}
+
+bool Http2Session::processContinuation(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length)
+{
+    if (!expectContinuation || streamId != headerStreamId)
+        return connectionError(ERROR_PROTOCOL_ERROR, "Unexpected CONTINUATION frame");
+
+    if ((headerBlock->getSize() + length) > HTTP2_MAX_HEADER_BLOCK_SIZE)
+        return connectionError(ERROR_ENHANCE_YOUR_CALM, "Header block is too large");
+
+    headerBlock->putData(reinterpret_cast<const char*>(payload), length);
+
+    if (!(flags & FLAG_END_HEADERS))
+        return true;
+
+    expectContinuation = false;
+    return processHeaderBlock();
+}
+
+bool Http2Session::processHeaderBlock()
+{
+    const MemPool::Chunk* block = headerBlock->flatten(false);
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(block->buffer);
+    const uint32_t streamId = headerStreamId;
+
+    Http2Stream* stream = findStream(streamId);
+    if (stream) {
+        // trailers. they are decoded to keep decoder state and ignored
+        if (stream->state != StreamState::Receiving)
+            return connectionError(ERROR_STREAM_CLOSED, "HEADERS frame on closed stream");
+
+        try {
+            decoder.decode(data, block->size, stream->context.pool);
+        } catch (const Exception& error) {
+            return connectionError(ERROR_COMPRESSION_ERROR, error.what());
+        }
+
+        if (!(headerFlags & FLAG_END_STREAM)) {
+            resetStream(streamId, ERROR_PROTOCOL_ERROR);
+            return true;
+        }
+
+        finishRequest(stream);
+        return true;
+    }
+
+    if (streamId <= lastStreamId || !(streamId & 1))
+        return connectionError(ERROR_PROTOCOL_ERROR, "Invalid stream identifier");
+    lastStreamId = streamId;
+
+    if (goingAway || streams.size() >= HTTP2_MAX_CONCURRENT_STREAMS) {
+        try {
+            decoder.decode(data, block->size, poolHeaders);
+        } catch (const Exception& error) {
+            return connectionError(ERROR_COMPRESSION_ERROR, error.what());
+        }
+        poolHeaders->reset();
+        resetStream(streamId, ERROR_REFUSED_STREAM);
+        return true;
+    }
+
+    stream = new Http2Stream(streamId, handler, &handler->engine, &handler->transport, handler->pooler,
+                             &address, initialWindowSize);
+    streams[streamId] = stream;
+
+    Header* headers;
+    try {
+        headers = decoder.decode(data, block->size, stream->context.pool);
+    } catch (const Exception& error) {
+        return connectionError(ERROR_COMPRESSION_ERROR, error.what());
+    }
+
+    if (!parseRequestHeaders(stream, headers)) {
+        LogDebug() << "Malformed request on stream " << streamId;
+        resetStream(streamId, ERROR_PROTOCOL_ERROR);
+        return true;
+    }
+
+    if (headerFlags & FLAG_END_STREAM)
+        finishRequest(stream);
+
+    return true;
+}
+
+bool Http2Session::processSettings(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length)
+{
+    if (streamId)
+        return connectionError(ERROR_PROTOCOL_ERROR, "SETTINGS frame on stream");
+
+    if (flags & FLAG_ACK) {
+        if (length)
+            return connectionError(ERROR_FRAME_SIZE_ERROR, "SETTINGS acknowledgement with payload");
+        return true;
+    }
+
+    if (!applySettings(payload, length))
+        return false;
+
+    writeFrameHeader(0, FRAME_SETTINGS, FLAG_ACK, 0);
+    return true;
+}
+
+bool Http2Session::applySettings(const uint8_t* payload, uint32_t length)
+{
+    if (length % 6)
+        return connectionError(ERROR_FRAME_SIZE_ERROR, "Invalid size of SETTINGS frame");
+
+    for (const uint8_t* end = payload + length; payload != end; payload += 6) {
+        const uint16_t id = static_cast<uint16_t>((payload[0] << 8) | payload[1]);
+        const uint32_t value = readUint32(payload + 2);
+        switch (id) {
+        case SETTINGS_ENABLE_PUSH:
+            if (value > 1)
+                return connectionError(ERROR_PROTOCOL_ERROR, "Invalid value of SETTINGS_ENABLE_PUSH");
+            break;
+
+        case SETTINGS_INITIAL_WINDOW_SIZE: {
+            if (value > HTTP2_MAX_WINDOW_SIZE)
+                return connectionError(ERROR_FLOW_CONTROL_ERROR, "Invalid value of SETTINGS_INITIAL_WINDOW_SIZE");
+
+            // change affects send windows of all streams
+            const int64_t delta = static_cast<int64_t>(value) - initialWindowSize;
+            initialWindowSize = value;
+            for (auto& it : streams) {
+                Http2Stream* stream = it.second;
+                stream->sendWindow += delta;
+                if (stream->sendWindow > HTTP2_MAX_WINDOW_SIZE)
+                    return connectionError(ERROR_FLOW_CONTROL_ERROR, "Stream flow control window overflow");
+                if (delta > 0 && stream->state == StreamState::Sending)
+                    queueStream(stream);
+            }
+            break;
+        }
+
+        case SETTINGS_MAX_FRAME_SIZE:
+            if (value < HTTP2_DEFAULT_FRAME_SIZE || value > 0xffffff)
+                return connectionError(ERROR_PROTOCOL_ERROR, "Invalid value of SETTINGS_MAX_FRAME_SIZE");
+            maxFrameSize = value;
+            break;
+
+        default:
+            // encoder doesn't use dynamic table, other settings are not used by server
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool Http2Session::processWindowUpdate(uint32_t streamId, const uint8_t* payload, uint32_t length)
+{
+    if (length != 4)
+        return connectionError(ERROR_FRAME_SIZE_ERROR, "Invalid size of WINDOW_UPDATE frame");
+
+    const uint32_t increment = readUint32(payload) & HTTP2_MAX_WINDOW_SIZE;
+    if (!streamId) {
+        if (!increment)
+            return connectionError(ERROR_PROTOCOL_ERROR, "Invalid WINDOW_UPDATE increment");
+        sendWindow += increment;
+        if (sendWindow > HTTP2_MAX_WINDOW_SIZE)
+            return connectionError(ERROR_FLOW_CONTROL_ERROR, "Connection flow control window overflow");
+        return true;
+    }
+
+    Http2Stream* stream = findStream(streamId);
+    if (!stream) {
+        if (streamId > lastStreamId)
+            return connectionError(ERROR_PROTOCOL_ERROR, "WINDOW_UPDATE frame on idle stream");
+        return true; // stream is closed already
+    }
+
+    if (!increment) {
+        resetStream(streamId, ERROR_PROTOCOL_ERROR);
+        return true;
+    }
+
+    stream->sendWindow += increment;
+    if (stream->sendWindow > HTTP2_MAX_WINDOW_SIZE) {
+        resetStream(streamId, ERROR_FLOW_CONTROL_ERROR);
+        return true;
+    }
+
+    if (stream->state == StreamState::Sending)
+        queueStream(stream);
+    return true;
+}
+
+bool Http2Session::processReset(uint32_t streamId, uint32_t length)
+{
+    if (!streamId)
+        return connectionError(ERROR_PROTOCOL_ERROR, "RST_STREAM frame on stream 0");
+    if (length != 4)
+        return connectionError(ERROR_FRAME_SIZE_ERROR, "Invalid size of RST_STREAM frame");
+    if (streamId > lastStreamId)
+        return connectionError(ERROR_PROTOCOL_ERROR, "RST_STREAM frame on idle stream");
+
+    Http2Stream* stream = findStream(streamId);
+    if (stream) {
+        LogDebug() << "Stream " << streamId << " is reset by client #" << fd;
+        cancelStream(stream);
+    }
+    return true;
+}
+
+bool Http2Session::connectionError(uint32_t errorCode, const char* message)
+{
+    LogDebug() << "HTTP/2 connection error on client #" << fd << ": " << message;
+    writeFrameHeader(8, FRAME_GOAWAY, 0, 0);
+    uint8_t* payload = reinterpret_cast<uint8_t*>(poolOut->grow(8));
+    writeUint32(payload, lastStreamId);
+    writeUint32(payload + 4, errorCode);
+    goingAway = true;
+    return false;
+}
+
+bool Http2Session::parseRequestHeaders(Http2Stream* stream, Header* headers)
+{
+    HttpRequest& request = stream->request;
+    const char* method = nullptr;
+    const char* authority = nullptr;
+    bool hasHost = false;
+    Header** last = &request.headers;
+
+    for (Header* header = headers; header; header = header->next) {
+        const char* name = header->name;
+        if (name[0] == ':') {
+            // pseudo headers must precede regular headers
+            if (request.headers)
+                return false;
+
+            if (!strcmp(name, ":method")) {
+                method = header->value;
+            } else if (!strcmp(name, ":path")) {
+                request.path = header->value;
+            } else if (!strcmp(name, ":authority")) {
+                authority = header->value;
+            } else if (strcmp(name, ":scheme")) {
+                return false;
+            }
+            continue;
+        }
+
+        for (const char* curr = name; *curr; ++curr) {
+            if (*curr >= 'A' && *curr <= 'Z')
+                return false;
+        }
+
+        if (isConnectionHeader(name))
+            return false;
+
+        if (!strcmp(name, "host")) {
+            hasHost = true;
+        } else if (!strcmp(name, "content-length")) {
+            if (!fromCString(header->value, stream->contentLength))
+                return false;
+        }
+
+        *last = header;
+        last = &header->next;
+    }
+    *last = nullptr;
+
+    if (!method || !request.path || !request.path[0])
+        return false;
+
+    request.setMethod(method);
+
+    // services may expect host header
+    if (authority && !hasHost)
+        request.headers = stream->context.pool->alloc<Header>("host", authority, request.headers);
+
+    return true;
+}
+
+void Http2Session::finishRequest(Http2Stream* stream)
+{
+    if (stream->contentLength != INVALID_VALUE && stream->contentLength != stream->bodySize) {
+        LogDebug() << "Request body doesn't match content-length on stream " << stream->id;
+        resetStream(stream->id, ERROR_PROTOCOL_ERROR);
+        return;
+    }
+
+    if (stream->poolBody) {
+        MemPool::Chunk* chunk = stream->poolBody->flatten();
+        stream->request.body = chunk->buffer;
+        stream->request.bodySize = chunk->size;
+        stream->request.poolBody = stream->poolBody;
+    }
+
+    dispatch(stream);
+}
+
+void Http2Session::dispatch(Http2Stream* stream)
+{
+    stream->state = StreamState::Processing;
+    stream->requestId = ++handler->lastId;
+    stream->timer.start();
+    ++processingCount;
+
+    stream->context.callback = stream->context.pool
+            ->alloc<Http2StreamCallback>(this, stream, Looper::getCurrentLooper());
+    try {
+        handler->engine.runPhase(Phase::Header, &stream->context);
+        handler->engine.dispatchMessage(&stream->context);
+    } catch (const Exception& error) {
+        processError(stream, error);
+    }
+}
+
+Http2Stream* Http2Session::findStream(uint32_t streamId)
+{
+    auto it = streams.find(streamId);
+    return (it != streams.end()) ? it->second : nullptr;
+}
+
+void Http2Session::resetStream(uint32_t streamId, uint32_t errorCode)
+{
+    writeFrameHeader(4, FRAME_RST_STREAM, 0, streamId);
+    writeUint32(reinterpret_cast<uint8_t*>(poolOut->grow(4)), errorCode);
+
+    Http2Stream* stream = findStream(streamId);
+    if (stream)
+        cancelStream(stream);
+}
+
+void Http2Session::cancelStream(Http2Stream* stream)
+{
+    if (stream->state == StreamState::Processing) {
+        // stream will be deleted when processing is finished
+        stream->reset = true;
+        return;
+    }
+
+    deleteStream(stream);
+}
+
+void Http2Session::deleteStream(Http2Stream* stream)
+{
+    streams.erase(stream->id);
+    if (stream->producer && !stream->streamFinished) {
+        // streamed response is interrupted. producer is the only one who could still refer to the stream
+        ResponseProducer* producer = stream->producer;
+        stream->producer = nullptr;
+        producer->abort();
+    }
+    delete stream;
+
+    if (!closed && streams.empty())
+        updateTimeout();
+}
+
+void Http2Session::queueStream(Http2Stream* stream)
+{
+    if (stream->queued)
+        return;
+
+    stream->queued = true;
+    writable.push_back(stream->id);
+}
+
+void Http2Session::processResponse(Http2Stream* stream)
+{
+    --processingCount;
+
+    HttpResponse* response = &stream->response;
+    if (closed || stream->reset) {
+        // nobody will read the response
+        if (response->producer)
+            response->producer->abort();
+        deleteStream(stream);
+        if (closed && !processingCount)
+            delete this;
+        return;
+    }
+
+    stream->state = StreamState::Sending;
+
+    if (response->statusCode == HTTP_STATUS_UNDEFINED)
+        response->statusCode = HTTP_STATUS_200_OK;
+    HpackEncoder::encodeStatus(poolHeaders, response->statusCode);
+    for (const Header* header = response->headers; header; header = header->next) {
+        if (!isConnectionHeader(header->name))
+            HpackEncoder::encodeHeader(poolHeaders, header->name, header->value);
+    }
+
+    // server
+    HpackEncoder::encodeHeader(poolHeaders, "server", "ngrest");
+
+    const uint64_t bodySize = response->poolBody->getSize();
+    if (!response->producer && response->statusCode != HTTP_STATUS_304_NOT_MODIFIED) {
+        // content-length
+        const int buffSize = 32;
+        char buff[buffSize];
+        NGREST_ASSERT(toCString(bodySize, buff, buffSize), "Failed to write Content-Length");
+        HpackEncoder::encodeHeader(poolHeaders, "content-length", buff);
+    }
+    const char* serverDate = handler->getServerDate();
+    if (serverDate)
+        HpackEncoder::encodeHeader(poolHeaders, "date", serverDate);
+
+    const bool endStream = !response->producer && !bodySize;
+    writeHeaders(stream->id, endStream);
+
+    if (endStream) {
+        LogDebug() << "Request " << stream->requestId << " handled in "
+                   << stream->timer.elapsed() << " microsecond(s)";
+        deleteStream(stream);
+    } else {
+        if (response->producer) {
+            // body written before the producer was set is sent as the first part
+            stream->poolStream = stream->pooler->obtain(4096);
+            stream->producer = response->producer;
+            stream->stream = stream->context.pool->alloc<Http2ResponseStream>(this, stream);
+        }
+        queueStream(stream);
+    }
+
+    send();
+}
+
+void Http2Session::processError(Http2Stream* stream, const Exception& error)
+{
+    const char* path = stream->request.path;
+    LogDebug() << "Error while handling request " << (path ? path : "<invalid>");
+
+    HttpResponse* response = &stream->response;
+    if (response->statusCode == HTTP_STATUS_UNDEFINED) {
+        try {
+             throw; // we're called from catch block
+        } catch (const HttpException& e) {
+            response->statusCode = e.getHttpStatus();
+        } catch (...) {
+            response->statusCode = HTTP_STATUS_500_INTERNAL_SERVER_ERROR;
+        }
+    }
+    Header headerContentType("Content-Type", "text/plain");
+    response->headers = &headerContentType;
+    response->producer = nullptr;
+    response->poolBody->reset();
+    response->poolBody->putCString(error.what());
+    processResponse(stream);
+}
+
+bool Http2Session::writeStream(Http2Stream* stream, const char* data, uint64_t size)
+{
+    if (!stream->producer || stream->streamFinished)
+        return false;
+
+    stream->producePending = false;
+    if (size)
+        stream->poolStream->putData(data, size);
+
+    if (stream->streamWaiting) {
+        // asynchronous write: nothing of this stream is being sent at the moment.
+        // producer is not called back from its own write
+        stream->streamWaiting = false;
+        stream->producePending = true;
+        queueStream(stream);
+        if (!send())
+            return false; // connection is closed and producer is aborted
+        stream->producePending = false;
+    }
+
+    return (stream->poolStream->getSize() + stream->getPendingData()) < handler->streamWindow;
+}
+
+void Http2Session::finishStream(Http2Stream* stream)
+{
+    if (!stream->producer || stream->streamFinished)
+        return;
+
+    stream->producePending = false;
+    stream->streamFinished = true;
+
+    if (stream->streamWaiting) {
+        stream->streamWaiting = false;
+        queueStream(stream);
+        send();
+    }
+}
+
+void Http2Session::writeFrameHeader(uint32_t length, uint8_t type, uint8_t flags, uint32_t streamId)
+{
+    uint8_t* header = reinterpret_cast<uint8_t*>(poolOut->grow(HTTP2_FRAME_HEADER_SIZE));
+    header[0] = static_cast<uint8_t>(length >> 16);
+    header[1] = static_cast<uint8_t>(length >> 8);
+    header[2] = static_cast<uint8_t>(length);
+    header[3] = type;
+    header[4] = flags;
+    writeUint32(header + 5, streamId);
+}
+
+void Http2Session::writeSettings()
+{
+    const uint16_t settings[][2] = {
+        {SETTINGS_MAX_CONCURRENT_STREAMS, HTTP2_MAX_CONCURRENT_STREAMS},
+        {SETTINGS_INITIAL_WINDOW_SIZE, 0}
+    };
+
+    writeFrameHeader(12, FRAME_SETTINGS, 0, 0);
+    uint8_t* payload = reinterpret_cast<uint8_t*>(poolOut->grow(12));
+    for (int i = 0; i < 2; ++i, payload += 6) {
+        const uint32_t value = (settings[i][0] == SETTINGS_INITIAL_WINDOW_SIZE)
+                ? HTTP2_RECV_WINDOW_SIZE : settings[i][1];
+        payload[0] = static_cast<uint8_t>(settings[i][0] >> 8);
+        payload[1] = static_cast<uint8_t>(settings[i][0]);
+        writeUint32(payload + 2, value);
+    }
+
+    // connection window can only be changed with WINDOW_UPDATE
+    writeWindowUpdate(0, HTTP2_RECV_WINDOW_SIZE - HTTP2_DEFAULT_WINDOW_SIZE);
+    recvWindow = HTTP2_RECV_WINDOW_SIZE;
+}
+
+void Http2Session::writeWindowUpdate(uint32_t streamId, uint32_t increment)
+{
+    writeFrameHeader(4, FRAME_WINDOW_UPDATE, 0, streamId);
+    writeUint32(reinterpret_cast<uint8_t*>(poolOut->grow(4)), increment);
+}
+
+void Http2Session::writeHeaders(uint32_t streamId, bool endStream)
+{
+    // header block larger than frame size is continued in CONTINUATION frames
+    const MemPool::Chunk* block = poolHeaders->flatten(false);
+    const char* data = block->buffer;
+    uint64_t size = block->size;
+    uint8_t type = FRAME_HEADERS;
+    uint8_t flags = endStream ? FLAG_END_STREAM : 0;
+
+    for (;;) {
+        const uint32_t length = static_cast<uint32_t>(size < maxFrameSize ? size : maxFrameSize);
+        size -= length;
+        writeFrameHeader(length, type, size ? flags : (flags | FLAG_END_HEADERS), streamId);
+        poolOut->putData(data, length);
+        data += length;
+        if (!size)
+            break;
+        type = FRAME_CONTINUATION;
+        flags = 0;
+    }
+
+    poolHeaders->reset();
+}
+
+void Http2Session::writeDataFrame(Http2Stream* stream, uint64_t size, bool endStream)
+{
+    writeFrameHeader(static_cast<uint32_t>(size), FRAME_DATA, endStream ? FLAG_END_STREAM : 0, stream->id);
+    if (!size)
+        return;
+
+    char* out = poolOut->grow(size);
+    const MemPool::Chunk* chunk = stream->poolWrite->getChunks() + stream->chunkIndex;
+    while (size) {
+        const uint64_t left = chunk->size - stream->chunkPos;
+        if (!left) {
+            ++chunk;
+            ++stream->chunkIndex;
+            stream->chunkPos = 0;
+            continue;
+        }
+
+        const uint64_t part = (size < left) ? size : left;
+        memcpy(out, chunk->buffer + stream->chunkPos, part);
+        out += part;
+        size -= part;
+        stream->chunkPos += part;
+    }
+}
+
+bool Http2Session::writeData(Http2Stream* stream)
+{
+    uint64_t pending = stream->getPendingData();
+    if (!pending && stream->producer && nextStreamPart(stream))
+        pending = stream->getPendingData();
+
+    const bool finished = !stream->producer || stream->streamFinished;
+    if (!pending) {
+        // waiting for producer to write the next part
+        if (!finished)
+            return true;
+
+        writeDataFrame(stream, 0, true);
+    } else {
+        if (sendWindow <= 0) {
+            // blocked by connection window until WINDOW_UPDATE
+            stream->queued = true;
+            writable.push_front(stream->id);
+            return false;
+        }
+
+        // blocked by stream window, stream is queued again on WINDOW_UPDATE
+        if (stream->sendWindow <= 0)
+            return true;
+
+        uint64_t size = pending;
+        if (size > static_cast<uint64_t>(sendWindow))
+            size = static_cast<uint64_t>(sendWindow);
+        if (size > static_cast<uint64_t>(stream->sendWindow))
+            size = static_cast<uint64_t>(stream->sendWindow);
+        if (size > maxFrameSize)
+            size = maxFrameSize;
+
+        const bool endStream = size == pending && finished
+                && (!stream->poolStream || stream->poolStream->isClean());
+        writeDataFrame(stream, size, endStream);
+        sendWindow -= size;
+        stream->sendWindow -= size;
+
+        if (!endStream) {
+            queueStream(stream);
+            return true;
+        }
+    }
+
+    // response is sent
+    LogDebug() << "Request " << stream->requestId << " handled in "
+               << stream->timer.elapsed() << " microsecond(s)";
+    deleteStream(stream);
+    return true;
+}
+
+bool Http2Session::nextStreamPart(Http2Stream* stream)
+{
+    // the previous part is sent
+    stream->poolWrite->reset();
+    stream->chunkIndex = 0;
+    stream->chunkPos = 0;
+
+    for (;;) {
+        if (!stream->poolStream->isClean()) {
+            std::swap(stream->poolWrite, stream->poolStream);
+            stream->response.poolBody = stream->poolWrite;
+
+            // let producer fill the window while this part is being sent
+            if (!stream->streamFinished && !stream->producePending) {
+                stream->producePending = true;
+                stream->producer->produce(stream->stream);
+            }
+            return true;
+        }
+
+        if (stream->streamFinished)
+            return false;
+
+        if (stream->producePending) {
+            // producer will write the next part asynchronously
+            stream->streamWaiting = true;
+            return false;
+        }
+
+        stream->producePending = true;
+        stream->producer->produce(stream->stream);
+    }
+}
+
+void Http2Session::fillData()
+{
+    // after upgrade the data is held until client preface is received,
+    // some clients can't buffer much of data following 101 response
+    if (!prefaceReceived)
+        return;
+
+    // streams share connection window in round robin order, by one frame at once
+    while (!writable.empty() && getOutputSize() < HTTP2_OUTPUT_LIMIT) {
+        const uint32_t streamId = writable.front();
+        writable.pop_front();
+
+        Http2Stream* stream = findStream(streamId);
+        if (!stream)
+            continue; // stream is reset
+
+        stream->queued = false;
+        if (!writeData(stream))
+            break;
+    }
+}
+
+uint64_t Http2Session::getOutputSize() const
+{
+    return poolOut->getSize() - outWritten;
+}
+
+Status Http2Session::writeOutput()
+{
+#ifndef WIN32
+    iovec iov[HTTP2_MAX_WRITE_IOV];
+#endif
+
+    for (;;) {
+        const MemPool::Chunk* chunks = poolOut->getChunks();
+        const MemPool::Chunk* last = poolOut->getLastChunk();
+        if (!last)
+            return Status::Success;
+
+#ifndef WIN32
+        // gather chunks to send them with one syscall
+        int iovCount = 0;
+        for (const MemPool::Chunk* chunk = chunks + outChunk; chunk <= last && iovCount < HTTP2_MAX_WRITE_IOV; ++chunk) {
+            const uint64_t pos = (chunk == chunks + outChunk) ? outPos : 0;
+            if (chunk->size == pos)
+                continue;
+            iov[iovCount].iov_base = chunk->buffer + pos;
+            iov[iovCount].iov_len = chunk->size - pos;
+            ++iovCount;
+        }
+
+        if (!iovCount)
+            return Status::Success;
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovCount;
+
+        ssize_t sent = ::sendmsg(fd, &msg, 0);
+#else
+        const MemPool::Chunk* chunk = chunks + outChunk;
+        while (chunk < last && chunk->size == outPos) {
+            ++chunk;
+            ++outChunk;
+            outPos = 0;
+        }
+
+        if (chunk->size == outPos)
+            return Status::Success;
+
+        ssize_t sent = ::send(fd, chunk->buffer + outPos, chunk->size - outPos, 0);
+#endif
+        if (sent == -1) {
+            // output buffer is full.
+            if (errno == EAGAIN)
+                return Status::Again;
+
+            if (errno == EINTR)
+                continue;
+
+            // other error
+            if (errno != EPIPE && errno != ECONNRESET)
+                LogError() << "Failed to write response: " << Error::getLastError();
+            return Status::Close;
+        }
+
+        outWritten += static_cast<uint64_t>(sent);
+        for (uint64_t remaining = static_cast<uint64_t>(sent); remaining;) {
+            const uint64_t left = chunks[outChunk].size - outPos;
+            if (remaining < left) {
+                outPos += remaining;
+                break;
+            }
+
+            remaining -= left;
+            ++outChunk;
+            outPos = 0;
+        }
+    }
+}
+
+Status Http2Session::flush()
+{
+    // frames are sent by the outer call
+    if (inRead || inFlush)
+        return Status::Success;
+
+    inFlush = true;
+    Status res = Status::Success;
+    for (;;) {
+        fillData();
+        if (getOutputSize()) {
+            res = writeOutput();
+            if (res != Status::Success)
+                break;
+        }
+
+        // everything is sent
+        poolOut->reset();
+        outChunk = 0;
+        outPos = 0;
+        outWritten = 0;
+
+        // no more data or blocked by flow control
+        if (writable.empty() || sendWindow <= 0 || !prefaceReceived)
+            break;
+    }
+    inFlush = false;
+
+    return res;
+}
+
+bool Http2Session::send()
+{
+    if (flush() != Status::Close)
+        return true;
+
+    LogDebug() << "Closing connection to client";
+    NGREST_ASSERT_NULL(handler->closeCallback);
+    handler->closeCallback->closeConnection(fd);
+    return false;
+}
+
+void Http2Session::updateTimeout()
+{
+    // idle timeout is counted while there are no active streams
+    if (streams.empty() && handler->idleTimeout) {
+        handler->timingWheel->arm(timer, getMonotonicTime(), handler->idleTimeout);
+    } else {
+        handler->timingWheel->disarm(timer);
+    }
+}
+
+}
@@ -0,0 +1,214 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_HTTP2SESSION_H
+#define NGREST_HTTP2SESSION_H
+
+#include <deque>
+#include <unordered_map>
+
+#include "ClientCallback.h"
+#include "Hpack.h"
+#include "SocketAddress.h"
+
+namespace ngrest {
+
+class Exception;
+class MemPool;
+class ClientHandler;
+struct HttpRequest;
+struct Timer;
+struct Http2Stream;
+
+/**
+ * @brief HTTP/2 connection over cleartext TCP (h2c) as described in RFC 7540.
+ * Every stream is processed as a separate message, so requests of one connection are dispatched concurrently.
+ * Created by ClientHandler when client sends connection preface or upgrades HTTP/1.1 connection
+ */
+class Http2Session
+{
+public:
+    /**
+     * @brief constructor
+     * @param handler client handler which owns the connection
+     * @param fd client socket descriptor
+     * @param address client address
+     * @param timer timer to track idle timeout of connection
+     */
+    Http2Session(ClientHandler* handler, Socket fd, const SocketAddress& address, Timer* timer);
+
+    /**
+     * @brief destructor
+     */
+    ~Http2Session();
+
+    /**
+     * @brief check whether the data received is the beginning of HTTP/2 connection preface
+     * @param data data received from client
+     * @param size size of data
+     * @return true if data matches connection preface
+     */
+    static bool isPreface(const char* data, uint64_t size);
+
+    /**
+     * @brief start session with the data received from client with prior knowledge
+     * @param data data received from client starting with connection preface
+     * @param size size of data
+     * @return true - success, false - close connection
+     */
+    bool start(const char* data, uint64_t size);
+
+    /**
+     * @brief upgrade HTTP/1.1 connection, the request is processed as stream 1
+     * @param request HTTP/1.1 request with "Upgrade: h2c" header
+     * @param settings value of HTTP2-Settings header
+     * @param data data received after the request
+     * @param size size of data
+     * @return true - success, false - close connection
+     */
+    bool upgrade(const HttpRequest* request, const char* settings, const char* data, uint64_t size);
+
+    /**
+     * @brief data available from client
+     * @return true - read success, false - close connection
+     */
+    bool readyRead();
+
+    /**
+     * @brief client socket is ready for writing
+     * @return write status code
+     */
+    Status readyWrite();
+
+    /**
+     * @brief connection is closed: abort all streams which are not being processed
+     * @return true - session can be deleted now, false - session will delete itself
+     *   when processing of the remaining streams is finished
+     */
+    bool close();
+
+    /**
+     * @brief build response of stream and send it to client
+     * @param stream processed stream
+     */
+    void processResponse(Http2Stream* stream);
+
+    /**
+     * @brief build error response of stream and send it to client
+     * @param stream processed stream
+     * @param error error description
+     */
+    void processError(Http2Stream* stream, const Exception& error);
+
+    /**
+     * @brief write the next part of streamed response body
+     * @param stream stream to write to
+     * @param data data to write
+     * @param size size of data
+     * @return true - more data can be written, false - send window is full or stream is closed
+     */
+    bool writeStream(Http2Stream* stream, const char* data, uint64_t size);
+
+    /**
+     * @brief finish streamed response body
+     * @param stream stream to finish
+     */
+    void finishStream(Http2Stream* stream);
+
+private:
+    Http2Session(const Http2Session&);
+    Http2Session& operator=(const Http2Session&);
+
+    bool readFrames();
+    bool processInput();
+    bool processFrame(uint8_t type, uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length);
+    bool processData(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length);
+    bool processHeaders(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length);
+    bool processContinuation(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length);
+    bool processHeaderBlock();
+    bool processSettings(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length);
+    bool applySettings(const uint8_t* payload, uint32_t length);
+    bool processWindowUpdate(uint32_t streamId, const uint8_t* payload, uint32_t length);
+    bool processReset(uint32_t streamId, uint32_t length);
+    bool connectionError(uint32_t errorCode, const char* message);
+
+    bool parseRequestHeaders(Http2Stream* stream, Header* headers);
+    void finishRequest(Http2Stream* stream);
+    void dispatch(Http2Stream* stream);
+    Http2Stream* findStream(uint32_t streamId);
+    void resetStream(uint32_t streamId, uint32_t errorCode);
+    void cancelStream(Http2Stream* stream);
+    void deleteStream(Http2Stream* stream);
+    void queueStream(Http2Stream* stream);
+
+    void writeFrameHeader(uint32_t length, uint8_t type, uint8_t flags, uint32_t streamId);
+    void writeSettings();
+    void writeWindowUpdate(uint32_t streamId, uint32_t increment);
+    void writeHeaders(uint32_t streamId, bool endStream);
+    void writeDataFrame(Http2Stream* stream, uint64_t size, bool endStream);
+    bool writeData(Http2Stream* stream);
+    bool nextStreamPart(Http2Stream* stream);
+    void fillData();
+    uint64_t getOutputSize() const;
+    Status writeOutput();
+    Status flush();
+    bool send();
+    void updateTimeout();
+
+private:
+    ClientHandler* handler;
+    Socket fd;
+    SocketAddress address;
+    Timer* timer;
+
+    HpackDecoder decoder;
+    std::unordered_map<uint32_t, Http2Stream*> streams;
+    std::deque<uint32_t> writable; // streams having data to send, in round robin order
+    uint32_t lastStreamId = 0;
+    int processingCount = 0; // number of streams being processed by engine
+    bool prefaceReceived = false;
+    bool goingAway = false;
+    bool closed = false;
+    bool inRead = false;
+    bool inFlush = false;
+
+    // header block being received
+    MemPool* headerBlock;
+    uint32_t headerStreamId = 0;
+    uint8_t headerFlags = 0;
+    bool expectContinuation = false;
+
+    // flow control
+    int64_t sendWindow;
+    int64_t recvWindow;
+    int64_t initialWindowSize; // initial send window of stream set by client
+    uint32_t maxFrameSize; // maximum size of frame client can receive
+
+    MemPool* poolRead; // frames received, always in one chunk
+    MemPool* poolOut; // frames to send
+    MemPool* poolHeaders; // header block being encoded
+    int outChunk = 0; // position of the data to send in poolOut
+    uint64_t outPos = 0;
+    uint64_t outWritten = 0;
+};
+
+}
+
+#endif // NGREST_HTTP2SESSION_H
@@ -24,10 +24,10 @@
 #include <sys/types.h>
 #ifdef HAS_EPOLL
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif
 #ifndef WIN32
 #include <sys/socket.h>
-#include <sys/ioctl.h>
 #include <netdb.h>
 #include <netinet/tcp.h>
 #else
@@ -48,6 +48,7 @@
 #define MAXEVENTS 64
 #define NGREST_EVENT_LOOP_CHECK_PERIOD 200
 
+
 #ifndef HAS_EPOLL
 #warning No epoll support - switching to compatibility mode
 #endif
@@ -83,9 +84,10 @@ static SocketInitializer socketInitializer;
 #endif
 
 
-Server::Server()
-#if !defined NGREST_THREAD_LOCK && defined DEBUG
-    : mainThreadId(std::this_thread::get_id())
+Server::Server():
+    isStopping(false)
+#ifdef HAS_EPOLL
+    , wakeupPending(false)
 #endif
 {
 #ifdef HAS_EPOLL
@@ -103,6 +105,8 @@ Server::~Server()
     if (fdServer != 0)
         close(fdServer);
 #ifdef HAS_EPOLL
+    if (fdWakeup != -1)
+        close(fdWakeup);
     free(events);
     free(event);
 #endif
@@ -112,6 +116,7 @@ bool Server::create(const StringMap& args)
 {
     std::string port = "9098";
     std::string ip;
+    bool reusePort = false;
 
     auto it = args.find("p");
     if (it != args.end())
@@ -121,7 +126,11 @@ bool Server::create(const StringMap& args)
     if (it != args.end())
         ip = it->second;
 
-    fdServer = createServerSocket(ip, port);
+    it = args.find("t");
+    if (it != args.end())
+        reusePort = atoi(it->second.c_str()) > 1;
+
+    fdServer = createServerSocket(ip, port, reusePort);
     if (fdServer == NGREST_SOCKET_ERROR)
         return false;
 
@@ -135,6 +144,13 @@ bool Server::create(const StringMap& args)
     }
 
 #ifdef HAS_EPOLL
+    // used to wake up event loop when a task is posted from another thread
+    fdWakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fdWakeup == -1) {
+        perror("eventfd");
+        return false;
+    }
+
     fdEpoll = epoll_create1(0);
     if (fdEpoll == -1) {
         perror("epoll_create");
@@ -148,6 +164,14 @@ bool Server::create(const StringMap& args)
         perror("epoll_ctl");
         return false;
     }
+
+    event->data.fd = fdWakeup;
+    event->events = EPOLLIN;
+    res = epoll_ctl(fdEpoll, EPOLL_CTL_ADD, fdWakeup, event);
+    if (res == -1) {
+        perror("epoll_ctl");
+        return false;
+    }
 #else
     FD_ZERO(&activeFds);
 #endif
@@ -179,8 +203,15 @@ int Server::exec()
         host = ip;
     }
 
-    LogInfo() << "Simple ngrest server started on port " << port << ".";
-    LogInfo() << "Deployed services: http://" << host << ":" << port << "/ngrest/services";
+    // in multithreaded mode every thread runs it's own server, report only once
+    if (Looper::getMainLooper() == this) {
+        LogInfo() << "Simple ngrest server started on port " << port << ".";
+        LogInfo() << "Deployed services: http://" << host << ":" << port << "/ngrest/services";
+    }
+
+    // tasks posted from services of this thread must be executed by this event loop
+    Looper::setCurrentLooper(this);
+    loopThreadId = std::this_thread::get_id();
 
 #ifndef HAS_EPOLL
     fd_set readFds;
@@ -194,39 +225,7 @@ int Server::exec()
     // The event loop
     while (!isStopping) {
 #ifdef HAS_EPOLL
-        int n = epoll_wait(fdEpoll, events, MAXEVENTS, NGREST_EVENT_LOOP_CHECK_PERIOD);
-        for (int i = 0; i < n && !isStopping; ++i) {
-            const uint32_t event = events[i].events;
-            if ((events[i].events & EPOLLERR) ||
-                   (events[i].events & EPOLLHUP) ||
-                   (!(events[i].events & (EPOLLIN | EPOLLOUT)))) {
-                /* An error has occured on this fd, or the socket is not
-                 ready for reading/writing(why were we notified then?) */
-                if (errno != EAGAIN && errno != EPIPE) {
-                    LogError() << "epoll error: " << Error::getLastError() << ". Client# " << events[i].data.fd;
-                    if (callback)
-                        callback->error(events[i].data.fd);
-                }
-                closeConnection(events[i].data.fd);
-            } else if (fdServer == events[i].data.fd) {
-                /* We have a notification on the listening socket, which
-                 means one or more incoming connections. */
-                handleIncomingConnection();
-            } else {
-                /* We have data on the fd waiting to be read. Read and
-                 display it. We must read whatever data is available
-                 completely, as we are running in edge-triggered mode
-                 and won't get a notification again for the same
-                 data. */
-                if (event & EPOLLIN) {
-                    handleRequest(events[i].data.fd);
-                } else if (event & EPOLLOUT) {
-                    callback->readyWrite(events[i].data.fd);
-                } else {
-                    LogError() << "Unknown EPOLL event" << Error::getLastError();
-                }
-            }
-        }
+        processEpollEvents();
 #else
         // Block until input arrives on one or more active sockets.
         timeout.tv_sec = 0;
@@ -291,25 +290,75 @@ int Server::exec()
             }
         }
 #endif
-#ifdef NGREST_THREAD_LOCK
-        if (hasTasks) {
-            std::lock_guard<std::mutex> lock(mutex);
-            hasTasks = false;
-#endif
-            while (!taskQueue.empty()) {
-                task = taskQueue.front();
-                taskQueue.pop();
-                task();
-            }
-#ifdef NGREST_THREAD_LOCK
-        }
-#endif
+        while (taskQueue.pop(task))
+            task();
+
+        callback->checkTimeouts();
     }
 
-    LogInfo() << "Server finished";
+    Looper::setCurrentLooper(nullptr);
+
+    if (Looper::getMainLooper() == this)
+        LogInfo() << "Server finished";
     return EXIT_SUCCESS;
 }
 
+#ifdef HAS_EPOLL
+void Server::processEpollEvents()
+{
+    int n = epoll_wait(fdEpoll, events, MAXEVENTS, NGREST_EVENT_LOOP_CHECK_PERIOD);
+    for (int i = 0; i < n && !isStopping; ++i) {
+        if (fdWakeup == events[i].data.fd) {
+            // task(s) posted from another thread, they will be executed by event loop
+            uint64_t value;
+            while (read(fdWakeup, &value, sizeof(value)) > 0);
+            wakeupPending = false;
+        } else if (fdServer == events[i].data.fd) {
+            /* We have a notification on the listening socket, which
+             means one or more incoming connections. */
+            handleIncomingConnection();
+        } else {
+            handleClientEvents(events[i].data.fd, events[i].events);
+        }
+    }
+}
+
+void Server::handleClientEvents(Socket fd, uint32_t eventFlags)
+{
+    if ((eventFlags & EPOLLERR) && !(eventFlags & EPOLLHUP) && callback->error(fd)) {
+        // socket error queue contained only notifications
+        eventFlags &= ~EPOLLERR;
+        if (!(eventFlags & (EPOLLIN | EPOLLOUT)))
+            return;
+    }
+
+    if ((eventFlags & EPOLLERR) ||
+           (eventFlags & EPOLLHUP) ||
+           (!(eventFlags & (EPOLLIN | EPOLLOUT)))) {
+        /* An error has occured on this fd, or the socket is not
+         ready for reading/writing(why were we notified then?) */
+        if (errno != EAGAIN && errno != EPIPE) {
+            LogError() << "epoll error: " << Error::getLastError() << ". Client# " << fd;
+            if (callback)
+                callback->error(fd);
+        }
+        closeConnection(fd);
+    } else {
+        /* We have data on the fd waiting to be read. Read and
+         display it. We must read whatever data is available
+         completely, as we are running in edge-triggered mode
+         and won't get a notification again for the same
+         data. */
+        if ((eventFlags & EPOLLIN) && !handleRequest(fd))
+            return;
+
+        // socket may become writable along with incoming data, that edge won't be reported again
+        if ((eventFlags & EPOLLOUT) && callback->readyWrite(fd) == Status::Close)
+            closeConnection(fd);
+    }
+}
+#endif
+
 void Server::quit()
 {
     isStopping = true;
@@ -328,25 +377,34 @@ void Server::closeConnection(Socket fd)
     FD_CLR(fd, &writeFds);
 #endif
 
-    close(fd);
+    // handler may keep the socket open until kernel completes sending from its memory
+    if (!callback->closing(fd))
+        close(fd);
     callback->disconnected(fd);
 }
 
 void Server::post(Task task)
 {
-#ifdef NGREST_THREAD_LOCK
-    std::lock_guard<std::mutex> lock(mutex);
-    hasTasks = true;
-#else
-    NGREST_DEBUG_ASSERT(std::this_thread::get_id() == mainThreadId,
-                        "You trying to post task from non-main thread, "
-                        "but ngrest is not compiled with WITH_THREAD_LOCK flag."
-                        "This may cause undefined behavior and because of that restricted.");
+    taskQueue.push(std::move(task));
+
+    // event loop will execute the task after processing of current events
+    if (std::this_thread::get_id() != loopThreadId)
+        wakeup();
+}
+
+void Server::wakeup()
+{
+#ifdef HAS_EPOLL
+    // only one write is needed until event loop is woken up
+    if (!wakeupPending.exchange(true)) {
+        uint64_t value = 1;
+        if (write(fdWakeup, &value, sizeof(value)) == -1 && errno != EAGAIN)
+            LogError() << "Failed to wake up event loop: " << Error::getLastError();
+    }
 #endif
-    taskQueue.push(task);
 }
 
-Socket Server::createServerSocket(const std::string& ip, const std::string& port)
+Socket Server::createServerSocket(const std::string& ip, const std::string& port, bool reusePort)
 {
     struct addrinfo hints;
     struct addrinfo* addr;
@@ -372,6 +430,22 @@ Socket Server::createServerSocket(const std::string& ip, const std::string& port
 
         int reuse = 1;
         setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char*>(&reuse), sizeof(reuse));
+        if (reusePort) {
+#ifdef SO_REUSEPORT
+            // let the kernel balance incoming connections between the servers listening the same port
+            if (setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<char*>(&reuse), sizeof(reuse)) == -1) {
+                lastError = Error::getLastError();
+                close(sock);
+                sock = NGREST_SOCKET_ERROR;
+                continue;
+            }
+#else
+            LogError() << "Multiple threads are not supported: no SO_REUSEPORT option available";
+            close(sock);
+            freeaddrinfo(addr);
+            return -1;
+#endif
+        }
 
         res = bind(sock, curr->ai_addr, curr->ai_addrlen);
         if (res == 0) {
@@ -474,26 +548,16 @@ bool Server::handleIncomingConnection()
     return true;
 }
 
-void Server::handleRequest(Socket fd)
+bool Server::handleRequest(Socket fd)
 {
-#ifndef WIN32
-    int64_t bytesAvail = 0;
-    int res = ioctl(fd, FIONREAD, &bytesAvail);
-#else
-    u_long bytesAvail = 0;
-    int res = ioctlsocket(fd, FIONREAD, &bytesAvail);
-#endif
-
-    // if res = 0, the query is ok, trust bytesAvail
-    // else if there are some bytes to read or the query is failed - we will try to read
-    if (res || bytesAvail) {
-        try {
-            if (callback->readyRead(fd))
-                return;
-        } NGREST_CATCH_ALL
-    }
+    // no need to check the number of bytes available: readyRead reads until EAGAIN and detects EOF
+    try {
+        if (callback->readyRead(fd))
+            return true;
+    } NGREST_CATCH_ALL
 
     closeConnection(fd);
+    return false;
 }
 
 }
@@ -29,16 +29,12 @@
 #endif
 #endif
 
-#include <queue>
-#ifdef NGREST_THREAD_LOCK
-#include <mutex>
 #include <atomic>
-#elif defined DEBUG
 #include <thread>
-#endif
 #include <ngrest/engine/Looper.h>
 #include "servercommon.h"
 #include "ClientHandler.h"
+#include "TaskQueue.h"
 
 #ifdef HAS_EPOLL
 struct epoll_event;
@@ -64,7 +60,9 @@ public:
 
     /**
      * @brief create server with arguments
-     * @param args arguments to pass to server
+     * @param args arguments to pass to server.
+     *   if number of threads ("t") is greater than 1, listening socket is created with SO_REUSEPORT
+     *   option to allow several servers to share the same port
      * @return true - server successfully created
      */
     bool create(const StringMap& args);
@@ -82,7 +80,7 @@ public:
     int exec();
 
     /**
-     * @brief stops the server
+     * @brief stops the server. Can be called from any thread
      */
     void quit();
 
@@ -93,20 +91,25 @@ public:
     virtual void closeConnection(Socket fd) override;
 
     /**
-     * @brief post task to event loop (main thread).
-     * This function is thread-safe if ngrest is compiled with WITH_THREAD_LOCK
+     * @brief post task to event loop.
+     * This function is thread-safe and wakes up the event loop immediately
      * @param task
      */
     virtual void post(Task task) override;
 
 private:
-    Socket createServerSocket(const std::string& ip, const std::string& port);
+    Socket createServerSocket(const std::string& ip, const std::string& port, bool reusePort);
     bool setupNonblock(Socket fd);
     bool handleIncomingConnection();
-    void handleRequest(Socket fd);
+    void wakeup();
+    bool handleRequest(Socket fd);
+#ifdef HAS_EPOLL
+    void processEpollEvents();
+    void handleClientEvents(Socket fd, uint32_t eventFlags);
+#endif
 
 private:
-    bool isStopping = false;
+    std::atomic<bool> isStopping;
     Socket fdServer = 0;
 #ifdef HAS_EPOLL
     int fdEpoll = 0;
@@ -119,13 +122,12 @@ private:
     ClientCallback* callback = nullptr;
     std::string ip;
     std::string port;
-#ifdef NGREST_THREAD_LOCK
-    std::atomic<bool> hasTasks;
-    std::mutex mutex;
-#elif defined DEBUG
-    std::thread::id mainThreadId;
+    std::thread::id loopThreadId;
+#ifdef HAS_EPOLL
+    int fdWakeup = -1;
+    std::atomic<bool> wakeupPending;
 #endif
-    std::queue<Task> taskQueue;
+    TaskQueue taskQueue;
 };
 
 }
@@ -0,0 +1,67 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <string.h>
+
+#include <ngrest/utils/Log.h>
+
+#include "SocketAddress.h"
+
+namespace ngrest {
+
+void SocketAddress::set(const sockaddr_storage* addr)
+{
+    memcpy(&this->addr, addr, sizeof(this->addr));
+    formatted = false;
+}
+
+void SocketAddress::set(const SocketAddress& other)
+{
+    set(&other.addr);
+}
+
+const char* SocketAddress::getHost()
+{
+    if (!formatted)
+        format();
+    return host;
+}
+
+const char* SocketAddress::getPort()
+{
+    if (!formatted)
+        format();
+    return port;
+}
+
+void SocketAddress::format()
+{
+    formatted = true;
+    int res = getnameinfo(reinterpret_cast<const sockaddr*>(&addr), sizeof(addr),
+                          host, sizeof(host), port, sizeof(port),
+                          NI_NUMERICHOST | NI_NUMERICSERV);
+    if (res != 0) {
+        LogWarning() << "Failed to get client info: " << gai_strerror(res);
+        host[0] = '\0';
+        port[0] = '\0';
+    }
+}
+
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_SOCKETADDRESS_H
+#define NGREST_SOCKETADDRESS_H
+
+#ifndef WIN32
+#include <sys/socket.h>
+#include <netdb.h>
+#else
+#include <Ws2tcpip.h>
+#undef DELETE // conflicts with HttpMethod::DELETE
+#endif
+
+#include <ngrest/common/HttpMessage.h>
+
+namespace ngrest {
+
+/**
+ * @brief address of connected client. Host and port are formatted on the first request
+ */
+class SocketAddress: public ClientAddress
+{
+public:
+    /**
+     * @brief set address of client
+     * @param addr address as returned by accept
+     */
+    void set(const sockaddr_storage* addr);
+
+    /**
+     * @brief copy address of another client without formatted host and port
+     * @param other address to copy
+     */
+    void set(const SocketAddress& other);
+
+    virtual const char* getHost() override;
+    virtual const char* getPort() override;
+
+private:
+    void format();
+
+private:
+    sockaddr_storage addr;
+    bool formatted = false;
+    char host[NI_MAXHOST];
+    char port[NI_MAXSERV];
+};
+
+}
+
+#endif // NGREST_SOCKETADDRESS_H
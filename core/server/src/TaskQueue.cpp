@@ -0,0 +1,110 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <stdint.h>
+
+#include <ngrest/utils/Exception.h>
+
+#include "TaskQueue.h"
+
+namespace ngrest {
+
+TaskQueue::TaskQueue(size_t capacity):
+    cells(capacity), mask(capacity - 1), enqueuePos(0), hasOverflow(false)
+{
+    NGREST_ASSERT(capacity >= 2 && (capacity & (capacity - 1)) == 0, "Capacity must be power of two");
+    for (size_t i = 0; i < capacity; ++i)
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+void TaskQueue::push(Task&& task)
+{
+    // once overflow is used, keep on using it until consumer drains it to preserve order of tasks
+    if (!hasOverflow.load(std::memory_order_acquire) && tryPush(task))
+        return;
+
+    std::lock_guard<std::mutex> lock(overflowMutex);
+    overflow.push_back(std::move(task));
+    hasOverflow.store(true, std::memory_order_release);
+}
+
+bool TaskQueue::pop(Task& task)
+{
+    // tasks taken from overflow are older than any task in the ring buffer
+    if (overflowPos < overflowTasks.size()) {
+        task = std::move(overflowTasks[overflowPos]);
+        overflowTasks[overflowPos++] = nullptr;
+        return true;
+    }
+
+    Cell* cell = &cells[dequeuePos & mask];
+    size_t sequence = cell->sequence.load(std::memory_order_acquire);
+    if (sequence == dequeuePos + 1) {
+        task = std::move(cell->task);
+        cell->task = nullptr;
+        cell->sequence.store(dequeuePos + mask + 1, std::memory_order_release);
+        ++dequeuePos;
+        return true;
+    }
+
+    if (!hasOverflow.load(std::memory_order_acquire))
+        return false;
+
+    overflowTasks.clear();
+    overflowPos = 0;
+    {
+        std::lock_guard<std::mutex> lock(overflowMutex);
+        overflowTasks.swap(overflow);
+        hasOverflow.store(false, std::memory_order_release);
+    }
+
+    if (overflowTasks.empty())
+        return false;
+
+    task = std::move(overflowTasks[overflowPos]);
+    overflowTasks[overflowPos++] = nullptr;
+    return true;
+}
+
+bool TaskQueue::tryPush(Task& task)
+{
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    for (;;) {
+        Cell* cell = &cells[pos & mask];
+        size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            // cell is free, try to occupy it
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                cell->task = std::move(task);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            // ring buffer is full
+            return false;
+        } else {
+            // another producer has occupied the cell
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+}
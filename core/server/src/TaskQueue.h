@@ -0,0 +1,87 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_TASKQUEUE_H
+#define NGREST_TASKQUEUE_H
+
+#include <stddef.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <ngrest/engine/Looper.h>
+
+namespace ngrest {
+
+/**
+ * @brief lock-free multiple producers/single consumer queue of tasks.
+ * Tasks are stored in-place in preallocated ring buffer cells, so posting small tasks
+ * don't cause memory allocations. When ring buffer is full, tasks are stored into
+ * mutex-protected overflow queue.
+ */
+class TaskQueue
+{
+public:
+    /**
+     * @brief constructor
+     * @param capacity capacity of ring buffer, must be power of two
+     */
+    TaskQueue(size_t capacity = 4096);
+
+    /**
+     * @brief push task into queue. Can be called from any thread
+     * @param task task to push
+     */
+    void push(Task&& task);
+
+    /**
+     * @brief pop task from queue. Must be called from consumer thread only
+     * @param task popped task
+     * @return true if task was popped, false if queue is empty
+     */
+    bool pop(Task& task);
+
+private:
+    TaskQueue(const TaskQueue&);
+    TaskQueue& operator=(const TaskQueue&);
+
+    bool tryPush(Task& task);
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Task task;
+    };
+
+    std::vector<Cell> cells;
+    const size_t mask;
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos = 0;
+
+    std::atomic<bool> hasOverflow;
+    std::mutex overflowMutex;
+    std::vector<Task> overflow;
+    std::vector<Task> overflowTasks;
+    size_t overflowPos = 0;
+};
+
+}
+
+#endif // NGREST_TASKQUEUE_H
@@ -0,0 +1,130 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include "TimingWheel.h"
+
+namespace ngrest {
+
+inline void unlink(Timer* timer)
+{
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = nullptr;
+    timer->next = nullptr;
+}
+
+TimingWheel::TimingWheel(uint64_t now, uint64_t tickMs_):
+    tickMs(tickMs_ ? tickMs_ : 1), startTime(now)
+{
+    for (int level = 0; level < LEVELS; ++level) {
+        for (int slot = 0; slot < LEVEL_SLOTS; ++slot) {
+            Timer* head = &slots[level][slot];
+            head->prev = head;
+            head->next = head;
+        }
+    }
+}
+
+void TimingWheel::arm(Timer* timer, uint64_t now, uint64_t timeoutMs)
+{
+    if (timer->isArmed())
+        unlink(timer);
+
+    // count from the given time, not from the last advanced tick which may be stale,
+    // and round up: tick N is fired no earlier than startTime + N * tickMs
+    const uint64_t expiresMs = (now > startTime ? now - startTime : 0) + timeoutMs;
+    const uint64_t expires = (expiresMs + tickMs - 1) / tickMs;
+    timer->expires = (expires > currentTick) ? expires : (currentTick + 1);
+    insert(timer);
+}
+
+void TimingWheel::disarm(Timer* timer)
+{
+    if (timer->isArmed())
+        unlink(timer);
+}
+
+void TimingWheel::advance(uint64_t now, const ExpireCallback& callback)
+{
+    if (now < startTime)
+        return;
+
+    const uint64_t targetTick = (now - startTime) / tickMs;
+    while (currentTick < targetTick) {
+        ++currentTick;
+
+        // move timers from upper levels when lower level completes a turn
+        for (int level = 1; level < LEVELS; ++level) {
+            if (currentTick & ((1ull << (LEVEL_BITS * level)) - 1))
+                break;
+            cascade(level);
+        }
+
+        Timer* head = &slots[0][currentTick & (LEVEL_SLOTS - 1)];
+        while (head->next != head) {
+            Timer* timer = head->next;
+            unlink(timer);
+            callback(timer);
+        }
+    }
+}
+
+void TimingWheel::insert(Timer* timer)
+{
+    uint64_t delta = (timer->expires > currentTick) ? (timer->expires - currentTick) : 0;
+    int level = 0;
+    while (level < (LEVELS - 1) && delta >= (1ull << (LEVEL_BITS * (level + 1))))
+        ++level;
+
+    uint64_t expires = timer->expires;
+    if (level == (LEVELS - 1) && delta >= (1ull << (LEVEL_BITS * LEVELS))) {
+        // too far, put into the farthest slot
+        expires = currentTick + (1ull << (LEVEL_BITS * LEVELS)) - 1;
+    }
+
+    Timer* head = &slots[level][(expires >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1)];
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+}
+
+void TimingWheel::cascade(int level)
+{
+    Timer* head = &slots[level][(currentTick >> (LEVEL_BITS * level)) & (LEVEL_SLOTS - 1)];
+    if (head->next == head)
+        return;
+
+    // detach the list to avoid reinserting timers into the same slot
+    Timer* timer = head->next;
+    head->prev->next = nullptr;
+    head->prev = head;
+    head->next = head;
+
+    while (timer) {
+        Timer* next = timer->next;
+        timer->prev = nullptr;
+        timer->next = nullptr;
+        insert(timer);
+        timer = next;
+    }
+}
+
+}
@@ -0,0 +1,122 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_TIMINGWHEEL_H
+#define NGREST_TIMINGWHEEL_H
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+
+namespace ngrest {
+
+/**
+ * @brief get time for timing wheel
+ * @return monotonic time in milliseconds
+ */
+inline uint64_t getMonotonicTime()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief timer to be armed in timing wheel. Usually a member of object to track timeout for
+ */
+struct Timer
+{
+    Timer* prev = nullptr;   //!< previous timer in the slot
+    Timer* next = nullptr;   //!< next timer in the slot
+    uint64_t expires = 0;    //!< tick when timer expires
+    void* data = nullptr;    //!< user data
+
+    /**
+     * @brief check whether timer is armed
+     * @return true if timer is armed
+     */
+    bool isArmed() const
+    {
+        return prev != nullptr;
+    }
+};
+
+/**
+ * @brief hierarchical timing wheel.
+ * Arming and disarming of timer are O(1), timers are moved to the lower level
+ * when the lower level wheel completes a turn
+ */
+class TimingWheel
+{
+public:
+    /**
+     * @brief callback which is called for every expired timer
+     */
+    typedef std::function<void(Timer*)> ExpireCallback;
+
+    /**
+     * @brief constructor
+     * @param now current time in milliseconds
+     * @param tickMs resolution of timers in milliseconds
+     */
+    TimingWheel(uint64_t now, uint64_t tickMs = 100);
+
+    /**
+     * @brief arm the timer. If timer is already armed, it's re-armed
+     * @param timer timer to arm
+     * @param now current time in milliseconds
+     * @param timeoutMs timeout in milliseconds relative to the current time
+     */
+    void arm(Timer* timer, uint64_t now, uint64_t timeoutMs);
+
+    /**
+     * @brief disarm the timer. Does nothing if timer is not armed
+     * @param timer timer to disarm
+     */
+    void disarm(Timer* timer);
+
+    /**
+     * @brief advance the wheel to the current time and call callback for every expired timer.
+     * Expired timers are disarmed before callback is called, so callback may re-arm or free them
+     * @param now current time in milliseconds
+     * @param callback callback to call
+     */
+    void advance(uint64_t now, const ExpireCallback& callback);
+
+private:
+    TimingWheel(const TimingWheel&);
+    TimingWheel& operator=(const TimingWheel&);
+
+    void insert(Timer* timer);
+    void cascade(int level);
+
+private:
+    static const int LEVEL_BITS = 6;
+    static const int LEVEL_SLOTS = 1 << LEVEL_BITS;
+    static const int LEVELS = 4; // 64^4 ticks
+
+    uint64_t tickMs;
+    uint64_t startTime;
+    uint64_t currentTick = 0;
+    Timer slots[LEVELS][LEVEL_SLOTS]; // list heads
+};
+
+}
+
+#endif // NGREST_TIMINGWHEEL_H
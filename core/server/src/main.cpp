@@ -19,12 +19,17 @@
  */
 
 #include <signal.h>
+#include <stdlib.h>
 #include <iostream>
+#include <algorithm>
+#include <vector>
+#include <thread>
 
 #include <ngrest/utils/Log.h>
 #include <ngrest/utils/ElapsedTimer.h>
 #include <ngrest/utils/Runtime.h>
 #include <ngrest/utils/File.h>
+#include <ngrest/utils/MemPooler.h>
 #include <ngrest/engine/Engine.h>
 #include <ngrest/engine/ServiceDispatcher.h>
 #include <ngrest/engine/FilterDispatcher.h>
@@ -32,6 +37,7 @@
 #include <ngrest/engine/Deployment.h>
 #include <ngrest/engine/HttpTransport.h>
 #include <ngrest/engine/Looper.h>
+#include <ngrest/engine/ThreadPool.h>
 
 #include "servercommon.h"
 #include "Server.h"
@@ -46,6 +52,16 @@ int help() {
               << "  -s        set extra path to locate services" << std::endl
               << "  -p        port number to use (default: 9098)" << std::endl
               << "  -l        listen to specific ip (default: all)" << std::endl
+              << "  -t        number of event loop threads (default: 1, 0 - number of CPU cores)" << std::endl
+              << "  -k        keep-alive connection idle timeout in seconds (default: 60, 0 - disabled)" << std::endl
+              << "  -r        request header read timeout in seconds (default: 30, 0 - disabled)" << std::endl
+              << "  -b        request body read timeout in seconds (default: 60, 0 - disabled)" << std::endl
+              << "  -z        minimum response size to send with MSG_ZEROCOPY (default: 0 - disabled)" << std::endl
+              << "  -o        maximum size of streamed response data buffered per client (default: 65536)" << std::endl
+              << "  -q        number of pipelined requests processed concurrently per connection (default: 16)" << std::endl
+              << "  -2        accept HTTP/2 over cleartext connections (default: 1, 0 - disabled)" << std::endl
+              << "  -w        number of worker threads for blocking operations (default: 2 x CPU cores)" << std::endl
+              << "  -m        memory budget for unused pooled memory in megabytes (default: 256)" << std::endl
               << "  -h        display this help" << std::endl << std::endl;
     return 1;
 }
@@ -64,25 +80,91 @@ int main(int argc, char* argv[])
         args[argv[i] + 1] = argv[i + 1];
     }
 
-    static ngrest::Server server;
+    int threads = 1;
+    auto itThreads = args.find("t");
+    if (itThreads != args.end()) {
+        threads = atoi(itThreads->second.c_str());
+        if (threads <= 0)
+            threads = std::max(std::thread::hardware_concurrency(), 1u);
+        args["t"] = std::to_string(threads);
+    }
+
+    uint64_t idleTimeout = 60;
+    uint64_t headerTimeout = 30;
+    uint64_t bodyTimeout = 60;
+    auto itTimeout = args.find("k");
+    if (itTimeout != args.end())
+        idleTimeout = strtoull(itTimeout->second.c_str(), nullptr, 10);
+    itTimeout = args.find("r");
+    if (itTimeout != args.end())
+        headerTimeout = strtoull(itTimeout->second.c_str(), nullptr, 10);
+    itTimeout = args.find("b");
+    if (itTimeout != args.end())
+        bodyTimeout = strtoull(itTimeout->second.c_str(), nullptr, 10);
+
+    uint64_t zeroCopyThreshold = 0;
+    auto itZeroCopy = args.find("z");
+    if (itZeroCopy != args.end())
+        zeroCopyThreshold = strtoull(itZeroCopy->second.c_str(), nullptr, 10);
+
+    uint64_t streamWindow = 65536;
+    auto itStreamWindow = args.find("o");
+    if (itStreamWindow != args.end())
+        streamWindow = strtoull(itStreamWindow->second.c_str(), nullptr, 10);
+
+    uint64_t pipelineDepth = 16;
+    auto itPipelineDepth = args.find("q");
+    if (itPipelineDepth != args.end())
+        pipelineDepth = strtoull(itPipelineDepth->second.c_str(), nullptr, 10);
+
+    bool http2Enabled = true;
+    auto itHttp2 = args.find("2");
+    if (itHttp2 != args.end())
+        http2Enabled = itHttp2->second != "0";
+
+    auto itWorkers = args.find("w");
+    if (itWorkers != args.end())
+        ngrest::ThreadPool::inst().setThreadCount(atoi(itWorkers->second.c_str()));
+
+    auto itMemory = args.find("m");
+    if (itMemory != args.end())
+        ngrest::MemPooler::setMaxTotalUnusedSize(strtoull(itMemory->second.c_str(), nullptr, 10) * 1024 * 1024);
+
+    // every thread runs its own server and client handler with its own listening socket,
+    // engine, dispatchers and deployed services are shared between threads
+    static std::vector<ngrest::Server*> servers;
     ngrest::ServiceDispatcher serviceDispatcher;
     ngrest::Deployment deployment(serviceDispatcher);
     ngrest::FilterDispatcher filterDispatcher;
     ngrest::FilterDeployment filterDeployment(filterDispatcher);
     ngrest::HttpTransport transport;
     ngrest::Engine engine(serviceDispatcher);
-    ngrest::ClientHandler clientHandler(engine, transport);
+    std::vector<ngrest::ClientHandler*> clientHandlers;
 
     engine.setFilterDispatcher(&filterDispatcher);
-    server.setClientCallback(&clientHandler);
-    ngrest::Looper::setMainLooper(&server);
 
-    if (!server.create(args))
-        return 1;
+    for (int i = 0; i < threads; ++i) {
+        ngrest::Server* server = new ngrest::Server();
+        ngrest::ClientHandler* clientHandler = new ngrest::ClientHandler(engine, transport);
+        servers.push_back(server);
+        clientHandlers.push_back(clientHandler);
+
+        clientHandler->setTimeouts(idleTimeout * 1000, headerTimeout * 1000, bodyTimeout * 1000);
+        clientHandler->setZeroCopyThreshold(zeroCopyThreshold);
+        clientHandler->setStreamWindow(streamWindow);
+        clientHandler->setPipelineDepth(pipelineDepth);
+        clientHandler->setHttp2Enabled(http2Enabled);
+        server->setClientCallback(clientHandler);
+        if (!server->create(args))
+            return 1;
+    }
+
+    ngrest::Looper::setMainLooper(servers.front());
 
     sighandler_t signalHandler = [] (int) {
         ngrest::LogInfo() << "Stopping server";
-        server.quit();
+        for (ngrest::Server* server : servers)
+            server->quit();
     };
 
     ::signal(SIGINT, signalHandler);
@@ -104,6 +186,26 @@ int main(int argc, char* argv[])
         deployment.deployAll(itPath->second + NGREST_PATH_SEPARATOR);
 
     ngrest::LogInfo() << "Server startup time: " << (timer.elapsed() / 1000.) << "ms";
+    if (threads > 1)
+        ngrest::LogInfo() << "Using " << threads << " event loop threads";
+
+    std::vector<std::thread> serverThreads;
+    for (int i = 1; i < threads; ++i)
+        serverThreads.emplace_back(&ngrest::Server::exec, servers[i]);
+
+    int res = servers.front()->exec();
+
+    for (std::thread& serverThread : serverThreads)
+        serverThread.join();
+
+    // worker threads post completions to event loops, so they must be stopped first
+    ngrest::ThreadPool::inst().stop();
+
+    for (int i = 0; i < threads; ++i) {
+        delete servers[i];
+        delete clientHandlers[i];
+    }
+    servers.clear();
 
-    return server.exec();
+    return res;
 }
@@ -21,13 +21,184 @@
 #include <stdlib.h>
 #include <string.h>
 #include <memory.h>
+#include <utility>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <mutex>
+#endif
 
 #include "MemPool.h"
 
 #define NGREST_MEMPOOL_CHUNK_RESERVE 64
 
+#ifdef __linux__
+// chunks of this size and larger are mapped and grown with mremap without copying data
+#define NGREST_MEMPOOL_MMAP_THRESHOLD (1024 * 1024)
+// max number of mapped chunks cached for reuse
+#define NGREST_MEMPOOL_MMAP_CACHE_COUNT 8
+// max size of mapped chunks cached for reuse
+#define NGREST_MEMPOOL_MMAP_CACHE_SIZE (32 * 1024 * 1024)
+// mapped chunks of this size and larger may use transparent huge pages
+#define NGREST_MEMPOOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#endif
+
 namespace ngrest {
 
+namespace {
+
+#ifdef __linux__
+// bounded cache of mapped chunks, so large bodies don't map and fault in new pages every time
+class MappedChunkCache
+{
+public:
+    static MappedChunkCache& inst()
+    {
+        // never destroyed: memory pools may be freed after static destructors
+        static MappedChunkCache* instance = new MappedChunkCache();
+        return *instance;
+    }
+
+    char* take(uint64_t& size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        int best = -1;
+        for (int i = 0; i < count; ++i)
+            if (regions[i].size >= size && (best == -1 || regions[i].size < regions[best].size))
+                best = i;
+
+        if (best == -1)
+            return nullptr;
+
+        char* buffer = regions[best].buffer;
+        size = regions[best].size;
+        total -= size;
+        regions[best] = regions[--count];
+        return buffer;
+    }
+
+    bool put(char* buffer, uint64_t size)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (count == NGREST_MEMPOOL_MMAP_CACHE_COUNT || (total + size) > NGREST_MEMPOOL_MMAP_CACHE_SIZE)
+            return false;
+
+        regions[count].buffer = buffer;
+        regions[count].size = size;
+        ++count;
+        total += size;
+        return true;
+    }
+
+private:
+    struct Region
+    {
+        char* buffer;
+        uint64_t size;
+    };
+
+    std::mutex mutex;
+    Region regions[NGREST_MEMPOOL_MMAP_CACHE_COUNT];
+    int count = 0;
+    uint64_t total = 0;
+};
+
+inline uint64_t roundToPages(uint64_t size)
+{
+    static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return (size + pageSize - 1) & ~(pageSize - 1);
+}
+
+char* mapBuffer(uint64_t& size)
+{
+    size = roundToPages(size);
+    char* buffer = MappedChunkCache::inst().take(size);
+    if (buffer)
+        return buffer;
+
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED)
+        throw std::bad_alloc();
+
+#ifdef MADV_HUGEPAGE
+    static const bool useHugePages = getenv("NGREST_MEMPOOL_HUGE_PAGES") != nullptr;
+    if (useHugePages && size >= NGREST_MEMPOOL_HUGE_PAGE_SIZE)
+        madvise(mapped, size, MADV_HUGEPAGE);
+#endif
+
+    return reinterpret_cast<char*>(mapped);
+}
+
+void unmapBuffer(char* buffer, uint64_t size)
+{
+    if (!MappedChunkCache::inst().put(buffer, size))
+        munmap(buffer, size);
+}
+#endif
+
+// (re)allocate chunk buffer keeping first keepSize bytes of data. size may be increased to fit the allocation.
+// chunks over threshold are always mapped, so the allocation type is determined by buffer size
+char* reallocBuffer(char* buffer, uint64_t oldSize, uint64_t keepSize, uint64_t& size)
+{
+#ifdef __linux__
+    if (size >= NGREST_MEMPOOL_MMAP_THRESHOLD) {
+        if (oldSize >= NGREST_MEMPOOL_MMAP_THRESHOLD) {
+            const uint64_t newSize = roundToPages(size);
+            void* remapped = mremap(buffer, oldSize, newSize, MREMAP_MAYMOVE);
+            if (remapped == MAP_FAILED)
+                throw std::bad_alloc();
+            size = newSize;
+            return reinterpret_cast<char*>(remapped);
+        }
+
+        char* newBuffer = mapBuffer(size);
+        if (buffer) {
+            memcpy(newBuffer, buffer, keepSize);
+            ::free(buffer);
+        }
+        return newBuffer;
+    }
+
+    if (oldSize >= NGREST_MEMPOOL_MMAP_THRESHOLD) {
+        char* newBuffer = reinterpret_cast<char*>(malloc(size));
+        if (!newBuffer)
+            throw std::bad_alloc();
+        memcpy(newBuffer, buffer, (keepSize < size) ? keepSize : size);
+        unmapBuffer(buffer, oldSize);
+        return newBuffer;
+    }
+#else
+    (void) oldSize;
+#endif
+
+    if (!keepSize && buffer) {
+        // nothing to keep, avoid copying by realloc
+        ::free(buffer);
+        buffer = nullptr;
+    }
+
+    char* newBuffer = reinterpret_cast<char*>(realloc(buffer, size));
+    if (!newBuffer)
+        throw std::bad_alloc();
+    return newBuffer;
+}
+
+void freeBuffer(char* buffer, uint64_t size)
+{
+#ifdef __linux__
+    if (size >= NGREST_MEMPOOL_MMAP_THRESHOLD) {
+        unmapBuffer(buffer, size);
+        return;
+    }
+#else
+    (void) size;
+#endif
+    ::free(buffer);
+}
+
+}
+
 MemPool::MemPool(uint64_t chunkSize_):
     chunkSize(chunkSize_)
 {
@@ -43,17 +214,27 @@ void MemPool::reset()
     if (chunks) {
         currChunk = chunks;
         for (int i = 0; i < chunksCount; ++i) {
-            chunks[i].size = 0;
+            Chunk& chunk = chunks[i];
+            chunk.size = 0;
+            if (chunk.external) {
+                // slot will get own buffer when reused
+                chunk.buffer = nullptr;
+                chunk.bufferSize = 0;
+                chunk.external = false;
+            }
         }
         chunkIndex = 0;
     }
+    owners.clear();
 }
 
 void MemPool::free()
 {
     for (int i = 0; i < chunksCount; ++i)
-        ::free(chunks[i].buffer);
+        if (!chunks[i].external)
+            freeBuffer(chunks[i].buffer, chunks[i].bufferSize);
     ::free(chunks);
+    owners.clear();
     chunksCount = 0;
     chunksReserved = 0;
     chunks = nullptr;
@@ -83,17 +264,84 @@ char* MemPool::putData(const char* data, uint64_t size)
     return reinterpret_cast<char*>(memcpy(grow(size), data, size));
 }
 
+void MemPool::attach(const char* data, uint64_t size, const std::shared_ptr<const void>& owner)
+{
+    if (!size)
+        return;
+
+    owners.push_back(owner);
+
+    // empty current chunk is replaced, else data goes to the next chunk
+    if (!currChunk || currChunk->size)
+        nextChunk();
+
+    if (currChunk->buffer && !currChunk->external) {
+        // keep own buffer of the chunk for reuse by moving it to the end of the list
+        reserveChunks(chunksCount + 1);
+        chunks[chunksCount] = *currChunk;
+        ++chunksCount;
+    }
+
+    currChunk->buffer = const_cast<char*>(data);
+    currChunk->bufferSize = size;
+    currChunk->size = size;
+    currChunk->external = true;
+}
+
+void MemPool::keepAlive(const std::shared_ptr<const void>& owner)
+{
+    owners.push_back(owner);
+}
+
 void MemPool::trim()
 {
     if (chunkIndex + 1 >= chunksCount)
         return;
 
     for (Chunk *curr = currChunk + 1; chunksCount > chunkIndex + 1; ++curr, --chunksCount) {
-        ::free(curr->buffer);
+        if (!curr->external)
+            freeBuffer(curr->buffer, curr->bufferSize);
         memset(curr, 0, sizeof(Chunk));
     }
 }
 
+bool MemPool::shrink(uint64_t maxSize)
+{
+    reset();
+    trim();
+
+    if (!chunksCount || chunks->bufferSize <= maxSize)
+        return false;
+
+    uint64_t size = (chunkSize < maxSize) ? chunkSize : maxSize;
+    try {
+        chunks->buffer = reallocBuffer(chunks->buffer, chunks->bufferSize, 0, size);
+    } catch (const std::bad_alloc&) {
+        return false; // keep the old buffer
+    }
+    chunks->bufferSize = size;
+    return true;
+}
+
+void MemPool::swap(MemPool& other)
+{
+    std::swap(chunks, other.chunks);
+    std::swap(chunksReserved, other.chunksReserved);
+    std::swap(chunksCount, other.chunksCount);
+    std::swap(chunkIndex, other.chunkIndex);
+    std::swap(currChunk, other.currChunk);
+    owners.swap(other.owners);
+}
+
+uint64_t MemPool::getAllocatedSize() const
+{
+    uint64_t result = 0;
+    for (int i = 0; i < chunksCount; ++i)
+        if (!chunks[i].external)
+            result += chunks[i].bufferSize;
+    return result;
+}
+
 MemPool::Chunk* MemPool::flatten(bool terminate)
 {
     if (!chunksCount)
@@ -102,11 +350,10 @@ MemPool::Chunk* MemPool::flatten(bool terminate)
     uint64_t oldFirstChunkSize = chunks->size;
     uint64_t newSize = getSize();
     uint64_t newBufferSize = newSize + (terminate ? 1 : 0);  // +1 - string terminator
-    if (newBufferSize > chunks->bufferSize) {
-        char* newBuffer = reinterpret_cast<char*>(realloc(chunks->buffer, newBufferSize));
-        if (newBuffer == nullptr)
-            throw std::bad_alloc();
-        chunks->buffer = newBuffer;
+    if (chunks->external) {
+        ownChunk(chunks, newBufferSize);
+    } else if (newBufferSize > chunks->bufferSize) {
+        chunks->buffer = reallocBuffer(chunks->buffer, chunks->bufferSize, oldFirstChunkSize, newBufferSize);
         chunks->bufferSize = newBufferSize;
     }
 
@@ -114,11 +361,20 @@ MemPool::Chunk* MemPool::flatten(bool terminate)
 
     for (Chunk* curr = (chunks + 1); curr != (currChunk + 1); pos += curr->size, ++curr) {
         memcpy(pos, curr->buffer, curr->size);
-        ::free(curr->buffer);
+        if (!curr->external)
+            freeBuffer(curr->buffer, curr->bufferSize);
         pos += curr->size;
         curr->buffer = nullptr;
         curr->size = 0;
         curr->bufferSize = 0;
+        curr->external = false;
+    }
+    // free chunks kept for reuse after reset
+    for (Chunk* curr = (currChunk + 1); curr != (chunks + chunksCount); ++curr) {
+        freeBuffer(curr->buffer, curr->bufferSize);
+        curr->buffer = nullptr;
+        curr->size = 0;
+        curr->bufferSize = 0;
     }
     chunksCount = 1;
     currChunk = chunks;
@@ -142,43 +398,84 @@ void MemPool::reserve(uint64_t size)
     if (size < currChunk->bufferSize)
         return;
 
-    char* newBuffer = reinterpret_cast<char*>(realloc(currChunk->buffer, size));
-    if (newBuffer == nullptr)
-        throw std::bad_alloc();
-    currChunk->buffer = newBuffer;
+    if (currChunk->external) {
+        ownChunk(currChunk, size);
+        return;
+    }
+
+    currChunk->buffer = reallocBuffer(currChunk->buffer, currChunk->bufferSize, currChunk->size, size);
     currChunk->bufferSize = size;
 }
 
-
-void MemPool::newChunk(uint64_t size)
+void MemPool::expandLastChunk(uint64_t minSize)
 {
-    if ((chunksCount + 1) > chunksReserved) { // we have ran out of chunks
-        const int newChunksReserved = chunksCount + NGREST_MEMPOOL_CHUNK_RESERVE;
-        Chunk* newChunks = reinterpret_cast<Chunk*>(realloc(chunks, sizeof(Chunk) * static_cast<size_t>(newChunksReserved)));
-        if (!newChunks)
-            throw std::bad_alloc();
+    uint64_t size = currChunk->bufferSize * 2;
+    if (size < minSize)
+        size = minSize;
 
-        memset(newChunks + chunksCount, 0, NGREST_MEMPOOL_CHUNK_RESERVE * sizeof(Chunk));
+    if (currChunk->external) {
+        ownChunk(currChunk, size);
+        return;
+    }
 
-        chunks = newChunks;
-        chunksReserved = newChunksReserved;
-        currChunk = chunks + chunksCount;
-    } else
-        ++currChunk;
+    currChunk->buffer = reallocBuffer(currChunk->buffer, currChunk->bufferSize, currChunk->size, size);
+    currChunk->bufferSize = size;
+}
 
-    ++chunksCount;
-    ++chunkIndex;
+void MemPool::newChunk(uint64_t size)
+{
+    nextChunk();
 
     if (currChunk->bufferSize < size) {
-        char* newBuffer = reinterpret_cast<char*>(realloc(currChunk->buffer, size));
-        if (!newBuffer)
-            throw std::bad_alloc();
-
-        currChunk->buffer = newBuffer;
+        // chunk is empty, nothing to keep
+        currChunk->buffer = reallocBuffer(currChunk->buffer, currChunk->bufferSize, 0, size);
         currChunk->bufferSize = size;
     }
 
     currChunk->size = 0;
 }
 
+void MemPool::nextChunk()
+{
+    if (currChunk && (chunkIndex + 1) < chunksCount) {
+        // reuse the chunk allocated before reset
+        ++currChunk;
+    } else {
+        reserveChunks(chunksCount + 1);
+        currChunk = chunks + chunksCount;
+        ++chunksCount;
+    }
+
+    chunkIndex = static_cast<int>(currChunk - chunks);
+}
+
+void MemPool::reserveChunks(int count)
+{
+    if (count <= chunksReserved)
+        return;
+
+    // we have ran out of chunks
+    const int newChunksReserved = chunksReserved + NGREST_MEMPOOL_CHUNK_RESERVE;
+    Chunk* newChunks = reinterpret_cast<Chunk*>(realloc(chunks, sizeof(Chunk) * static_cast<size_t>(newChunksReserved)));
+    if (!newChunks)
+        throw std::bad_alloc();
+
+    memset(newChunks + chunksReserved, 0, NGREST_MEMPOOL_CHUNK_RESERVE * sizeof(Chunk));
+
+    if (currChunk)
+        currChunk = newChunks + chunkIndex;
+    chunks = newChunks;
+    chunksReserved = newChunksReserved;
+}
+
+void MemPool::ownChunk(Chunk* chunk, uint64_t size)
+{
+    // copy attached data to own buffer to allow modification
+    char* buffer = reallocBuffer(nullptr, 0, 0, size);
+    memcpy(buffer, chunk->buffer, chunk->size);
+    chunk->buffer = buffer;
+    chunk->bufferSize = size;
+    chunk->external = false;
+}
+
 }
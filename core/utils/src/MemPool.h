@@ -23,12 +23,17 @@
 
 #include <stdint.h>
 #include <new>
+#include <memory>
+#include <vector>
 #include "ngrestutilsexport.h"
 
 namespace ngrest {
 
 #define NGREST_MEMPOOL_CHUNK_SIZE 4096
 
+class MemPooler;
+class SharedMemPooler;
+
 /**
  * @brief Memory pool to store large amount of small POCOs and joined strings
  */
@@ -43,6 +48,55 @@ public:
         char* buffer;           //!< begin of chunk buffer
         uint64_t bufferSize;    //!< buffer size
         uint64_t size;          //!< current size of chunk
+        bool external;          //!< buffer is attached, not owned by memory pool
+    };
+
+    /**
+     * @brief range of chunks holding data of memory pool.
+     *   allows consumers to process data in place instead of flattening it
+     */
+    class Segments
+    {
+    public:
+        inline Segments(const Chunk* begin_, const Chunk* end_):
+            first(begin_), last(end_)
+        {
+        }
+
+        inline const Chunk* begin() const
+        {
+            return first;
+        }
+
+        inline const Chunk* end() const
+        {
+            return last;
+        }
+
+        /**
+         * @brief tests if all the data are stored in single chunk
+         * @return true if data are stored in single chunk
+         */
+        inline bool isContiguous() const
+        {
+            return (last - first) <= 1;
+        }
+
+        /**
+         * @brief get total size of data
+         * @return size of data
+         */
+        inline uint64_t getSize() const
+        {
+            uint64_t result = 0;
+            for (const Chunk* chunk = first; chunk != last; ++chunk)
+                result += chunk->size;
+            return result;
+        }
+
+    private:
+        const Chunk* first;
+        const Chunk* last;
     };
 
 public:
@@ -62,7 +116,7 @@ public:
      */
     template <typename T> inline T* alloc()
     {
-        return new (grow(sizeof(T))) T();
+        return new (growAligned(sizeof(T), alignof(T))) T();
     }
 
     /**
@@ -71,7 +125,7 @@ public:
      */
     template <typename T, typename P1> inline T* alloc(P1 p1)
     {
-        return new (grow(sizeof(T))) T(p1);
+        return new (growAligned(sizeof(T), alignof(T))) T(p1);
     }
 
     /**
@@ -81,7 +135,7 @@ public:
      */
     template <typename T, typename P1, typename P2> inline T* alloc(P1 p1, P2 p2)
     {
-        return new (grow(sizeof(T))) T(p1, p2);
+        return new (growAligned(sizeof(T), alignof(T))) T(p1, p2);
     }
 
     /**
@@ -92,7 +146,7 @@ public:
      */
     template <typename T, typename P1, typename P2, typename P3> inline T* alloc(P1 p1, P2 p2, P3 p3)
     {
-        return new (grow(sizeof(T))) T(p1, p2, p3);
+        return new (growAligned(sizeof(T), alignof(T))) T(p1, p2, p3);
     }
 
     /**
@@ -100,7 +154,7 @@ public:
      */
     template <typename T> inline T* allocNoCtor()
     {
-        return reinterpret_cast<T*>(grow(sizeof(T)));
+        return reinterpret_cast<T*>(growAligned(sizeof(T), alignof(T)));
     }
 
     /**
@@ -153,6 +207,22 @@ public:
      */
     char* putData(const char* data, uint64_t size);
 
+    /**
+     * @brief append data stored outside of memory pool without copying.
+     *   data are referenced as a separate read-only chunk until memory pool is reset or freed,
+     *   owner is kept alive for that time. data are copied only when the chunk is modified
+     * @param data data to reference
+     * @param size size of data
+     * @param owner owner of data
+     */
+    void attach(const char* data, uint64_t size, const std::shared_ptr<const void>& owner);
+
+    /**
+     * @brief keep object alive until memory pool is reset or freed
+     * @param owner object to keep
+     */
+    void keepAlive(const std::shared_ptr<const void>& owner);
+
     /**
      * @brief get chunks allocated
      * @return chunks
@@ -217,6 +287,46 @@ public:
         return currChunk->buffer + offset;
     }
 
+    /**
+     * @brief allocate data in memory pool keeping all the data in the last chunk.
+     *   last chunk is reallocated with geometric growth when needed,
+     *   so data received by parts can be used without flatten
+     *   WARNING: existing pointers to the last chunk are invalidated on reallocation
+     * @param growSize size of data
+     * @return pointer to allocated data
+     */
+    inline char* growContiguous(uint64_t growSize)
+    {
+        if (currChunk && (currChunk->size + growSize) > currChunk->bufferSize)
+            expandLastChunk(currChunk->size + growSize);
+        return grow(growSize);
+    }
+
+    /**
+     * @brief allocate data in memory pool aligned to the given boundary
+     *   alignment must be power of two and must not exceed malloc's alignment
+     * @param growSize size of data
+     * @param alignment alignment of data
+     * @return pointer to allocated data
+     */
+    inline char* growAligned(uint64_t growSize, uint64_t alignment)
+    {
+        if (currChunk) {
+            const uint64_t misalign = reinterpret_cast<uintptr_t>(currChunk->buffer + currChunk->size)
+                    & (alignment - 1);
+            const uint64_t offset = currChunk->size + (misalign ? (alignment - misalign) : 0);
+            if ((offset + growSize) <= currChunk->bufferSize) {
+                currChunk->size = offset + growSize;
+                return currChunk->buffer + offset;
+            }
+        }
+
+        // data doesn't fit with padding: start new chunk, its buffer is already aligned
+        newChunk((growSize > chunkSize) ? growSize : chunkSize);
+        currChunk->size = growSize;
+        return currChunk->buffer;
+    }
+
     /**
      * @brief shrink last chunk by number of bytes specified
      * @param shrinkSize number of last bytes to remove from memory pool
@@ -228,6 +338,8 @@ public:
             return false;
 
         currChunk->size -= shrinkSize;
+        if (currChunk->external) // never write into attached data
+            currChunk->bufferSize = currChunk->size;
         return true;
     }
 
@@ -245,6 +357,21 @@ public:
         return result;
     }
 
+    /**
+     * @brief get chunks holding data
+     * @return range of chunks
+     */
+    inline Segments getSegments() const
+    {
+        return currChunk ? Segments(chunks, currChunk + 1) : Segments(nullptr, nullptr);
+    }
+
+    /**
+     * @brief get total size of buffers owned by memory pool, including unused space
+     * @return number of bytes allocated
+     */
+    uint64_t getAllocatedSize() const;
+
     /**
      * @brief concatenate all chunks into one continuous memory fragment
      *   WARNING: after this operation existing stored pointers will be invalidated
@@ -273,10 +400,32 @@ public:
      */
     void trim();
 
+    /**
+     * @brief reset memory pool and release memory over the limit given.
+     *   unlike trim() it also shrinks the first chunk if it was grown by large data
+     * @param maxSize max size of memory to retain
+     * @return true if memory pool was shrunk
+     */
+    bool shrink(uint64_t maxSize);
+
+    /**
+     * @brief exchange contents with another memory pool
+     *   default chunk sizes of memory pools are not exchanged
+     * @param other memory pool to exchange contents with
+     */
+    void swap(MemPool& other);
+
 private:
     void newChunk(uint64_t size = NGREST_MEMPOOL_CHUNK_SIZE);
+    void nextChunk();
+    void reserveChunks(int count);
+    void ownChunk(Chunk* chunk, uint64_t size);
+    void expandLastChunk(uint64_t minSize);
 
 private:
+    friend class MemPooler;
+    friend class SharedMemPooler;
+
     const uint64_t chunkSize;
 
     Chunk* chunks = nullptr;
@@ -284,6 +433,12 @@ private:
     int chunksCount = 0;
     int chunkIndex = 0;
     Chunk* currChunk = nullptr; // current chunk
+    std::vector<std::shared_ptr<const void>> owners; // owners of attached data
+
+    // intrusive links maintained by MemPooler
+    int sizeClass = -1;
+    MemPool* poolerNext = nullptr;
+    MemPool* poolerPrev = nullptr;
 };
 
 }
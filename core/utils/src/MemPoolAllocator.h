@@ -0,0 +1,197 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_MEMPOOLALLOCATOR_H
+#define NGREST_MEMPOOLALLOCATOR_H
+
+#include <stddef.h>
+#include <functional>
+#include <utility>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+
+#include "MemPool.h"
+#include "ngrestutilsexport.h"
+
+namespace ngrest {
+
+/**
+ * @brief sets memory pool used by default constructed MemPoolAllocator in the current thread
+ *
+ * Scope is active until destroyed, previous pool is restored then.
+ * Containers created within the scope must not outlive the pool.
+ */
+class NGREST_UTILS_EXPORT MemPoolScope
+{
+public:
+    /**
+     * @brief make memory pool current for the calling thread
+     * @param pool memory pool
+     */
+    MemPoolScope(MemPool* pool);
+
+    /**
+     * @brief restore previous memory pool
+     */
+    ~MemPoolScope();
+
+    /**
+     * @brief get current memory pool of the calling thread
+     * @return current memory pool or nullptr if no scope is active
+     */
+    static MemPool* current();
+
+private:
+    MemPoolScope(const MemPoolScope&);
+    MemPoolScope& operator=(const MemPoolScope&);
+
+private:
+    MemPool* prev;
+};
+
+/**
+ * @brief STL allocator which takes memory from MemPool
+ *
+ * Memory is never returned to the pool on deallocate, it's freed in bulk when pool is reset.
+ * Allocator without pool (default constructed outside of MemPoolScope) uses global heap.
+ */
+template <typename T>
+class MemPoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef MemPoolAllocator<U> other;
+    };
+
+    /**
+     * @brief create allocator using current pool of MemPoolScope
+     */
+    inline MemPoolAllocator():
+        pool(MemPoolScope::current())
+    {
+    }
+
+    /**
+     * @brief create allocator using given pool
+     * @param pool_ memory pool, nullptr to use global heap
+     */
+    inline MemPoolAllocator(MemPool* pool_):
+        pool(pool_)
+    {
+    }
+
+    template <typename U>
+    inline MemPoolAllocator(const MemPoolAllocator<U>& other):
+        pool(other.getPool())
+    {
+    }
+
+    inline T* allocate(size_t count)
+    {
+        const size_t size = count * sizeof(T);
+        if (!pool)
+            return static_cast<T*>(::operator new(size));
+        return reinterpret_cast<T*>(pool->growAligned(size, alignof(T)));
+    }
+
+    inline void deallocate(T* ptr, size_t)
+    {
+        if (!pool)
+            ::operator delete(ptr);
+    }
+
+    template <typename U, typename... Args>
+    inline void construct(U* ptr, Args&&... args)
+    {
+        ::new(static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    inline void destroy(U* ptr)
+    {
+        ptr->~U();
+    }
+
+    inline size_t max_size() const
+    {
+        return static_cast<size_t>(-1) / sizeof(T);
+    }
+
+    /**
+     * @brief get memory pool of allocator
+     * @return memory pool or nullptr if global heap is used
+     */
+    inline MemPool* getPool() const
+    {
+        return pool;
+    }
+
+private:
+    MemPool* pool;
+};
+
+template <typename T, typename U>
+inline bool operator==(const MemPoolAllocator<T>& a, const MemPoolAllocator<U>& b)
+{
+    return a.getPool() == b.getPool();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const MemPoolAllocator<T>& a, const MemPoolAllocator<U>& b)
+{
+    return a.getPool() != b.getPool();
+}
+
+/**
+ * @brief containers allocating memory from MemPool
+ *
+ * Intended for request-scoped data: ngrestcg constructs parameters
+ * of these types within MemPoolScope of the request's memory pool.
+ */
+namespace pool {
+
+typedef std::basic_string<char, std::char_traits<char>, MemPoolAllocator<char>> string;
+
+template <typename T>
+using vector = std::vector<T, MemPoolAllocator<T>>;
+
+template <typename T>
+using list = std::list<T, MemPoolAllocator<T>>;
+
+template <typename K, typename V, typename Compare = std::less<K>>
+using map = std::map<K, V, Compare, MemPoolAllocator<std::pair<const K, V>>>;
+
+} // namespace pool
+
+} // namespace ngrest
+
+#endif // NGREST_MEMPOOLALLOCATOR_H
@@ -19,66 +19,223 @@
  */
 
 
+#include <mutex>
+
 #include "Exception.h"
 #include "MemPooler.h"
 
 namespace ngrest {
 
-// max pools count per size
-#define MAX_POOLS_COUNT 128
+namespace {
+
+// all the poolers alive, to collect statistics and share the global budget
+struct PoolerRegistry
+{
+    std::mutex mutex;
+    std::vector<MemPooler*> poolers;
+    uint64_t lastIndex = 0;
+    uint64_t maxTotalUnusedSize = NGREST_MEMPOOLER_MAX_TOTAL_UNUSED_SIZE;
+
+    static PoolerRegistry& inst()
+    {
+        static PoolerRegistry registry;
+        return registry;
+    }
+};
+
+}
 
-MemPooler::MemPooler()
+MemPooler::MemPooler(uint64_t maxUnusedSize_):
+    maxUnusedSize(maxUnusedSize_)
 {
+    PoolerRegistry& registry = PoolerRegistry::inst();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    index = ++registry.lastIndex;
+    registry.poolers.push_back(this);
+    updateLimits(registry.poolers, registry.maxTotalUnusedSize);
 }
 
 MemPooler::~MemPooler()
 {
-    for (auto& poolByChunk : pools) {
-        for (MemPool* pool : poolByChunk.second.used)
-            delete pool;
-        for (MemPool* pool : poolByChunk.second.unused)
+    {
+        PoolerRegistry& registry = PoolerRegistry::inst();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto it = registry.poolers.begin(); it != registry.poolers.end(); ++it) {
+            if (*it == this) {
+                registry.poolers.erase(it);
+                break;
+            }
+        }
+        updateLimits(registry.poolers, registry.maxTotalUnusedSize);
+    }
+
+    for (SizeClass& sizeClass : sizeClasses) {
+        for (MemPool* pool = sizeClass.unused; pool;) {
+            MemPool* next = pool->poolerNext;
             delete pool;
+            pool = next;
+        }
     }
-    pools.clear();
+    sizeClasses.clear();
+    unusedSize = 0;
+
+#ifdef DEBUG
+    for (MemPool* pool = used; pool;) {
+        MemPool* next = pool->poolerNext;
+        delete pool;
+        pool = next;
+    }
+    used = nullptr;
+#endif
 }
 
 MemPool* MemPooler::obtain(uint64_t chunkSize)
 {
-    MemPool* pool;
-    Pools& poolsByChunk = pools[chunkSize];
-    if (!poolsByChunk.unused.empty()) {
-        pool = poolsByChunk.unused.back();
-        poolsByChunk.unused.pop_back();
+    const int sizeClassIndex = getSizeClass(chunkSize);
+    SizeClass& sizeClass = sizeClasses[static_cast<size_t>(sizeClassIndex)];
+    obtained.add();
+
+    MemPool* pool = sizeClass.unused;
+    if (pool) {
+        sizeClass.unused = pool->poolerNext;
+        const uint64_t size = pool->getAllocatedSize();
+        unusedSize -= size;
+        unusedCount.sub(1);
+        unusedSizeStat.set(unusedSize);
     } else {
         pool = new MemPool(chunkSize);
-        if (poolsByChunk.used.empty()) {
-            poolsByChunk.used.reserve(MAX_POOLS_COUNT);
-            poolsByChunk.unused.reserve(MAX_POOLS_COUNT);
-        }
+        pool->sizeClass = sizeClassIndex;
+        created.add();
     }
 
-    poolsByChunk.used.push_back(pool);
+    pool->poolerPrev = nullptr;
+    pool->poolerNext = nullptr;
+#ifdef DEBUG
+    pool->poolerNext = used;
+    if (used)
+        used->poolerPrev = pool;
+    used = pool;
+#endif
+
     return pool;
 }
 
 void MemPooler::recycle(MemPool* pool)
 {
     NGREST_ASSERT_PARAM(pool);
-    Pools& poolsByChunk = pools[pool->getChunkSize()];
-    for (auto it = poolsByChunk.used.begin(); it != poolsByChunk.used.end(); ++it) {
-        if (*it == pool) {
-            poolsByChunk.used.erase(it);
-            break;
-        }
-    }
+    NGREST_ASSERT(pool->sizeClass >= 0 && static_cast<size_t>(pool->sizeClass) < sizeClasses.size()
+                  && sizeClasses[static_cast<size_t>(pool->sizeClass)].chunkSize == pool->getChunkSize(),
+                  "Memory pool does not belong to this pooler");
+
+#ifdef DEBUG
+    NGREST_DEBUG_ASSERT(pool->poolerPrev || used == pool, "Memory pool is recycled twice");
+    if (pool->poolerPrev)
+        pool->poolerPrev->poolerNext = pool->poolerNext;
+    else
+        used = pool->poolerNext;
+    if (pool->poolerNext)
+        pool->poolerNext->poolerPrev = pool->poolerPrev;
+    pool->poolerPrev = nullptr;
+#endif
+
+    recycled.add();
+    if (pool->shrink(pool->getChunkSize() * NGREST_MEMPOOLER_MAX_RETAINED_CHUNKS))
+        shrunk.add();
 
-    if (poolsByChunk.unused.size() >= MAX_POOLS_COUNT) {
+    const uint64_t size = pool->getAllocatedSize();
+    if ((unusedSize + size) > unusedLimit.get()) {
         delete pool;
-    } else {
-        pool->reset();
-        pool->trim();
-        poolsByChunk.unused.push_back(pool);
+        deleted.add();
+        return;
+    }
+
+    SizeClass& sizeClass = sizeClasses[static_cast<size_t>(pool->sizeClass)];
+    pool->poolerNext = sizeClass.unused;
+    sizeClass.unused = pool;
+    unusedSize += size;
+    unusedCount.add();
+    unusedSizeStat.set(unusedSize);
+    if (unusedSize > unusedPeak.get())
+        unusedPeak.set(unusedSize);
+}
+
+void MemPooler::discard(MemPool* pool)
+{
+    NGREST_ASSERT_PARAM(pool);
+
+#ifdef DEBUG
+    NGREST_DEBUG_ASSERT(pool->poolerPrev || used == pool, "Memory pool is discarded after recycling");
+    if (pool->poolerPrev)
+        pool->poolerPrev->poolerNext = pool->poolerNext;
+    else
+        used = pool->poolerNext;
+    if (pool->poolerNext)
+        pool->poolerNext->poolerPrev = pool->poolerPrev;
+#endif
+
+    recycled.add();
+    delete pool;
+    deleted.add();
+}
+
+void MemPooler::getStats(MemPoolerStats& stats) const
+{
+    stats = MemPoolerStats();
+    stats.index = index;
+    stats.obtained = obtained.get();
+    stats.recycled = recycled.get();
+    stats.created = created.get();
+    stats.deleted = deleted.get();
+    stats.shrunk = shrunk.get();
+    stats.unusedCount = unusedCount.get();
+    stats.unusedSize = unusedSizeStat.get();
+    stats.unusedPeak = unusedPeak.get();
+    stats.unusedLimit = unusedLimit.get();
+}
+
+void MemPooler::getAllStats(std::vector<MemPoolerStats>& stats)
+{
+    PoolerRegistry& registry = PoolerRegistry::inst();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    stats.resize(registry.poolers.size());
+    for (size_t i = 0; i < registry.poolers.size(); ++i)
+        registry.poolers[i]->getStats(stats[i]);
+}
+
+void MemPooler::setMaxTotalUnusedSize(uint64_t size)
+{
+    PoolerRegistry& registry = PoolerRegistry::inst();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.maxTotalUnusedSize = size;
+    updateLimits(registry.poolers, size);
+}
+
+void MemPooler::updateLimits(const std::vector<MemPooler*>& poolers, uint64_t maxTotalUnusedSize)
+{
+    if (poolers.empty())
+        return;
+
+    const uint64_t share = maxTotalUnusedSize / poolers.size();
+    for (MemPooler* pooler : poolers)
+        pooler->unusedLimit.set((share < pooler->maxUnusedSize) ? share : pooler->maxUnusedSize);
+}
+
+int MemPooler::getSizeClass(uint64_t chunkSize)
+{
+    if (!sizeClasses.empty() && sizeClasses[static_cast<size_t>(lastSizeClass)].chunkSize == chunkSize)
+        return lastSizeClass;
+
+    const int count = static_cast<int>(sizeClasses.size());
+    for (int i = 0; i < count; ++i) {
+        if (sizeClasses[static_cast<size_t>(i)].chunkSize == chunkSize) {
+            lastSizeClass = i;
+            return i;
+        }
     }
+
+    sizeClasses.push_back({chunkSize, nullptr});
+    lastSizeClass = count;
+    return count;
 }
 
 }
@@ -21,29 +21,91 @@
 #ifndef NGREST_MEMPOOLER_H
 #define NGREST_MEMPOOLER_H
 
+#include <atomic>
 #include <vector>
-#include <unordered_map>
 
 #include "MemPool.h"
 
+//! default limit of memory kept in unused pools, bytes
+#define NGREST_MEMPOOLER_MAX_UNUSED_SIZE (16 * 1024 * 1024)
+
+//! default limit of memory kept in unused pools of all the poolers, bytes
+#define NGREST_MEMPOOLER_MAX_TOTAL_UNUSED_SIZE (256 * 1024 * 1024)
+
+//! unused pool may retain up to this number of default chunk sizes, larger pools are shrunk on recycle
+#define NGREST_MEMPOOLER_MAX_RETAINED_CHUNKS 16
+
 namespace ngrest {
 
-struct Pools
+/**
+ * @brief memory pooler statistics
+ */
+struct MemPoolerStats
+{
+    uint64_t index = 0;         //!< sequential number of pooler or thread, 0 for shared depot
+    uint64_t obtained = 0;      //!< number of pools obtained
+    uint64_t recycled = 0;      //!< number of pools recycled
+    uint64_t created = 0;       //!< number of pools created
+    uint64_t deleted = 0;       //!< number of pools deleted due to limits
+    uint64_t shrunk = 0;        //!< number of oversized pools shrunk on recycle
+    uint64_t depotGets = 0;     //!< number of batches taken from depot
+    uint64_t depotPuts = 0;     //!< number of batches returned to depot
+    uint64_t unusedCount = 0;   //!< number of unused pools kept
+    uint64_t unusedSize = 0;    //!< size of memory kept in unused pools
+    uint64_t unusedPeak = 0;    //!< high-water mark of memory kept in unused pools
+    uint64_t unusedLimit = 0;   //!< limit of memory kept in unused pools
+};
+
+/**
+ * @brief statistics counter written by single thread and read by any
+ */
+class MemPoolerCounter
 {
-    std::vector<MemPool*> used;
-    std::vector<MemPool*> unused;
+public:
+    inline void add(uint64_t value = 1)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    inline void sub(uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) - value, std::memory_order_relaxed);
+    }
+
+    inline void set(uint64_t value)
+    {
+        counter.store(value, std::memory_order_relaxed);
+    }
+
+    inline uint64_t get() const
+    {
+        return counter.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> counter{0};
 };
 
 /**
  * @brief memory pool manager. intended to manage, store and re-use memory pools
+ *
+ * Pools are kept in intrusive free lists per chunk size, so obtain and recycle
+ * take constant time. In DEBUG builds pools given away are tracked as well
+ * to detect double recycle and to free pools which were never returned.
+ *
+ * Memory kept in unused pools is limited by both the pooler's own limit
+ * and its share of the global budget set by setMaxTotalUnusedSize.
+ * Pools grown by large requests are shrunk on recycle, so traffic spikes
+ * don't leave oversized buffers allocated.
  */
 class NGREST_UTILS_EXPORT MemPooler
 {
 public:
     /**
      * @brief constructor
+     * @param maxUnusedSize max total size of memory kept in unused pools
      */
-    MemPooler();
+    MemPooler(uint64_t maxUnusedSize = NGREST_MEMPOOLER_MAX_UNUSED_SIZE);
 
     /**
      * @brief destructor
@@ -63,12 +125,72 @@ public:
      */
     void recycle(MemPool* pool);
 
+    /**
+     * @brief delete memory pool instead of recycling it.
+     *   used when memory of the pool may still be referenced, e.g. by kernel sending from it
+     * @param pool pool to delete
+     */
+    void discard(MemPool* pool);
+
+    /**
+     * @brief get total size of memory kept in unused pools
+     * @return size in bytes
+     */
+    inline uint64_t getUnusedSize() const
+    {
+        return unusedSize;
+    }
+
+    /**
+     * @brief get statistics of pooler. may be called from any thread
+     * @param stats resulting statistics
+     */
+    void getStats(MemPoolerStats& stats) const;
+
+    /**
+     * @brief get statistics of all the poolers alive. may be called from any thread
+     * @param stats resulting statistics
+     */
+    static void getAllStats(std::vector<MemPoolerStats>& stats);
+
+    /**
+     * @brief set global budget of memory kept in unused pools.
+     *   the budget is shared equally between all the poolers alive
+     * @param size max total size of memory kept in unused pools of all the poolers
+     */
+    static void setMaxTotalUnusedSize(uint64_t size);
+
 private:
     MemPooler(const MemPooler&);
     MemPooler& operator=(const MemPooler&);
 
+    int getSizeClass(uint64_t chunkSize);
+    static void updateLimits(const std::vector<MemPooler*>& poolers, uint64_t maxTotalUnusedSize);
+
 private:
-    std::unordered_map<uint64_t, Pools> pools;
+    struct SizeClass
+    {
+        uint64_t chunkSize;
+        MemPool* unused;    //!< head of free list
+    };
+
+    // few distinct chunk sizes are used, linear search is faster than hashing
+    std::vector<SizeClass> sizeClasses;
+    int lastSizeClass = 0;
+    const uint64_t maxUnusedSize;
+    uint64_t unusedSize = 0;
+    uint64_t index = 0;
+
+    MemPoolerCounter unusedLimit; // effective limit, updated when global budget changes
+    MemPoolerCounter obtained;
+    MemPoolerCounter recycled;
+    MemPoolerCounter created;
+    MemPoolerCounter deleted;
+    MemPoolerCounter shrunk;
+    MemPoolerCounter unusedCount;
+    MemPoolerCounter unusedSizeStat;
+    MemPoolerCounter unusedPeak;
+    MemPool* used = nullptr; // head of list of pools given away, maintained in DEBUG builds only
 };
 
 }
@@ -0,0 +1,325 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+#include <atomic>
+#include <mutex>
+
+#include "Exception.h"
+#include "SharedMemPooler.h"
+
+namespace ngrest {
+
+// max number of pools taken from depot at once
+#define DEPOT_BATCH_SIZE 16
+
+namespace {
+
+// list of unused pools of the same chunk size
+struct PoolList
+{
+    uint64_t chunkSize;
+    MemPool* head;
+    uint64_t count;
+    uint64_t size;
+};
+
+PoolList* findList(std::vector<PoolList>& lists, uint64_t chunkSize)
+{
+    for (PoolList& list : lists)
+        if (list.chunkSize == chunkSize)
+            return &list;
+
+    lists.push_back({chunkSize, nullptr, 0, 0});
+    return &lists.back();
+}
+
+}
+
+struct ThreadMemPoolCache
+{
+    SharedMemPooler::Impl* impl;
+    uint64_t index;
+    std::vector<PoolList> lists;
+    PoolList* lastList = nullptr;
+    uint64_t unusedSize = 0;
+
+    MemPoolerCounter obtained;
+    MemPoolerCounter recycled;
+    MemPoolerCounter created;
+    MemPoolerCounter deleted;
+    MemPoolerCounter shrunk;
+    MemPoolerCounter depotGets;
+    MemPoolerCounter depotPuts;
+    MemPoolerCounter unusedCountStat;
+    MemPoolerCounter unusedSizeStat;
+    MemPoolerCounter unusedPeak;
+
+    ThreadMemPoolCache(SharedMemPooler::Impl* impl);
+    ~ThreadMemPoolCache();
+
+    inline PoolList* getList(uint64_t chunkSize)
+    {
+        if (!lastList || lastList->chunkSize != chunkSize)
+            lastList = findList(lists, chunkSize); // may reallocate lists, but updates lastList
+        return lastList;
+    }
+
+    void flush();
+};
+
+struct SharedMemPooler::Impl
+{
+    mutable std::mutex mutex;
+    std::vector<PoolList> depot;
+    std::vector<ThreadMemPoolCache*> caches;
+    uint64_t depotSize = 0;
+    uint64_t threadCount = 0;
+    std::atomic<uint64_t> maxThreadSize{NGREST_SHAREDMEMPOOLER_MAX_THREAD_SIZE};
+    uint64_t maxDepotSize = NGREST_SHAREDMEMPOOLER_MAX_DEPOT_SIZE;
+    MemPoolerStats depotStats;
+
+    ThreadMemPoolCache& getCache()
+    {
+        static thread_local ThreadMemPoolCache cache(this);
+        return cache;
+    }
+
+    // move pools of the list to depot, must be called with mutex locked
+    void putToDepot(ThreadMemPoolCache& cache, PoolList& list, uint64_t count)
+    {
+        if (!count)
+            return;
+
+        cache.depotPuts.add();
+        PoolList* depotList = findList(depot, list.chunkSize);
+        for (; count && list.head; --count) {
+            MemPool* pool = list.head;
+            list.head = SharedMemPooler::nextPool(pool);
+            const uint64_t size = pool->getAllocatedSize();
+            --list.count;
+            list.size -= size;
+            cache.unusedSize -= size;
+            cache.unusedCountStat.sub(1);
+            cache.unusedSizeStat.sub(size);
+
+            if ((depotSize + size) > maxDepotSize) {
+                delete pool;
+                cache.deleted.add();
+                continue;
+            }
+
+            SharedMemPooler::nextPool(pool) = depotList->head;
+            depotList->head = pool;
+            ++depotList->count;
+            depotList->size += size;
+            depotSize += size;
+        }
+    }
+};
+
+ThreadMemPoolCache::ThreadMemPoolCache(SharedMemPooler::Impl* impl_):
+    impl(impl_)
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    index = ++impl->threadCount;
+    impl->caches.push_back(this);
+}
+
+ThreadMemPoolCache::~ThreadMemPoolCache()
+{
+    flush();
+}
+
+void ThreadMemPoolCache::flush()
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    for (PoolList& list : lists)
+        impl->putToDepot(*this, list, list.count);
+
+    // keep statistics of exited threads in depot
+    impl->depotStats.obtained += obtained.get();
+    impl->depotStats.recycled += recycled.get();
+    impl->depotStats.created += created.get();
+    impl->depotStats.deleted += deleted.get();
+    impl->depotStats.shrunk += shrunk.get();
+    impl->depotStats.depotGets += depotGets.get();
+    impl->depotStats.depotPuts += depotPuts.get();
+
+    for (auto it = impl->caches.begin(); it != impl->caches.end(); ++it) {
+        if (*it == this) {
+            impl->caches.erase(it);
+            break;
+        }
+    }
+}
+
+
+SharedMemPooler& SharedMemPooler::inst()
+{
+    static SharedMemPooler instance;
+    return instance;
+}
+
+SharedMemPooler::SharedMemPooler():
+    impl(new Impl())
+{
+}
+
+SharedMemPooler::~SharedMemPooler()
+{
+    {
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        for (PoolList& list : impl->depot) {
+            for (MemPool* pool = list.head; pool;) {
+                MemPool* next = nextPool(pool);
+                delete pool;
+                pool = next;
+            }
+        }
+        impl->depot.clear();
+        impl->depotSize = 0;
+    }
+    // impl is left for threads still running, they return their pools to the empty depot
+}
+
+MemPool* SharedMemPooler::obtain(uint64_t chunkSize)
+{
+    ThreadMemPoolCache& cache = impl->getCache();
+    PoolList* list = cache.getList(chunkSize);
+    cache.obtained.add();
+
+    if (!list->head) {
+        // try to take a batch of pools from depot
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        PoolList* depotList = findList(impl->depot, chunkSize);
+        if (depotList->head) {
+            for (int i = 0; i < DEPOT_BATCH_SIZE && depotList->head; ++i) {
+                MemPool* pool = depotList->head;
+                depotList->head = nextPool(pool);
+                const uint64_t size = pool->getAllocatedSize();
+                --depotList->count;
+                depotList->size -= size;
+                impl->depotSize -= size;
+
+                nextPool(pool) = list->head;
+                list->head = pool;
+                ++list->count;
+                list->size += size;
+                cache.unusedSize += size;
+                cache.unusedCountStat.add();
+                cache.unusedSizeStat.add(size);
+            }
+            cache.depotGets.add();
+        }
+    }
+
+    MemPool* pool = list->head;
+    if (pool) {
+        list->head = nextPool(pool);
+        const uint64_t size = pool->getAllocatedSize();
+        --list->count;
+        list->size -= size;
+        cache.unusedSize -= size;
+        cache.unusedCountStat.sub(1);
+        cache.unusedSizeStat.sub(size);
+        nextPool(pool) = nullptr;
+    } else {
+        pool = new MemPool(chunkSize);
+        cache.created.add();
+    }
+
+    return pool;
+}
+
+void SharedMemPooler::recycle(MemPool* pool)
+{
+    NGREST_ASSERT_PARAM(pool);
+
+    ThreadMemPoolCache& cache = impl->getCache();
+    if (pool->shrink(pool->getChunkSize() * NGREST_MEMPOOLER_MAX_RETAINED_CHUNKS))
+        cache.shrunk.add();
+
+    PoolList* list = cache.getList(pool->getChunkSize());
+    const uint64_t size = pool->getAllocatedSize();
+    cache.recycled.add();
+
+    nextPool(pool) = list->head;
+    list->head = pool;
+    ++list->count;
+    list->size += size;
+    cache.unusedSize += size;
+    cache.unusedCountStat.add();
+    cache.unusedSizeStat.add(size);
+    if (cache.unusedSize > cache.unusedPeak.get())
+        cache.unusedPeak.set(cache.unusedSize);
+
+    if (cache.unusedSize > impl->maxThreadSize.load(std::memory_order_relaxed)) {
+        // rebalance: give half of the pools to other threads
+        std::lock_guard<std::mutex> lock(impl->mutex);
+        for (PoolList& threadList : cache.lists)
+            impl->putToDepot(cache, threadList, (threadList.count + 1) / 2);
+    }
+}
+
+void SharedMemPooler::setLimits(uint64_t maxThreadSize, uint64_t maxDepotSize)
+{
+    impl->maxThreadSize.store(maxThreadSize, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    impl->maxDepotSize = maxDepotSize;
+}
+
+void SharedMemPooler::getStats(std::vector<MemPoolerStats>& stats) const
+{
+    std::lock_guard<std::mutex> lock(impl->mutex);
+    stats.clear();
+    stats.reserve(impl->caches.size() + 1);
+
+    MemPoolerStats depotStats = impl->depotStats;
+    depotStats.index = 0;
+    depotStats.unusedCount = 0;
+    for (const PoolList& list : impl->depot)
+        depotStats.unusedCount += list.count;
+    depotStats.unusedSize = impl->depotSize;
+    depotStats.unusedLimit = impl->maxDepotSize;
+    stats.push_back(depotStats);
+
+    for (const ThreadMemPoolCache* cache : impl->caches) {
+        MemPoolerStats threadStats;
+        threadStats.index = cache->index;
+        threadStats.obtained = cache->obtained.get();
+        threadStats.recycled = cache->recycled.get();
+        threadStats.created = cache->created.get();
+        threadStats.deleted = cache->deleted.get();
+        threadStats.shrunk = cache->shrunk.get();
+        threadStats.depotGets = cache->depotGets.get();
+        threadStats.depotPuts = cache->depotPuts.get();
+        threadStats.unusedCount = cache->unusedCountStat.get();
+        threadStats.unusedSize = cache->unusedSizeStat.get();
+        threadStats.unusedPeak = cache->unusedPeak.get();
+        threadStats.unusedLimit = impl->maxThreadSize.load(std::memory_order_relaxed);
+        stats.push_back(threadStats);
+    }
+}
+
+MemPool*& SharedMemPooler::nextPool(MemPool* pool)
+{
+    return pool->poolerNext;
+}
+
+}
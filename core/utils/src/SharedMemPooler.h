@@ -0,0 +1,95 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+#ifndef NGREST_SHAREDMEMPOOLER_H
+#define NGREST_SHAREDMEMPOOLER_H
+
+#include <vector>
+
+#include "MemPooler.h"
+
+//! default limit of memory kept in unused pools of each thread, bytes
+#define NGREST_SHAREDMEMPOOLER_MAX_THREAD_SIZE (4 * 1024 * 1024)
+
+//! default limit of memory kept in global depot, bytes
+#define NGREST_SHAREDMEMPOOLER_MAX_DEPOT_SIZE (64 * 1024 * 1024)
+
+namespace ngrest {
+
+/**
+ * @brief thread safe memory pool manager
+ *
+ * Each thread keeps own cache of unused pools, so obtain and recycle never take
+ * a lock while the cache can serve them. Caches are rebalanced through global depot:
+ * thread takes a batch of pools from depot when it runs out of pools and
+ * returns half of its pools when it exceeds the limit. A pool may be recycled
+ * by any thread, not only by the one obtained it.
+ */
+class NGREST_UTILS_EXPORT SharedMemPooler
+{
+public:
+    /**
+     * @brief get shared memory pooler instance
+     * @return shared memory pooler instance
+     */
+    static SharedMemPooler& inst();
+
+    /**
+     * @brief obtain memory pool with preferred chunk size
+     * @param chunkSize default chunk size of memory pool
+     * @return memory pool
+     */
+    MemPool* obtain(uint64_t chunkSize = NGREST_MEMPOOL_CHUNK_SIZE);
+
+    /**
+     * @brief recycle memory pool for later reuse
+     * @param pool pool to recycle
+     */
+    void recycle(MemPool* pool);
+
+    /**
+     * @brief set memory limits
+     * @param maxThreadSize max total size of memory kept in unused pools of each thread
+     * @param maxDepotSize max total size of memory kept in global depot
+     */
+    void setLimits(uint64_t maxThreadSize, uint64_t maxDepotSize);
+
+    /**
+     * @brief get statistics of all the threads using pooler
+     * @param stats resulting statistics, first element describes the depot
+     */
+    void getStats(std::vector<MemPoolerStats>& stats) const;
+
+private:
+    SharedMemPooler();
+    ~SharedMemPooler();
+    SharedMemPooler(const SharedMemPooler&);
+    SharedMemPooler& operator=(const SharedMemPooler&);
+
+    static MemPool*& nextPool(MemPool* pool);
+
+private:
+    struct Impl;
+    Impl* const impl;
+    friend struct ThreadMemPoolCache;
+};
+
+}
+
+#endif // NGREST_SHAREDMEMPOOLER_H
@@ -0,0 +1,155 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_UTILS_STRINGREF_H
+#define NGREST_UTILS_STRINGREF_H
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+namespace ngrest {
+
+/**
+ * @brief non-owning reference to a string with length
+ *
+ * Used in service signatures and structures to bind string values directly
+ * to the request buffer without copying. Referenced data is valid only
+ * while the request is processed.
+ */
+class StringRef
+{
+public:
+    /**
+     * @brief create an empty string reference
+     */
+    inline StringRef():
+        ptr(""), len(0)
+    {
+    }
+
+    /**
+     * @brief create reference to C-string
+     * @param str C-string
+     */
+    inline StringRef(const char* str):
+        ptr(str ? str : ""), len(str ? strlen(str) : 0)
+    {
+    }
+
+    /**
+     * @brief create reference to the string of given length
+     * @param str begin of the string
+     * @param size length of the string
+     */
+    inline StringRef(const char* str, size_t size):
+        ptr(str), len(size)
+    {
+    }
+
+    /**
+     * @brief create reference to std::string. the string must outlive reference
+     * @param str string
+     */
+    inline StringRef(const std::string& str):
+        ptr(str.data()), len(str.size())
+    {
+    }
+
+    inline const char* data() const
+    {
+        return ptr;
+    }
+
+    inline size_t size() const
+    {
+        return len;
+    }
+
+    inline size_t length() const
+    {
+        return len;
+    }
+
+    inline bool empty() const
+    {
+        return len == 0;
+    }
+
+    inline const char* begin() const
+    {
+        return ptr;
+    }
+
+    inline const char* end() const
+    {
+        return ptr + len;
+    }
+
+    inline char operator[](size_t pos) const
+    {
+        return ptr[pos];
+    }
+
+    /**
+     * @brief copy referenced data into a string
+     * @return string
+     */
+    inline std::string str() const
+    {
+        return std::string(ptr, len);
+    }
+
+    /**
+     * @brief compare with another string
+     * @param other string to compare with
+     * @return negative, zero or positive value as strcmp does
+     */
+    inline int compare(const StringRef& other) const
+    {
+        const int res = memcmp(ptr, other.ptr, len < other.len ? len : other.len);
+        if (res)
+            return res;
+        return len < other.len ? -1 : (len > other.len ? 1 : 0);
+    }
+
+private:
+    const char* ptr;
+    size_t len;
+};
+
+inline bool operator==(const StringRef& a, const StringRef& b)
+{
+    return a.size() == b.size() && !memcmp(a.data(), b.data(), a.size());
+}
+
+inline bool operator!=(const StringRef& a, const StringRef& b)
+{
+    return !(a == b);
+}
+
+inline bool operator<(const StringRef& a, const StringRef& b)
+{
+    return a.compare(b) < 0;
+}
+
+} // namespace ngrest
+
+#endif // NGREST_UTILS_STRINGREF_H
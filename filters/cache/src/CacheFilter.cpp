@@ -0,0 +1,242 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <iterator>
+
+#include <ngrest/utils/Log.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/utils/ElapsedTimer.h>
+#include <ngrest/utils/fromcstring.h>
+#include <ngrest/common/Message.h>
+#include <ngrest/common/HttpMessage.h>
+#include <ngrest/engine/Engine.h>
+#include <ngrest/engine/ServiceDispatcher.h>
+#include <ngrest/engine/ServiceDescription.h>
+#include <ngrest/engine/Transport.h>
+#include <ngrest/engine/Phase.h>
+
+#include "CacheFilter.h"
+
+#define DEFAULT_MAX_SIZE 67108864 // 64 Mb
+#define ENTRY_OVERHEAD 256 // approximate memory used by entry besides key, body and headers
+
+namespace ngrest {
+
+static const char* const CACHE_KEY_ATTRIBUTE = "cache-key";
+
+ResponseCache::ResponseCache():
+    keyHeaders({"accept-encoding"}), // cached body may be compressed
+    maxSize(DEFAULT_MAX_SIZE)
+{
+    const char* maxSizeStr = getenv("NGREST_CACHE_MAX_SIZE");
+    if (maxSizeStr && !fromCString(maxSizeStr, maxSize))
+        LogWarning() << "Invalid NGREST_CACHE_MAX_SIZE: " << maxSizeStr;
+
+    const char* keyHeadersStr = getenv("NGREST_CACHE_KEY_HEADERS");
+    if (keyHeadersStr) {
+        std::string name;
+        for (const char* ch = keyHeadersStr; ; ++ch) {
+            if (*ch == ',' || *ch == '\0') {
+                if (!name.empty())
+                    keyHeaders.push_back(name);
+                name.clear();
+                if (*ch == '\0')
+                    break;
+            } else if (*ch != ' ') {
+                // header names are stored in lower case
+                name += static_cast<char>(tolower(*ch));
+            }
+        }
+    }
+}
+
+bool ResponseCache::get(MessageContext* context)
+{
+    std::string key;
+    if (!makeKey(context, key))
+        return false;
+
+    EntryPtr entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end()) {
+            if ((*it->second)->expires > ElapsedTimer::getTime()) {
+                // most recently used goes first
+                entries.splice(entries.begin(), entries, it->second);
+                entry = *it->second;
+            } else {
+                remove(it->second);
+            }
+        }
+    }
+
+    MemPool* pool = context->pool;
+    if (!entry) {
+        // keep the key for put()
+        context->attributes = pool->alloc<Header>(CACHE_KEY_ATTRIBUTE,
+                                                  pool->putCString(key.c_str(), key.size(), true),
+                                                  context->attributes);
+        return false;
+    }
+
+    // entry is immutable, so response refers to its data while the pools hold it
+    Response* response = context->response;
+    pool->keepAlive(entry);
+    // headers are stored in reverse order
+    for (const auto& header : entry->headers)
+        response->headers = pool->alloc<Header>(header.first.c_str(), header.second.c_str(), response->headers);
+    response->poolBody->attach(entry->body.data(), entry->body.size(), entry);
+    response->handled = true;
+
+    LogDebug() << "Response to " << context->request->path << " is taken from cache";
+    return true;
+}
+
+void ResponseCache::put(MessageContext* context)
+{
+    const Header* keyAttribute = context->attributes;
+    while (keyAttribute && keyAttribute->name != CACHE_KEY_ATTRIBUTE)
+        keyAttribute = keyAttribute->next;
+    // request is not cacheable or response is taken from cache
+    if (!keyAttribute)
+        return;
+
+    const HttpResponse* response = static_cast<const HttpResponse*>(context->response);
+    const MemPool* poolBody = response->poolBody;
+    if (response->producer || !poolBody || !poolBody->getSize() || poolBody->getSize() > maxSize
+            || (response->statusCode != HTTP_STATUS_UNDEFINED && response->statusCode != HTTP_STATUS_200_OK))
+        return;
+
+    const OperationDescription* operation = context->engine->getServiceDispatcher()
+            .findOperation(context->request->path, context->transport->getRequestMethod(context->request));
+    if (!operation || operation->cacheTtl <= 0)
+        return;
+
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->key = keyAttribute->value;
+    entry->size = ENTRY_OVERHEAD + entry->key.size() * 2 + poolBody->getSize();
+    for (const Header* header = response->headers; header; header = header->next) {
+        // private response
+        if (!strcasecmp(header->name, "set-cookie"))
+            return;
+        entry->headers.emplace(entry->headers.begin(), header->name, header->value);
+        entry->size += strlen(header->name) + strlen(header->value) + ENTRY_OVERHEAD / 4;
+    }
+    if (entry->size > maxSize)
+        return;
+
+    entry->body.reserve(poolBody->getSize());
+    const MemPool::Chunk* lastChunk = poolBody->getLastChunk();
+    for (const MemPool::Chunk* chunk = poolBody->getChunks(); chunk <= lastChunk; ++chunk)
+        entry->body.append(chunk->buffer, chunk->size);
+    entry->expires = ElapsedTimer::getTime() + static_cast<int64_t>(operation->cacheTtl) * 1000000;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // response could be cached by concurrent request
+    auto it = index.find(entry->key);
+    if (it != index.end())
+        remove(it->second);
+
+    size += entry->size;
+    entries.push_front(std::move(entry));
+    index[entries.front()->key] = entries.begin();
+
+    // evict least recently used responses
+    while (size > maxSize)
+        remove(std::prev(entries.end()));
+}
+
+bool ResponseCache::makeKey(const MessageContext* context, std::string& key) const
+{
+    const HttpRequest* request = static_cast<const HttpRequest*>(context->request);
+    if (request->method != HttpMethod::GET || !request->path)
+        return false;
+
+    key = request->path;
+    for (const std::string& name : keyHeaders) {
+        key += '\n';
+        const Header* header = request->getHeader(name.c_str());
+        if (header)
+            key += header->value;
+    }
+    return true;
+}
+
+void ResponseCache::remove(EntryList::iterator it)
+{
+    size -= (*it)->size;
+    index.erase((*it)->key);
+    entries.erase(it);
+}
+
+
+CacheFilter::CacheFilter(ResponseCache* cache_):
+    cache(cache_)
+{
+}
+
+const std::string& CacheFilter::getName() const
+{
+    static const std::string name = "cache";
+    return name;
+}
+
+const std::list<std::string>& CacheFilter::getDependencies() const
+{
+    static const std::list<std::string> deps;
+    return deps;
+}
+
+void CacheFilter::filter(Phase, MessageContext* context)
+{
+    // response could be prepared by another filter
+    if (!context->response->handled)
+        cache->get(context);
+}
+
+
+CacheStoreFilter::CacheStoreFilter(ResponseCache* cache_):
+    cache(cache_)
+{
+}
+
+const std::string& CacheStoreFilter::getName() const
+{
+    static const std::string name = "cacheStore";
+    return name;
+}
+
+const std::list<std::string>& CacheStoreFilter::getDependencies() const
+{
+    static const std::list<std::string> deps;
+    return deps;
+}
+
+void CacheStoreFilter::filter(Phase, MessageContext* context)
+{
+    cache->put(context);
+}
+
+}
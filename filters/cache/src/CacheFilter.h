@@ -0,0 +1,127 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_CACHEFILTER_H
+#define NGREST_CACHEFILTER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <mutex>
+
+#include <ngrest/engine/Filter.h>
+
+namespace ngrest {
+
+/**
+ * @brief in-memory LRU cache of responses to GET requests
+ *
+ * Responses are cached only for operations which have *cacheTtl option set (in seconds).
+ * Cache key is path of request with query and values of Accept-Encoding and other selected headers.
+ * Responses with status other than 200, with Set-Cookie header and streamed responses are not cached.
+ * Cached entries are immutable and shared with responses, so they are sent without copying.
+ *
+ * Environment variables:
+ *   NGREST_CACHE_MAX_SIZE - maximum memory used by cached responses, default is 64 Mb
+ *   NGREST_CACHE_KEY_HEADERS - comma separated list of request headers to add to cache key
+ */
+class ResponseCache
+{
+public:
+    ResponseCache();
+
+    /**
+     * @brief write cached response to message
+     * @param context message context
+     * @return true if response is found in cache and written
+     */
+    bool get(MessageContext* context);
+
+    /**
+     * @brief put response to cache if operation allows that
+     *
+     * Only responses to requests missed by get() are cached.
+     * @param context message context
+     */
+    void put(MessageContext* context);
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::string body;
+        std::vector<std::pair<std::string, std::string>> headers;
+        int64_t expires;
+        uint64_t size;
+    };
+
+    typedef std::shared_ptr<const Entry> EntryPtr;
+    typedef std::list<EntryPtr> EntryList;
+
+    bool makeKey(const MessageContext* context, std::string& key) const;
+    void remove(EntryList::iterator it);
+
+private:
+    std::mutex mutex;
+    EntryList entries; // most recently used first
+    std::unordered_map<std::string, EntryList::iterator> index;
+    std::vector<std::string> keyHeaders;
+    uint64_t maxSize;
+    uint64_t size = 0;
+};
+
+/**
+ * @brief responds to request with cached response, so the request is not dispatched
+ */
+class CacheFilter: public Filter
+{
+public:
+    CacheFilter(ResponseCache* cache);
+
+    const std::string& getName() const override;
+    const std::list<std::string>& getDependencies() const override;
+    void filter(Phase phase, MessageContext* context) override;
+
+private:
+    ResponseCache* cache;
+};
+
+/**
+ * @brief puts response into the cache before it's sent
+ */
+class CacheStoreFilter: public Filter
+{
+public:
+    CacheStoreFilter(ResponseCache* cache);
+
+    const std::string& getName() const override;
+    const std::list<std::string>& getDependencies() const override;
+    void filter(Phase phase, MessageContext* context) override;
+
+private:
+    ResponseCache* cache;
+};
+
+}
+
+#endif // NGREST_CACHEFILTER_H
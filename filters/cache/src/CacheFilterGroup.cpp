@@ -0,0 +1,60 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <ngrest/utils/PluginExport.h>
+#include <ngrest/engine/Phase.h>
+
+#include "CacheFilter.h"
+#include "CacheFilterGroup.h"
+
+NGREST_DECLARE_PLUGIN(::ngrest::CacheFilterGroup)
+
+namespace ngrest {
+
+CacheFilterGroup::CacheFilterGroup():
+  cache(new ResponseCache()),
+  filters({
+      {Phase::PreDispatch, {new CacheFilter(cache)}},
+      {Phase::PreSend, {new CacheStoreFilter(cache)}},
+  })
+{
+}
+
+CacheFilterGroup::~CacheFilterGroup()
+{
+    for (auto it : filters)
+        for (Filter* filter : it.second)
+            delete filter;
+    filters.clear();
+    delete cache;
+}
+
+const std::string& CacheFilterGroup::getName() const
+{
+    static const std::string name = "CacheFilterGroup";
+    return name;
+}
+
+const FiltersMap& CacheFilterGroup::getFilters() const
+{
+    return filters;
+}
+
+}
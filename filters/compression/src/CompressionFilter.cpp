@@ -0,0 +1,486 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <zlib.h>
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#endif
+
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/Log.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/utils/fromcstring.h>
+#include <ngrest/common/Message.h>
+#include <ngrest/common/HttpMessage.h>
+#include <ngrest/common/HttpException.h>
+#include <ngrest/engine/Phase.h>
+
+#include "CompressionFilter.h"
+
+#define CODEC_BLOCK_SIZE 16384
+#define CODEC_MIN_BLOCK_SIZE 1024 // minimum free space in chunk to use for codec output
+#define DEFAULT_MIN_SIZE 1024
+#define MAX_DECOMPRESSED_SIZE 10485760 // 10 Mb, same as maximum request size
+
+namespace ngrest {
+
+// in order of preference
+enum class Encoding
+{
+    Unknown,
+    Identity,
+    Deflate,
+    Gzip,
+    Zstd
+};
+
+/**
+ * @brief compressor and decompressor state, created once per thread and reused between messages
+ */
+class CodecState
+{
+public:
+    MemPool pool; // output of compressor/decompressor, exchanged with message body
+
+    CodecState():
+        pool(CODEC_BLOCK_SIZE)
+    {
+    }
+
+    ~CodecState()
+    {
+        for (int i = 0; i < 2; ++i) {
+            if (deflaterReady[i])
+                deflateEnd(&deflaters[i]);
+        }
+        if (inflaterReady)
+            inflateEnd(&inflater);
+#ifdef HAS_ZSTD
+        ZSTD_freeCCtx(zstdCompressor);
+        ZSTD_freeDCtx(zstdDecompressor);
+#endif
+    }
+
+    z_stream* getDeflater(Encoding encoding, int level)
+    {
+        const int index = (encoding == Encoding::Gzip) ? 0 : 1;
+        z_stream* stream = &deflaters[index];
+        if (!deflaterReady[index]) {
+            memset(stream, 0, sizeof(z_stream));
+            // windowBits: 15 - zlib format, 15 + 16 - gzip format
+            NGREST_ASSERT(deflateInit2(stream, (level > Z_BEST_COMPRESSION) ? Z_BEST_COMPRESSION : level,
+                                       Z_DEFLATED, index ? 15 : (15 + 16), 8, Z_DEFAULT_STRATEGY) == Z_OK,
+                          "Failed to init compressor");
+            deflaterReady[index] = true;
+        } else {
+            deflateReset(stream);
+        }
+        return stream;
+    }
+
+    z_stream* getInflater()
+    {
+        if (!inflaterReady) {
+            memset(&inflater, 0, sizeof(z_stream));
+            // windowBits: 15 + 32 - detect zlib or gzip format by header
+            NGREST_ASSERT(inflateInit2(&inflater, 15 + 32) == Z_OK, "Failed to init decompressor");
+            inflaterReady = true;
+        } else {
+            inflateReset(&inflater);
+        }
+        return &inflater;
+    }
+
+#ifdef HAS_ZSTD
+    ZSTD_CCtx* getZstdCompressor(int level)
+    {
+        if (!zstdCompressor) {
+            zstdCompressor = ZSTD_createCCtx();
+            NGREST_ASSERT(zstdCompressor, "Failed to init zstd compressor");
+            ZSTD_CCtx_setParameter(zstdCompressor, ZSTD_c_compressionLevel,
+                                   (level < 0) ? ZSTD_CLEVEL_DEFAULT : level);
+        } else {
+            ZSTD_CCtx_reset(zstdCompressor, ZSTD_reset_session_only);
+        }
+        return zstdCompressor;
+    }
+
+    ZSTD_DCtx* getZstdDecompressor()
+    {
+        if (!zstdDecompressor) {
+            zstdDecompressor = ZSTD_createDCtx();
+            NGREST_ASSERT(zstdDecompressor, "Failed to init zstd decompressor");
+        } else {
+            ZSTD_DCtx_reset(zstdDecompressor, ZSTD_reset_session_only);
+        }
+        return zstdDecompressor;
+    }
+#endif
+
+private:
+    z_stream deflaters[2]; // gzip, deflate
+    bool deflaterReady[2] = {false, false};
+    z_stream inflater;
+    bool inflaterReady = false;
+#ifdef HAS_ZSTD
+    ZSTD_CCtx* zstdCompressor = nullptr;
+    ZSTD_DCtx* zstdDecompressor = nullptr;
+#endif
+};
+
+static thread_local CodecState codecState;
+
+
+inline bool isSupported(Encoding encoding)
+{
+#ifdef HAS_ZSTD
+    return encoding >= Encoding::Deflate;
+#else
+    return encoding == Encoding::Deflate || encoding == Encoding::Gzip;
+#endif
+}
+
+Encoding parseEncoding(const char* name, uint64_t size)
+{
+    switch (size) {
+    case 1:
+        return (*name == '*') ? Encoding::Gzip : Encoding::Unknown;
+    case 4:
+        if (!strncasecmp(name, "gzip", 4))
+            return Encoding::Gzip;
+        if (!strncasecmp(name, "zstd", 4))
+            return Encoding::Zstd;
+        break;
+    case 6:
+        if (!strncasecmp(name, "x-gzip", 6))
+            return Encoding::Gzip;
+        break;
+    case 7:
+        if (!strncasecmp(name, "deflate", 7))
+            return Encoding::Deflate;
+        break;
+    case 8:
+        if (!strncasecmp(name, "identity", 8))
+            return Encoding::Identity;
+        break;
+    }
+    return Encoding::Unknown;
+}
+
+// select the best content coding from Accept-Encoding: gzip;q=1.0, deflate;q=0.5, *;q=0
+Encoding selectEncoding(const char* acceptEncoding)
+{
+    Encoding result = Encoding::Identity;
+    double resultQuality = 0;
+    const char* pos = acceptEncoding;
+    while (*pos) {
+        while (*pos == ' ' || *pos == '\t' || *pos == ',')
+            ++pos;
+        const char* name = pos;
+        while (*pos && *pos != ',' && *pos != ';' && *pos != ' ' && *pos != '\t')
+            ++pos;
+        const Encoding encoding = parseEncoding(name, pos - name);
+
+        double quality = 1;
+        while (*pos && *pos != ',') {
+            if (*pos++ != ';')
+                continue;
+            while (*pos == ' ' || *pos == '\t')
+                ++pos;
+            if ((*pos == 'q' || *pos == 'Q') && pos[1] == '=')
+                quality = strtod(pos + 2, nullptr);
+        }
+
+        if (isSupported(encoding) && quality > 0
+                && (quality > resultQuality || (quality == resultQuality && encoding > result))) {
+            result = encoding;
+            resultQuality = quality;
+        }
+    }
+    return result;
+}
+
+bool isCompressible(const HttpResponse* response)
+{
+    if (response->statusCode == HTTP_STATUS_204_NO_CONTENT
+            || response->statusCode == HTTP_STATUS_304_NOT_MODIFIED)
+        return false;
+
+    bool result = false;
+    for (const Header* header = response->headers; header; header = header->next) {
+        if (!strcasecmp(header->name, "Content-Encoding"))
+            return false;
+        if (!strcasecmp(header->name, "Content-Type")) {
+            const char* value = header->value;
+            result = !strncasecmp(value, "text/", 5) || strcasestr(value, "json")
+                    || strcasestr(value, "xml") || strcasestr(value, "javascript");
+        }
+    }
+    return result;
+}
+
+// use free space of the last chunk or allocate a new block for codec output
+inline char* growBlock(MemPool* pool, uint64_t& size)
+{
+    const MemPool::Chunk* chunk = pool->getLastChunk();
+    size = chunk ? (chunk->bufferSize - chunk->size) : 0;
+    if (size < CODEC_MIN_BLOCK_SIZE)
+        size = CODEC_BLOCK_SIZE;
+    return pool->grow(size);
+}
+
+// same as growBlock, but keeps codec output in single chunk, so decompressed body is not copied on flatten
+inline char* growContiguousBlock(MemPool* pool, uint64_t& size)
+{
+    const MemPool::Chunk* chunk = pool->getLastChunk();
+    size = chunk ? (chunk->bufferSize - chunk->size) : 0;
+    if (size < CODEC_MIN_BLOCK_SIZE)
+        size = CODEC_BLOCK_SIZE;
+    return pool->growContiguous(size);
+}
+
+uint64_t deflatePool(z_stream* stream, const MemPool* in, MemPool* out)
+{
+    const MemPool::Chunk* lastChunk = in->getLastChunk();
+    for (const MemPool::Chunk* chunk = in->getChunks(); chunk <= lastChunk; ++chunk) {
+        const int flush = (chunk == lastChunk) ? Z_FINISH : Z_NO_FLUSH;
+        stream->next_in = reinterpret_cast<Bytef*>(chunk->buffer);
+        stream->avail_in = static_cast<uInt>(chunk->size);
+        do {
+            uint64_t size;
+            stream->next_out = reinterpret_cast<Bytef*>(growBlock(out, size));
+            stream->avail_out = static_cast<uInt>(size);
+            const int res = deflate(stream, flush);
+            out->shrinkLastChunk(stream->avail_out);
+            NGREST_ASSERT(res != Z_STREAM_ERROR, "Failed to compress response");
+        } while (stream->avail_out == 0);
+    }
+    return stream->total_out;
+}
+
+void inflateBody(z_stream* stream, const char* body, uint64_t bodySize, MemPool* out)
+{
+    stream->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(body));
+    stream->avail_in = static_cast<uInt>(bodySize);
+    int res;
+    do {
+        uint64_t size;
+        stream->next_out = reinterpret_cast<Bytef*>(growContiguousBlock(out, size));
+        stream->avail_out = static_cast<uInt>(size);
+        res = inflate(stream, Z_NO_FLUSH);
+        out->shrinkLastChunk(stream->avail_out);
+        NGREST_ASSERT_HTTP(stream->total_out <= MAX_DECOMPRESSED_SIZE,
+                           HTTP_STATUS_413_REQUEST_ENTITY_TOO_LARGE, "Decompressed request is too large");
+    } while (res == Z_OK);
+    NGREST_ASSERT_HTTP(res == Z_STREAM_END, HTTP_STATUS_400_BAD_REQUEST, "Invalid compressed request body");
+}
+
+#ifdef HAS_ZSTD
+uint64_t zstdCompressPool(ZSTD_CCtx* cctx, const MemPool* in, MemPool* out)
+{
+    uint64_t total = 0;
+    const MemPool::Chunk* lastChunk = in->getLastChunk();
+    for (const MemPool::Chunk* chunk = in->getChunks(); chunk <= lastChunk; ++chunk) {
+        const bool isLast = chunk == lastChunk;
+        ZSTD_inBuffer input = {chunk->buffer, chunk->size, 0};
+        bool finished;
+        do {
+            uint64_t size;
+            char* buffer = growBlock(out, size);
+            ZSTD_outBuffer output = {buffer, size, 0};
+            const size_t remaining = ZSTD_compressStream2(cctx, &output, &input,
+                                                          isLast ? ZSTD_e_end : ZSTD_e_continue);
+            out->shrinkLastChunk(size - output.pos);
+            total += output.pos;
+            NGREST_ASSERT(!ZSTD_isError(remaining), "Failed to compress response");
+            finished = isLast ? (remaining == 0) : (input.pos == input.size);
+        } while (!finished);
+    }
+    return total;
+}
+
+void zstdDecompressBody(ZSTD_DCtx* dctx, const char* body, uint64_t bodySize, MemPool* out)
+{
+    ZSTD_inBuffer input = {body, bodySize, 0};
+    uint64_t total = 0;
+    size_t res;
+    bool full;
+    do {
+        uint64_t size;
+        char* buffer = growContiguousBlock(out, size);
+        ZSTD_outBuffer output = {buffer, size, 0};
+        res = ZSTD_decompressStream(dctx, &output, &input);
+        out->shrinkLastChunk(size - output.pos);
+        total += output.pos;
+        full = output.pos == output.size;
+        NGREST_ASSERT_HTTP(!ZSTD_isError(res), HTTP_STATUS_400_BAD_REQUEST, "Invalid compressed request body");
+        NGREST_ASSERT_HTTP(total <= MAX_DECOMPRESSED_SIZE,
+                           HTTP_STATUS_413_REQUEST_ENTITY_TOO_LARGE, "Decompressed request is too large");
+    } while (res != 0 && (input.pos < input.size || full));
+    NGREST_ASSERT_HTTP(res == 0, HTTP_STATUS_400_BAD_REQUEST, "Invalid compressed request body");
+}
+#endif
+
+
+CompressionFilter::CompressionFilter():
+    level(Z_DEFAULT_COMPRESSION), minSize(DEFAULT_MIN_SIZE)
+{
+    const char* levelStr = getenv("NGREST_COMPRESSION_LEVEL");
+    if (levelStr && !fromCString(levelStr, level))
+        LogWarning() << "Invalid NGREST_COMPRESSION_LEVEL: " << levelStr;
+
+    const char* minSizeStr = getenv("NGREST_COMPRESSION_MIN_SIZE");
+    if (minSizeStr && !fromCString(minSizeStr, minSize))
+        LogWarning() << "Invalid NGREST_COMPRESSION_MIN_SIZE: " << minSizeStr;
+}
+
+const std::string& CompressionFilter::getName() const
+{
+    static const std::string name = "compression";
+    return name;
+}
+
+const std::list<std::string>& CompressionFilter::getDependencies() const
+{
+    static const std::list<std::string> deps;
+    return deps;
+}
+
+void CompressionFilter::filter(Phase, MessageContext* context)
+{
+    HttpResponse* response = static_cast<HttpResponse*>(context->response);
+    MemPool* poolBody = response->poolBody;
+    // streamed response is sent as is
+    if (response->producer || !poolBody)
+        return;
+
+    const uint64_t size = poolBody->getSize();
+    if (!size || size < minSize || !isCompressible(response))
+        return;
+
+    // response depends on Accept-Encoding whether it was compressed or not
+    response->headers = context->pool->alloc<Header>("Vary", "Accept-Encoding", response->headers);
+
+    const Header* acceptEncoding = context->request->getHeader("accept-encoding");
+    if (!acceptEncoding)
+        return;
+
+    const Encoding encoding = selectEncoding(acceptEncoding->value);
+    if (encoding == Encoding::Identity)
+        return;
+
+    CodecState& state = codecState;
+    state.pool.reset();
+
+    uint64_t compressedSize;
+    const char* encodingName;
+#ifdef HAS_ZSTD
+    if (encoding == Encoding::Zstd) {
+        compressedSize = zstdCompressPool(state.getZstdCompressor(level), poolBody, &state.pool);
+        encodingName = "zstd";
+    } else
+#endif
+    {
+        compressedSize = deflatePool(state.getDeflater(encoding, level), poolBody, &state.pool);
+        encodingName = (encoding == Encoding::Gzip) ? "gzip" : "deflate";
+    }
+
+    // incompressible data
+    if (compressedSize >= size)
+        return;
+
+    // compressed body goes to response, uncompressed chunks are kept for reuse
+    poolBody->swap(state.pool);
+    response->headers = context->pool->alloc<Header>("Content-Encoding", encodingName, response->headers);
+}
+
+
+const std::string& DecompressionFilter::getName() const
+{
+    static const std::string name = "decompression";
+    return name;
+}
+
+const std::list<std::string>& DecompressionFilter::getDependencies() const
+{
+    static const std::list<std::string> deps;
+    return deps;
+}
+
+void DecompressionFilter::filter(Phase, MessageContext* context)
+{
+    Request* request = context->request;
+    if (!request->body)
+        return;
+
+    Header* contentEncoding = nullptr;
+    for (Header** header = &request->headers; *header; header = &(*header)->next) {
+        if (!strcmp((*header)->name, "content-encoding")) {
+            contentEncoding = *header;
+            // request body will not be encoded anymore
+            *header = contentEncoding->next;
+            break;
+        }
+    }
+
+    if (!contentEncoding)
+        return;
+
+    const Encoding encoding = parseEncoding(contentEncoding->value, strlen(contentEncoding->value));
+    if (encoding == Encoding::Identity)
+        return;
+
+    NGREST_ASSERT_HTTP(isSupported(encoding), HTTP_STATUS_415_UNSUPPORTED_MEDIA_TYPE,
+                       "Unsupported request Content-Encoding");
+
+    CodecState& state = codecState;
+    state.pool.reset();
+
+#ifdef HAS_ZSTD
+    if (encoding == Encoding::Zstd)
+        zstdDecompressBody(state.getZstdDecompressor(), request->body, request->bodySize, &state.pool);
+    else
+#endif
+        inflateBody(state.getInflater(), request->body, request->bodySize, &state.pool);
+
+    if (request->poolBody) {
+        // large body: decompressed chunks go to the body pool, compressed chunks are kept for reuse
+        request->poolBody->swap(state.pool);
+        MemPool::Chunk* chunk = request->poolBody->flatten();
+        request->body = chunk->buffer;
+        request->bodySize = chunk->size;
+    } else {
+        // small body: copy into message pool
+        const uint64_t size = state.pool.getSize();
+        char* body = context->pool->grow(size + 1);
+        request->body = body;
+        request->bodySize = size;
+        for (const MemPool::Chunk& chunk : state.pool.getSegments()) {
+            memcpy(body, chunk.buffer, chunk.size);
+            body += chunk.size;
+        }
+        *body = '\0';
+    }
+}
+
+}
@@ -0,0 +1,70 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_COMPRESSIONFILTER_H
+#define NGREST_COMPRESSIONFILTER_H
+
+#include <stdint.h>
+
+#include <ngrest/engine/Filter.h>
+
+namespace ngrest {
+
+/**
+ * @brief compresses response body according to client's Accept-Encoding
+ *
+ * Supported content codings are gzip, deflate and zstd (if compiled with zstd).
+ * Body is compressed chunk by chunk into thread-local memory pool which then replaces response body.
+ * Streamed responses, responses which already have Content-Encoding and responses with
+ * content type other than text, JSON, XML or JavaScript are sent as is.
+ *
+ * Environment variables:
+ *   NGREST_COMPRESSION_LEVEL - compression level, default is zlib default level (6)
+ *   NGREST_COMPRESSION_MIN_SIZE - minimum size of response body to compress, default is 1024 bytes
+ */
+class CompressionFilter: public Filter
+{
+public:
+    CompressionFilter();
+
+    const std::string& getName() const override;
+    const std::list<std::string>& getDependencies() const override;
+    void filter(Phase phase, MessageContext* context) override;
+
+private:
+    int level;
+    uint64_t minSize;
+};
+
+/**
+ * @brief decompresses request body with Content-Encoding gzip, deflate or zstd (if compiled with zstd)
+ * before the request is parsed
+ */
+class DecompressionFilter: public Filter
+{
+public:
+    const std::string& getName() const override;
+    const std::list<std::string>& getDependencies() const override;
+    void filter(Phase phase, MessageContext* context) override;
+};
+
+}
+
+#endif // NGREST_COMPRESSIONFILTER_H
@@ -0,0 +1,262 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include <ngrest/utils/Log.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/common/Message.h>
+#include <ngrest/common/HttpMessage.h>
+#include <ngrest/common/Service.h>
+#include <ngrest/engine/Engine.h>
+#include <ngrest/engine/ServiceDispatcher.h>
+#include <ngrest/engine/ServiceDescription.h>
+#include <ngrest/engine/ServiceWrapper.h>
+#include <ngrest/engine/Transport.h>
+#include <ngrest/engine/Phase.h>
+
+#include "EtagFilter.h"
+
+namespace ngrest {
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+inline uint64_t rotl(uint64_t value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * @brief single lane variant of xxHash64, fed by chunks of memory pool
+ */
+class BodyHash
+{
+public:
+    void update(const char* data, uint64_t size)
+    {
+        total += size;
+
+        // complete the word started in previous chunk
+        for (; tailSize && size; --size)
+            putTailByte(*data++);
+
+        for (; size >= 8; size -= 8, data += 8) {
+            uint64_t word;
+            memcpy(&word, data, 8);
+            round(word);
+        }
+
+        for (; size; --size)
+            putTailByte(*data++);
+    }
+
+    uint64_t final()
+    {
+        if (tailSize) {
+            hash ^= tail * PRIME5;
+            hash = rotl(hash, 11) * PRIME1;
+        }
+        hash += total;
+
+        hash ^= hash >> 33;
+        hash *= PRIME2;
+        hash ^= hash >> 29;
+        hash *= PRIME3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+private:
+    inline void round(uint64_t word)
+    {
+        hash ^= rotl(word * PRIME2, 31) * PRIME1;
+        hash = rotl(hash, 27) * PRIME1 + PRIME4;
+    }
+
+    inline void putTailByte(char ch)
+    {
+        tail |= static_cast<uint64_t>(static_cast<unsigned char>(ch)) << (tailSize * 8);
+        if (++tailSize == 8) {
+            round(tail);
+            tail = 0;
+            tailSize = 0;
+        }
+    }
+
+private:
+    uint64_t hash = PRIME5;
+    uint64_t total = 0;
+    uint64_t tail = 0;
+    int tailSize = 0;
+};
+
+static const Header* findHeader(const Header* header, const char* name)
+{
+    for (; header; header = header->next)
+        if (!strcasecmp(header->name, name))
+            return header;
+    return nullptr;
+}
+
+// weak comparison of entity tag against the list of If-None-Match header
+static bool matchEtag(const char* ifNoneMatch, const char* etag)
+{
+    if (!strncmp(etag, "W/", 2))
+        etag += 2;
+    const size_t etagSize = strlen(etag);
+
+    const char* curr = ifNoneMatch;
+    for (;;) {
+        while (*curr == ' ' || *curr == '\t' || *curr == ',')
+            ++curr;
+        if (!*curr)
+            return false;
+        if (*curr == '*')
+            return true;
+        if (!strncmp(curr, "W/", 2))
+            curr += 2;
+
+        const char* end = curr;
+        if (*end == '"') {
+            end = strchr(end + 1, '"');
+            if (!end)
+                return false;
+            ++end;
+        } else {
+            // malformed tag: skip it
+            while (*end && *end != ',')
+                ++end;
+        }
+
+        if (static_cast<size_t>(end - curr) == etagSize && !strncmp(curr, etag, etagSize))
+            return true;
+        curr = end;
+    }
+}
+
+static void setNotModified(HttpResponse* response)
+{
+    response->statusCode = HTTP_STATUS_304_NOT_MODIFIED;
+    response->poolBody->reset();
+}
+
+
+const std::string& EtagVersionFilter::getName() const
+{
+    static const std::string name = "etagVersion";
+    return name;
+}
+
+const std::list<std::string>& EtagVersionFilter::getDependencies() const
+{
+    static const std::list<std::string> deps;
+    return deps;
+}
+
+void EtagVersionFilter::filter(Phase, MessageContext* context)
+{
+    const HttpRequest* request = static_cast<const HttpRequest*>(context->request);
+    HttpResponse* response = static_cast<HttpResponse*>(context->response);
+    // response could be prepared by another filter
+    if (request->method != HttpMethod::GET || response->handled)
+        return;
+
+    ServiceWrapper* wrapper = nullptr;
+    const OperationDescription* operation = context->engine->getServiceDispatcher()
+            .findOperation(request->path, context->transport->getRequestMethod(request), &wrapper);
+    if (!operation)
+        return;
+
+    const char* tag = wrapper->getServiceImpl()->getVersionTag(operation->name, context);
+    if (!tag)
+        return;
+
+    // W/"tag"
+    const size_t tagSize = strlen(tag);
+    char* etag = context->pool->grow(tagSize + 5);
+    memcpy(etag, "W/\"", 3);
+    memcpy(etag + 3, tag, tagSize);
+    memcpy(etag + 3 + tagSize, "\"", 2);
+    response->headers = context->pool->alloc<Header>("ETag", etag, response->headers);
+
+    const Header* ifNoneMatch = request->getHeader("if-none-match");
+    if (ifNoneMatch && matchEtag(ifNoneMatch->value, etag)) {
+        LogDebug() << "Resource " << request->path << " is not modified, operation is not invoked";
+        setNotModified(response);
+        response->handled = true;
+    }
+}
+
+
+const std::string& EtagFilter::getName() const
+{
+    static const std::string name = "etag";
+    return name;
+}
+
+const std::list<std::string>& EtagFilter::getDependencies() const
+{
+    static const std::list<std::string> deps;
+    return deps;
+}
+
+void EtagFilter::filter(Phase, MessageContext* context)
+{
+    const HttpRequest* request = static_cast<const HttpRequest*>(context->request);
+    HttpResponse* response = static_cast<HttpResponse*>(context->response);
+    if (request->method != HttpMethod::GET || response->producer || !response->poolBody
+            || (response->statusCode != HTTP_STATUS_UNDEFINED && response->statusCode != HTTP_STATUS_200_OK))
+        return;
+
+    const char* etag;
+    const Header* etagHeader = findHeader(response->headers, "etag");
+    if (etagHeader) {
+        // set from version tag or by service
+        etag = etagHeader->value;
+    } else {
+        const MemPool* poolBody = response->poolBody;
+        if (!poolBody->getSize())
+            return;
+
+        BodyHash hash;
+        const MemPool::Chunk* lastChunk = poolBody->getLastChunk();
+        for (const MemPool::Chunk* chunk = poolBody->getChunks(); chunk <= lastChunk; ++chunk)
+            hash.update(chunk->buffer, chunk->size);
+
+        // weak, as body may be compressed or not depending on order of filters
+        const int etagSize = 24;
+        char* etagBuff = context->pool->grow(etagSize);
+        snprintf(etagBuff, etagSize, "W/\"%016llx\"", static_cast<unsigned long long>(hash.final()));
+        etag = etagBuff;
+        response->headers = context->pool->alloc<Header>("ETag", etag, response->headers);
+    }
+
+    const Header* ifNoneMatch = request->getHeader("if-none-match");
+    if (ifNoneMatch && matchEtag(ifNoneMatch->value, etag))
+        setNotModified(response);
+}
+
+}
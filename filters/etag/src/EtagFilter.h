@@ -0,0 +1,57 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#ifndef NGREST_ETAGFILTER_H
+#define NGREST_ETAGFILTER_H
+
+#include <ngrest/engine/Filter.h>
+
+namespace ngrest {
+
+/**
+ * @brief answers conditional GET request with 304 Not Modified before the operation is invoked,
+ * if service provides version tag of the resource (see Service::getVersionTag)
+ */
+class EtagVersionFilter: public Filter
+{
+public:
+    const std::string& getName() const override;
+    const std::list<std::string>& getDependencies() const override;
+    void filter(Phase phase, MessageContext* context) override;
+};
+
+/**
+ * @brief sets ETag of response to GET request and answers If-None-Match with 304 Not Modified
+ *
+ * Weak ETag is generated by fast non-cryptographic hash of response body
+ * unless it's already set from version tag of resource or by service.
+ * Streamed responses and responses with status other than 200 are sent as is.
+ */
+class EtagFilter: public Filter
+{
+public:
+    const std::string& getName() const override;
+    const std::list<std::string>& getDependencies() const override;
+    void filter(Phase phase, MessageContext* context) override;
+};
+
+}
+
+#endif // NGREST_ETAGFILTER_H
@@ -28,7 +28,7 @@
 #include <ngrest/utils/Exception.h>
 #include <ngrest/utils/Log.h>
 #include <ngrest/utils/MemPool.h>
-#include <ngrest/utils/MemPooler.h>
+#include <ngrest/utils/SharedMemPooler.h>
 #include <ngrest/utils/tocstring.h>
 #include <ngrest/engine/Phase.h>
 #include <ngrest/engine/Engine.h>
@@ -48,7 +48,8 @@ static ngrest::FilterDispatcher filterDispatcher;
 static ngrest::FilterDeployment filterDeployment(filterDispatcher);
 static ngrest::HttpTransport transport;
 static ngrest::Engine engine(dispatcher);
-static ngrest::MemPooler pooler;
+// pools are obtained and recycled by web server worker threads
+static ngrest::SharedMemPooler& pooler = ngrest::SharedMemPooler::inst();
 static std::string deployedServicesPath;
 static std::string deployedFiltersPath;
 static std::ofstream logstream;
@@ -271,10 +272,10 @@ int ngrest_server_dispatch(ngrest_server_request* request, ngrest_mod_callbacks
                     buffer += read;
                 }
             } else {
-                // body size is unknown
+                // body size is unknown, read it into single chunk so it's not copied on flatten
                 const int64_t chunkSize = poolRequest->getChunkSize();
                 int64_t bufferSize = chunkSize;
-                char* buffer = poolRequest->grow(chunkSize);
+                char* buffer = poolRequest->growContiguous(chunkSize);
                 for (;;) {
                     int64_t read = callbacks.read_block(request->req, buffer, bufferSize);
                     NGREST_ASSERT(read <= bufferSize, "read > buffer size");
@@ -289,7 +290,7 @@ int ngrest_server_dispatch(ngrest_server_request* request, ngrest_mod_callbacks
                     bufferSize -= read;
                     buffer += read;
                     if (bufferSize == 0) {
-                        buffer = poolRequest->grow(chunkSize);
+                        buffer = poolRequest->growContiguous(chunkSize);
                         bufferSize = chunkSize;
                     }
                 }
@@ -22,6 +22,9 @@
 
 #include <ngrest/utils/Log.h>
 #include <ngrest/utils/stringutils.h>
+#include <ngrest/utils/tostring.h>
+#include <ngrest/utils/MemPooler.h>
+#include <ngrest/utils/SharedMemPooler.h>
 #include <ngrest/common/HttpMessage.h>
 #include <ngrest/common/HttpException.h>
 #include <ngrest/engine/Transport.h>
@@ -187,6 +190,29 @@ const char* paramTypeToString(ParameterDescription::Type type)
     }
 }
 
+void writeMemPoolerStats(MemPool* pool, const char* indexTitle, const std::vector<MemPoolerStats>& stats)
+{
+    pool->putCString("<table border=\"1\" cellspacing=\"0\" cellpadding=\"4\"><tr><th>");
+    pool->putCString(indexTitle);
+    pool->putCString("</th><th>obtained</th><th>recycled</th><th>created</th><th>deleted</th><th>shrunk</th>"
+                     "<th>depot gets</th><th>depot puts</th><th>unused pools</th><th>unused bytes</th>"
+                     "<th>peak unused bytes</th><th>limit bytes</th></tr>");
+    for (const MemPoolerStats& item : stats) {
+        const uint64_t values[] = {
+            item.index, item.obtained, item.recycled, item.created, item.deleted, item.shrunk,
+            item.depotGets, item.depotPuts, item.unusedCount, item.unusedSize, item.unusedPeak, item.unusedLimit
+        };
+        pool->putCString("<tr>");
+        for (uint64_t value : values) {
+            pool->putCString("<td>");
+            pool->putCString(toString(value).c_str());
+            pool->putCString("</td>");
+        }
+        pool->putCString("</tr>");
+    }
+    pool->putCString("</table>");
+}
+
 void ServerStatus::getFilters(MessageContext& context)
 {
     NGREST_ASSERT_HTTP(context.transport->getType() == Transport::Type::Http,
@@ -206,6 +232,7 @@ void ServerStatus::getFilters(MessageContext& context)
     pool->putCString("</style></head><body>"
                      "<h1>ngrest</h1>&nbsp;<a href='/ngrest/services'>services</a>"
                      "&nbsp;&nbsp;<a href='/ngrest/filters'>filters</a>"
+                     "&nbsp;&nbsp;<a href='/ngrest/memory'>memory</a>"
                     "<h2>Deployed filters:</h2>");
     FilterDispatcher* filterDispatcher = context.engine->getFilterDispatcher();
     if (filterDispatcher) {
@@ -260,6 +287,7 @@ void ServerStatus::getServices(MessageContext& context)
     pool->putCString("</style></head><body>"
                      "<h1>ngrest</h1>&nbsp;<a href='/ngrest/services'>services</a>"
                      "&nbsp;&nbsp;<a href='/ngrest/filters'>filters</a>"
+                     "&nbsp;&nbsp;<a href='/ngrest/memory'>memory</a>"
                      "<h2>Deployed services:</h2>");
     const std::vector<ServiceWrapper*>& services = context.engine->getServiceDispatcher().getServices();
     for (const ServiceWrapper* service : services) {
@@ -537,4 +565,46 @@ void ServerStatus::getOperation(const std::string& serviceName, const std::strin
     pool->putCString(templ.c_str());
 }
 
+void ServerStatus::getMemory(MessageContext& context)
+{
+    NGREST_ASSERT_HTTP(context.transport->getType() == Transport::Type::Http,
+                       HTTP_STATUS_501_NOT_IMPLEMENTED,
+                       "This service only supports HTTP transport");
+
+    HttpResponse* response = static_cast<HttpResponse*>(context.response);
+    Header* headerContentType = context.pool->alloc<Header>("Content-Type", "text/html");
+    response->headers = headerContentType;
+
+    MemPool* pool = context.response->poolBody;
+
+    pool->putCString("<html><head>"
+                    "<title>Memory pools - ngrest</title>"
+                    "<style>");
+    pool->putCString(css);
+    pool->putCString("</style></head><body>"
+                     "<h1>ngrest</h1>&nbsp;<a href='/ngrest/services'>services</a>"
+                     "&nbsp;&nbsp;<a href='/ngrest/filters'>filters</a>"
+                     "&nbsp;&nbsp;<a href='/ngrest/memory'>memory</a>"
+                     "<h2>Memory poolers:</h2>");
+
+    std::vector<MemPoolerStats> stats;
+    MemPooler::getAllStats(stats);
+    if (!stats.empty()) {
+        writeMemPoolerStats(pool, "pooler", stats);
+    } else {
+        pool->putCString("<span class=\"nocontent\">No memory poolers</span>");
+    }
+
+    pool->putCString("<h2>Shared memory pooler:</h2>");
+    SharedMemPooler::inst().getStats(stats);
+    if (stats.size() > 1 || stats.front().obtained) {
+        pool->putCString("<p>thread 0 is the depot and the threads exited</p>");
+        writeMemPoolerStats(pool, "thread", stats);
+    } else {
+        pool->putCString("<span class=\"nocontent\">Shared memory pooler is not used</span>");
+    }
+
+    pool->putCString("</body></html>");
+}
+
 }
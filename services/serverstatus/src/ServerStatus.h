@@ -43,6 +43,9 @@ public:
 
     // *location: operation/{serviceName}/{operationName}
     void getOperation(const std::string& serviceName, const std::string& operationName, MessageContext& context);
+
+    // *location: memory
+    void getMemory(MessageContext& context);
 };
 
 }
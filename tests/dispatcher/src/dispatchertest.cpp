@@ -0,0 +1,258 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <string.h>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/common/Message.h>
+#include <ngrest/common/HttpException.h>
+#include <ngrest/engine/Looper.h>
+#include <ngrest/engine/Transport.h>
+#include <ngrest/engine/ServiceWrapper.h>
+#include <ngrest/engine/ServiceDescription.h>
+#include <ngrest/engine/ServiceDispatcher.h>
+
+namespace {
+
+// collects posted tasks to run them from the test thread
+class TestLooper: public ngrest::Looper
+{
+public:
+    void post(ngrest::Task task) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(task);
+    }
+
+    void run()
+    {
+        std::vector<ngrest::Task> currTasks;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currTasks.swap(tasks);
+        }
+        for (ngrest::Task& task : currTasks)
+            task();
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<ngrest::Task> tasks;
+};
+
+class TestTransport: public ngrest::Transport
+{
+public:
+    TestTransport():
+        Transport(Type::User)
+    {
+    }
+
+    ngrest::Node* parseRequest(ngrest::MemPool*, ngrest::Request*) override
+    {
+        return nullptr;
+    }
+
+    void writeResponse(ngrest::MemPool*, const ngrest::Request*, ngrest::Response*) override
+    {
+    }
+
+    int getRequestMethod(const ngrest::Request*) override
+    {
+        return 1;
+    }
+};
+
+// operation completes when the test calls context's callback
+class TestWrapper: public ngrest::ServiceWrapper
+{
+public:
+    TestWrapper()
+    {
+        ngrest::OperationDescription operation;
+        operation.name = "get";
+        operation.method = 1;
+        operation.methodStr = "GET";
+        operation.asynchronous = true;
+        operation.result = ngrest::ParameterDescription::Type::String;
+        operation.resultNullable = false;
+        operation.cacheTtl = 0;
+        operation.coalesce = true;
+        description.name = "test";
+        description.operations.push_back(operation);
+    }
+
+    ngrest::Service* getServiceImpl() override
+    {
+        return nullptr;
+    }
+
+    void invoke(const ngrest::OperationDescription*, ngrest::MessageContext* context) override
+    {
+        invoked.push_back(context);
+    }
+
+    const ngrest::ServiceDescription* getDescription() const override
+    {
+        return &description;
+    }
+
+    std::vector<ngrest::MessageContext*> invoked;
+
+private:
+    ngrest::ServiceDescription description;
+};
+
+class TestCallback: public ngrest::MessageCallback
+{
+public:
+    void success() override
+    {
+        ++successCount;
+    }
+
+    void error(const ngrest::Exception& error) override
+    {
+        ++errorCount;
+        const ngrest::HttpException* httpError = dynamic_cast<const ngrest::HttpException*>(&error);
+        status = httpError ? httpError->getHttpStatus() : ngrest::HTTP_STATUS_500_INTERNAL_SERVER_ERROR;
+    }
+
+    int successCount = 0;
+    int errorCount = 0;
+    ngrest::HttpStatus status = ngrest::HTTP_STATUS_UNDEFINED;
+};
+
+struct TestMessage
+{
+    TestMessage(TestTransport* transport):
+        poolBody(1024)
+    {
+        request.path = "/test/get";
+        response.poolBody = &poolBody;
+        context.transport = transport;
+        context.request = &request;
+        context.response = &response;
+        context.callback = &callback;
+        context.pool = &pool;
+    }
+
+    ngrest::Request request;
+    ngrest::Response response;
+    ngrest::MemPool pool;
+    ngrest::MemPool poolBody;
+    TestCallback callback;
+    ngrest::MessageContext context;
+};
+
+} // namespace
+
+int main()
+{
+    TestTransport transport;
+    TestWrapper wrapper;
+    ngrest::ServiceDispatcher dispatcher;
+    dispatcher.registerService(&wrapper);
+
+    // without event loop response is expected to be ready when dispatching returns
+    try {
+        std::cout << "Coalescing without looper test" << std::endl;
+        TestMessage leader(&transport);
+        TestMessage follower(&transport);
+        dispatcher.dispatchMessage(&leader.context);
+        dispatcher.dispatchMessage(&follower.context);
+        NGREST_ASSERT(wrapper.invoked.size() == 2, "Requests must not be coalesced without looper");
+        NGREST_ASSERT(leader.context.callback == &leader.callback
+                      && follower.context.callback == &follower.callback, "Callbacks must not be replaced");
+        wrapper.invoked.clear();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    TestLooper looper;
+    ngrest::Looper::setCurrentLooper(&looper);
+
+    // response of the leader is copied to the follower on the looper's thread
+    try {
+        std::cout << "Coalescing success test" << std::endl;
+        TestMessage leader(&transport);
+        TestMessage follower(&transport);
+        dispatcher.dispatchMessage(&leader.context);
+        dispatcher.dispatchMessage(&follower.context);
+        NGREST_ASSERT(wrapper.invoked.size() == 1, "Requests must be coalesced");
+        leader.poolBody.putCString("result");
+
+        ngrest::MessageCallback* callback = leader.context.callback;
+        std::thread([callback] {
+            callback->success();
+        }).join();
+        NGREST_ASSERT(!leader.callback.successCount && !follower.callback.successCount,
+                      "Callbacks must be called from the looper");
+
+        looper.run();
+        NGREST_ASSERT(leader.callback.successCount == 1 && follower.callback.successCount == 1,
+                      "Callbacks must be called once");
+        NGREST_ASSERT(follower.poolBody.getSize() == 6 && !memcmp(follower.poolBody.getChunks()->buffer, "result", 6),
+                      "Response body must be shared");
+        wrapper.invoked.clear();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // error passed by service from its own thread is not thrown and must keep its status
+    try {
+        std::cout << "Coalescing error test" << std::endl;
+        TestMessage leader(&transport);
+        TestMessage follower(&transport);
+        dispatcher.dispatchMessage(&leader.context);
+        dispatcher.dispatchMessage(&follower.context);
+        NGREST_ASSERT(wrapper.invoked.size() == 1, "Requests must be coalesced");
+
+        ngrest::MessageCallback* callback = leader.context.callback;
+        std::thread([callback] {
+            callback->error(ngrest::HttpException(NGREST_FILE_LINE, __FUNCTION__, "Not found",
+                                                  ngrest::HTTP_STATUS_404_NOT_FOUND));
+        }).join();
+
+        looper.run();
+        NGREST_ASSERT(leader.callback.errorCount == 1 && follower.callback.errorCount == 1,
+                      "Callbacks must be called once");
+        NGREST_ASSERT(leader.callback.status == ngrest::HTTP_STATUS_404_NOT_FOUND
+                      && follower.callback.status == ngrest::HTTP_STATUS_404_NOT_FOUND,
+                      "HTTP status must be kept");
+        wrapper.invoked.clear();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    ngrest::Looper::setCurrentLooper(nullptr);
+    dispatcher.unregisterService(&wrapper);
+
+    std::cout << "All dispatcher tests passed" << std::endl;
+    return 0;
+}
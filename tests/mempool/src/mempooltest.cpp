@@ -0,0 +1,154 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/MemPool.h>
+#include <ngrest/utils/MemPoolAllocator.h>
+
+int main()
+{
+    // alignment test: odd-sized chunks and data
+    try {
+        std::cout << "Alignment test" << std::endl;
+        const uint64_t alignments[] = {2, 4, 8, 16};
+        for (uint64_t chunkSize = 61; chunkSize <= 67; ++chunkSize) {
+            for (uint64_t alignment : alignments) {
+                for (uint64_t head = 1; head < chunkSize; ++head) {
+                    for (uint64_t size = 1; size <= chunkSize; size += 3) {
+                        ngrest::MemPool pool(chunkSize);
+                        memset(pool.grow(head), 'h', head);
+                        char* data = pool.growAligned(size, alignment);
+                        NGREST_ASSERT(!(reinterpret_cast<uintptr_t>(data) & (alignment - 1)),
+                                      "Misaligned data: chunk size " + std::to_string(chunkSize)
+                                      + ", head " + std::to_string(head) + ", size " + std::to_string(size)
+                                      + ", alignment " + std::to_string(alignment));
+                        memset(data, 'd', size);
+                        NGREST_ASSERT(pool.getChunks()->buffer[0] == 'h'
+                                      && pool.getChunks()->buffer[head - 1] == 'h', "Data corrupted");
+                    }
+                }
+            }
+        }
+
+        // chunk grown to odd size by reserve
+        ngrest::MemPool pool(64);
+        pool.grow(63);
+        pool.reserve(pool.getSize() + 9);
+        for (int i = 0; i < 100; ++i) {
+            char* data = pool.growAligned(sizeof(double), alignof(double));
+            NGREST_ASSERT(!(reinterpret_cast<uintptr_t>(data) & (alignof(double) - 1)),
+                          "Misaligned data after reserve");
+        }
+
+        std::cout << "Allocator alignment test" << std::endl;
+        ngrest::MemPool allocPool(61);
+        ngrest::MemPoolScope scope(&allocPool);
+        ngrest::pool::string str("odd");
+        ngrest::pool::vector<double> values;
+        for (int i = 0; i < 100; ++i) {
+            str += 'x';
+            values.push_back(i);
+            NGREST_ASSERT(!(reinterpret_cast<uintptr_t>(values.data()) & (alignof(double) - 1)),
+                          "Misaligned vector data");
+        }
+        for (int i = 0; i < 100; ++i)
+            NGREST_ASSERT(values[i] == i, "Vector data corrupted");
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // flatten test: chunks kept for reuse after reset must be released
+    try {
+        std::cout << "Flatten after reset test" << std::endl;
+        ngrest::MemPool pool(64);
+        for (int i = 0; i < 5; ++i)
+            memset(pool.grow(64), 'a', 64);
+        NGREST_ASSERT(pool.getChunkCount() == 5, "Unexpected number of chunks");
+
+        pool.reset();
+        for (int i = 0; i < 3; ++i)
+            memset(pool.grow(32), '0' + i, 32);
+
+        const ngrest::MemPool::Chunk* chunk = pool.flatten();
+        NGREST_ASSERT_NULL(chunk);
+        NGREST_ASSERT(pool.getChunkCount() == 1, "Flatten must leave single chunk");
+        NGREST_ASSERT(chunk->size == 96, "Unexpected size after flatten");
+        NGREST_ASSERT(chunk->buffer[0] == '0' && chunk->buffer[32] == '1' && chunk->buffer[95] == '2',
+                      "Data corrupted by flatten");
+        // chunk descriptors are still reserved, but must not own buffers anymore
+        for (int i = 1; i < 5; ++i)
+            NGREST_ASSERT(pool.getChunks()[i].buffer == nullptr,
+                          "Memory of reused chunks is not released by flatten");
+        NGREST_ASSERT(pool.getAllocatedSize() == chunk->bufferSize, "Unexpected allocated size");
+
+        memset(pool.grow(200), 'b', 200);
+        pool.free();
+        NGREST_ASSERT(pool.getAllocatedSize() == 0, "Memory is not released by free");
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // attach test: external data are referenced until reset
+    try {
+        std::cout << "Attach test" << std::endl;
+        std::shared_ptr<std::string> data = std::make_shared<std::string>("attached data");
+        std::weak_ptr<std::string> weakData = data;
+        ngrest::MemPool pool(64);
+        pool.putData("head ", 5);
+        pool.attach(data->data(), data->size(), data);
+        pool.putData(" tail", 5);
+        const char* dataPtr = data->data();
+        data.reset();
+        NGREST_ASSERT(!weakData.expired(), "Attached data must be kept alive");
+        NGREST_ASSERT(pool.getChunkCount() == 3 && pool.getChunks()[1].buffer == dataPtr,
+                      "Attached data must not be copied");
+        NGREST_ASSERT(pool.getSize() == 23, "Unexpected size with attached data");
+
+        const ngrest::MemPool::Chunk* chunk = pool.flatten();
+        NGREST_ASSERT(!strcmp(chunk->buffer, "head attached data tail"), "Data corrupted by flatten");
+
+        pool.reset();
+        NGREST_ASSERT(weakData.expired(), "Attached data must be released on reset");
+
+        // attach into empty pool, then modify
+        data = std::make_shared<std::string>("abc");
+        pool.attach(data->data(), data->size(), data);
+        NGREST_ASSERT(pool.getChunks()->buffer == data->data(), "Empty chunk must be replaced");
+        memcpy(pool.growContiguous(3), "def", 3);
+        NGREST_ASSERT(*data == "abc", "Attached data must not be modified");
+        NGREST_ASSERT(!memcmp(pool.getLastChunk()->buffer, "abcdef", 6), "Data corrupted by growContiguous");
+        pool.free();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All mempool tests passed" << std::endl;
+
+    return 0;
+}
@@ -18,11 +18,15 @@
  *  This file is part of ngrest: http://github.com/loentar/ngrest
  */
 
+#include <atomic>
 #ifdef NGREST_THREAD_LOCK
 #include <chrono>
 #include <thread>
 #endif
 #include <ngrest/utils/Log.h>
+#include <ngrest/utils/Exception.h>
+#include <ngrest/common/HttpMessage.h>
+#include <ngrest/common/ResponseStream.h>
 #include <ngrest/engine/Handler.h>
 
 #include "TestService.h"
@@ -60,6 +64,12 @@ void TestService::echoASync(const std::string& value, ngrest::Callback<const std
 #endif
 }
 
+std::string TestService::echoThreadPool(const std::string& value)
+{
+    // this will be executed from worker thread
+    return "You said " + value;
+}
+
 std::string TestService::largeResponse()
 {
     std::string res;
@@ -67,6 +77,99 @@ std::string TestService::largeResponse()
     return res;
 }
 
+class LargeStreamProducer: public ResponseProducer
+{
+public:
+    LargeStreamProducer(int parts_):
+        parts(parts_)
+    {
+    }
+
+    void produce(ResponseStream* stream) override
+    {
+        if (posted)
+            return; // wait for asynchronous write
+
+        if (!written) {
+            if (!stream->write("{\"result\":\"", 11))
+                return;
+        }
+
+        static const std::string block(1024, '_');
+        while (written < parts) {
+            ++written;
+            if ((written % 8) == 0) {
+                // write every 8th part asynchronously
+                posted = true;
+                Handler::post([this, stream] {
+                    posted = false;
+                    if (aborted) {
+                        delete this;
+                        return;
+                    }
+                    if (stream->write(block.data(), block.size()))
+                        produce(stream);
+                });
+                return;
+            }
+
+            if (!stream->write(block.data(), block.size()))
+                return;
+        }
+
+        stream->write("\"}", 2);
+        stream->finish();
+        delete this;
+    }
+
+    void abort() override
+    {
+        aborted = true;
+        if (!posted)
+            delete this;
+    }
+
+private:
+    const int parts;
+    int written = 0;
+    bool posted = false;
+    bool aborted = false;
+};
+
+void TestService::largeStream(int parts, MessageContext& context)
+{
+    context.response->headers = context.pool->alloc<Header>("Content-Type", "application/json",
+                                                            context.response->headers);
+    context.response->producer = new LargeStreamProducer(parts);
+}
+
+int TestService::cachedCounter()
+{
+    static std::atomic<int> counter(0);
+    return ++counter;
+}
+
+int TestService::versionedCounter()
+{
+    static std::atomic<int> counter(0);
+    return ++counter;
+}
+
+void TestService::coalescedCounter(ngrest::Callback<int>& callback)
+{
+    static std::atomic<int> counter(0);
+    const int value = ++counter;
+    // complete the request later, so identical requests received meanwhile are coalesced
+    Handler::post([&callback, value]{
+        callback.success(value);
+    });
+}
+
+const char* TestService::getVersionTag(const std::string& operation, MessageContext*)
+{
+    return (operation == "versionedCounter") ? "v1" : nullptr;
+}
+
 int TestService::add(int a, int b)
 {
     return a + b;
@@ -162,6 +265,31 @@ std::map<std::string, std::map<std::string, std::string> > TestService::templMap
     return arg;
 }
 
+ngrest::pool::vector<ngrest::pool::string> TestService::templPoolVectorStr(const ngrest::pool::vector<ngrest::pool::string>& arg)
+{
+    NGREST_ASSERT(arg.get_allocator().getPool(), "Request memory pool expected");
+    for (const ngrest::pool::string& item : arg)
+        NGREST_ASSERT(item.get_allocator().getPool(), "Request memory pool expected");
+    return arg;
+}
+
+ngrest::pool::map<ngrest::pool::string, ngrest::pool::list<int>> TestService::templPoolMapStrListInt(const ngrest::pool::map<ngrest::pool::string, ngrest::pool::list<int>>& arg)
+{
+    NGREST_ASSERT(arg.get_allocator().getPool(), "Request memory pool expected");
+    return arg;
+}
+
+ngrest::StringRef TestService::stringRef(ngrest::StringRef arg)
+{
+    // result refers to a part of request
+    return ngrest::StringRef(arg.data(), arg.size() / 2);
+}
+
+std::map<ngrest::StringRef, ngrest::StringRef> TestService::templMapStringRef(const std::map<ngrest::StringRef, ngrest::StringRef>& arg)
+{
+    return arg;
+}
+
 StringMap TestService::testTypedef(const StringMap& arg)
 {
     return arg;
@@ -28,7 +28,10 @@
 #include <ngrest/common/Nullable.h>
 #include <ngrest/common/Service.h>
 #include <ngrest/common/Callback.h>
+#include <ngrest/common/Message.h>
 #include <ngrest/common/ObjectModel.h>
+#include <ngrest/utils/MemPoolAllocator.h>
+#include <ngrest/utils/StringRef.h>
 
 namespace ngrest {
 
@@ -88,9 +91,28 @@ public:
     // *resultElement: resultValue
     std::string echoSync(const std::string& value);
     void echoASync(const std::string& value, ngrest::Callback<const std::string&>& callback);
+    // *threadpool: true
+    std::string echoThreadPool(const std::string& value);
 
     std::string largeResponse();
 
+    // same as largeResponse, but the body is sent by parts: some synchronously, some from the event loop
+    void largeStream(int parts, MessageContext& context);
+
+    // returns number of times the operation was invoked, response is cached for 60 seconds
+    // *cacheTtl: 60
+    int cachedCounter();
+
+    // returns number of times the operation was invoked, resource has version tag "v1"
+    int versionedCounter();
+
+    // returns number of times the operation was invoked, identical concurrent requests share the result
+    // *coalesce: true
+    void coalescedCounter(ngrest::Callback<int>& callback);
+
+    // version tag of versionedCounter
+    virtual const char* getVersionTag(const std::string& operation, MessageContext* context) override;
+
     // default location is: add?a={a}&b={b}
     int add(int a, int b);
     void set(bool val);
@@ -123,6 +145,15 @@ public:
     std::map<std::string, std::string> templMapStr(const std::map<std::string, std::string>& arg);
     std::map<std::string, std::map<std::string, std::string>> templMapStrMapStrStr(const std::map<std::string, std::map<std::string, std::string>>& arg);
 
+    // allocated in request's memory pool
+    ngrest::pool::vector<ngrest::pool::string> templPoolVectorStr(const ngrest::pool::vector<ngrest::pool::string>& arg);
+    ngrest::pool::map<ngrest::pool::string, ngrest::pool::list<int>> templPoolMapStrListInt(const ngrest::pool::map<ngrest::pool::string, ngrest::pool::list<int>>& arg);
+
+    // bound to request buffer
+    // *method: POST
+    ngrest::StringRef stringRef(ngrest::StringRef arg);
+    std::map<ngrest::StringRef, ngrest::StringRef> templMapStringRef(const std::map<ngrest::StringRef, ngrest::StringRef>& arg);
+
     StringMap testTypedef(const StringMap& arg);
     ValType testEnum(ValType arg);
     Test::TestEnum testNestedEnum(Test::TestEnum arg);
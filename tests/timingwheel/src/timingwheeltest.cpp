@@ -0,0 +1,143 @@
+/*
+ *  Copyright 2016 Utkin Dmitry <loentar@gmail.com>
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+/*
+ *  This file is part of ngrest: http://github.com/loentar/ngrest
+ */
+
+#include <iostream>
+#include <vector>
+
+#include <ngrest/utils/Exception.h>
+#include <ngrest/utils/tostring.h>
+
+#include "TimingWheel.h"
+
+namespace {
+
+const uint64_t TICK = 10;
+const uint64_t START = 1000;
+
+struct TestTimer
+{
+    ngrest::Timer timer;
+    uint64_t armedAt = 0;
+    uint64_t timeout = 0;
+    uint64_t firedAt = 0;
+};
+
+// arms timers at the given time and advances the wheel by 1 ms checking every timer fires in time
+void testExpiration(ngrest::TimingWheel& wheel, uint64_t& now, uint64_t armAt,
+                    const std::vector<uint64_t>& timeoutTicks)
+{
+    // move wheel close to the arming time so timers cross level boundaries while expiring
+    wheel.advance(armAt, [](ngrest::Timer*) {
+        NGREST_THROW_ASSERT("No timers expected to be armed");
+    });
+    now = armAt;
+
+    std::vector<TestTimer> timers(timeoutTicks.size());
+    uint64_t last = 0;
+    for (size_t i = 0; i < timers.size(); ++i) {
+        TestTimer& test = timers[i];
+        test.timer.data = &test;
+        test.armedAt = now;
+        // not a multiple of tick to check rounding
+        test.timeout = timeoutTicks[i] * TICK - TICK / 2;
+        if (last < now + test.timeout)
+            last = now + test.timeout;
+        wheel.arm(&test.timer, now, test.timeout);
+    }
+
+    for (; now <= last + TICK; ++now) {
+        wheel.advance(now, [now](ngrest::Timer* timer) {
+            NGREST_ASSERT(!timer->isArmed(), "Expired timer must be disarmed");
+            TestTimer* test = static_cast<TestTimer*>(timer->data);
+            NGREST_ASSERT(!test->firedAt, "Timer fired twice");
+            test->firedAt = now;
+        });
+    }
+
+    for (const TestTimer& test : timers) {
+        const uint64_t expected = test.armedAt + test.timeout;
+        NGREST_ASSERT(test.firedAt, "Timer with timeout " + ngrest::toString(test.timeout) + " did not fire");
+        NGREST_ASSERT(test.firedAt >= expected, "Timer with timeout " + ngrest::toString(test.timeout)
+                      + " fired early: " + ngrest::toString(test.firedAt) + " < " + ngrest::toString(expected));
+        NGREST_ASSERT(test.firedAt < expected + TICK, "Timer with timeout " + ngrest::toString(test.timeout)
+                      + " fired late: " + ngrest::toString(test.firedAt) + " >= "
+                      + ngrest::toString(expected + TICK));
+    }
+}
+
+} // namespace
+
+int main()
+{
+    // every level boundary: 64, 64^2 and 64^3 ticks
+    const std::vector<uint64_t> timeoutTicks = {
+        1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 8200, 262143, 262144, 262145, 300000
+    };
+
+    try {
+        std::cout << "Timing wheel cascading test" << std::endl;
+        ngrest::TimingWheel wheel(START, TICK);
+        uint64_t now = START;
+        testExpiration(wheel, now, START + TICK / 2, timeoutTicks);
+        // arm in the middle of every level's turn
+        testExpiration(wheel, now, now + 4095 * TICK + 3, timeoutTicks);
+        testExpiration(wheel, now, now + 37 * TICK + 7, timeoutTicks);
+    } catch (const ngrest::Exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // wheel is advanced only when event loop wakes up, arming must not count from the last advance
+    try {
+        std::cout << "Timing wheel stale tick test" << std::endl;
+        ngrest::TimingWheel wheel(0, 100);
+        ngrest::Timer timer;
+        int fired = 0;
+        auto callback = [&fired](ngrest::Timer*) {
+            ++fired;
+        };
+
+        wheel.advance(10, callback);
+        wheel.arm(&timer, 950, 1000);
+        wheel.advance(1949, callback);
+        NGREST_ASSERT(!fired, "Timer fired early");
+        wheel.advance(2049, callback);
+        NGREST_ASSERT(fired == 1, "Timer did not fire");
+
+        // re-arming replaces the previous timeout
+        wheel.arm(&timer, 2000, 1000);
+        wheel.arm(&timer, 2500, 1000);
+        wheel.advance(3499, callback);
+        NGREST_ASSERT(fired == 1, "Re-armed timer fired early");
+        wheel.advance(3500, callback);
+        NGREST_ASSERT(fired == 2, "Re-armed timer did not fire");
+
+        wheel.arm(&timer, 4000, 100);
+        wheel.disarm(&timer);
+        wheel.advance(10000, callback);
+        NGREST_ASSERT(fired == 2, "Disarmed timer fired");
+    } catch (const ngrest::Exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    std::cout << "All timing wheel tests passed" << std::endl;
+    return 0;
+}
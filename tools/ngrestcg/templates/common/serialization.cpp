@@ -24,7 +24,11 @@ $($var) ? "true" : "false"\
 ##endif
 );
 ##case string
+##ifeq($(.name),StringRef||string_view)
+    $($node) = context->pool->alloc< ::ngrest::Value>(::ngrest::ValueType::String, context->pool->putCString($($var).data(), $($var).size(), true));
+##else
     $($node) = context->pool->alloc< ::ngrest::Value>(::ngrest::ValueType::String, $($var).c_str());
+##endif
 ##case enum
     $($node) = context->pool->alloc< ::ngrest::Value>(::ngrest::ValueType::String, $(.ns)$(.name.!replace/::/Serializer::/)Serializer::toCString($($var)));
 ##case struct||typedef
@@ -81,7 +85,11 @@ $($var) ? "true" : "false"\
 ##var inlineValue $($name)Item.first ? "true" : "false"
 ##endif
 ##case string
+##ifeq($(.templateParams.templateParam1.name),StringRef||string_view)
+##var inlineValue context->pool->putCString($($name)Item.first.data(), $($name)Item.first.size(), true)
+##else
 ##var inlineValue $($name)Item.first.c_str()
+##endif
 ##case enum
 ##var inlineValue $(.templateParams.templateParam1.ns)$(.templateParams.templateParam1.name.!replace/::/Serializer::/)Serializer::toCString($($name)Item.first)
 ##default
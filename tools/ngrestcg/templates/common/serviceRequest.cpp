@@ -11,6 +11,17 @@
 
 ######### parameters ###########
 \
+######### request-scoped containers ###########
+##var poolScope
+##foreach $(operation.params)
+##ifeq($(param.dataType.ns),ngrest::pool::||::ngrest::pool::)
+##var poolScope 1
+##endif
+##endfor
+##ifneq($($poolScope),)
+        ::ngrest::MemPoolScope poolScope(context->pool);
+##endif
+\
 ######### deserialize request parameters ###########
 ##foreach $(operation.params)
 \
@@ -32,7 +32,11 @@ result ? "true" : "false"\
 ##endif
 );
 ##case string
+##ifeq($(.name),StringRef||string_view)
+        $($resultNodeNode) = context->pool->alloc< ::ngrest::Value>(::ngrest::ValueType::String, context->pool->putCString(result.data(), result.size(), true));
+##else
         $($resultNodeNode) = context->pool->alloc< ::ngrest::Value>(::ngrest::ValueType::String, result.c_str());
+##endif
 ##case enum
         $($resultNodeNode) = context->pool->alloc< ::ngrest::Value>(::ngrest::ValueType::String, $(.ns)$(.name.!replace/::/Serializer::/)Serializer::toCString(result));
 ##case struct||typedef
@@ -89,7 +93,11 @@ result ? "true" : "false"\
 ##var inlineValue it.first ? "true" : "false"
 ##endif
 ##case string
+##ifeq($(.templateParams.templateParam1.name),StringRef||string_view)
+##var inlineValue context->pool->putCString(it.first.data(), it.first.size(), true)
+##else
 ##var inlineValue it.first.c_str()
+##endif
 ##case enum
 ##var inlineValue $(.templateParams.templateParam1.ns)$(.templateParams.templateParam1.name.!replace/::/Serializer::/)Serializer::toCString(it.first)
 ##default
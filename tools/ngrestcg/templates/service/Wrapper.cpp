@@ -13,6 +13,7 @@
 #include <ngrest/common/HttpMethod.h>
 #include <ngrest/common/Service.h>
 #include <ngrest/engine/ServiceDescription.h>
+#include <ngrest/engine/ThreadPool.h>
 ##endif
 #include "$(interface.filePath)$(interface.name)Wrapper.h"
 \
@@ -57,6 +58,12 @@ if (operation->name == "$(operation.name)") {   //  **************** $(operation
 ##include <common/serviceRequest.cpp>
 \
 ######### invoke the service synchronously ###########
+##ifeq($(operation.options.*threadpool),true)
+        // blocking operation: invoke the service in worker thread,
+        // then write response and call callback from the event loop thread
+        ::ngrest::ThreadPool::inst().invoke(context, [=]() mutable -> ::ngrest::Task {
+##indent +
+##endif
 ##ifneq($(operation.return),void)
 ##ifeq($(operation.return.type),struct||typedef||template||string)
         const $(operation.return)& result = \
@@ -83,10 +90,21 @@ $(param.name)\
 ##endfor
 );
 
+##ifeq($(operation.options.*threadpool),true)
+        return [=]() {
+##indent +
+##endif
 ##context $(operation.return)
 ##include <common/serviceResponse.cpp>
 ##endcontext
+##ifeq($(operation.options.*threadpool),true)
+##indent -
+        };
+##indent -
+        });
+##else
         context->callback->success();
+##endif
 \
 \
 ##else                                  //////////// asynchronous ///////////////
@@ -179,12 +197,13 @@ const ::ngrest::ServiceDescription* $(service.name)Wrapper::getDescription() con
 ##var loc
 ##ifneq($(operation.params.$count),0)
 ### generate location for get query
-##var loc $(.name)?
+##var loc $(.name)
 ##var isAmp 0
 ##foreach $(operation.params)
 ##ifneq($(param.dataType.name),Callback||MessageContext)
 ##ifeq($($isAmp),0)
 ##var isAmp 1
+##var loc $($loc)?
 ##else
 ##var loc $($loc)&
 ##endif
@@ -239,7 +258,9 @@ const ::ngrest::ServiceDescription* $(service.name)Wrapper::getDescription() con
 ##endcontext
 , false\
 ##endif
-
+,
+                $(.options.*cacheTtl||"0"), // cacheTtl
+                $(.options.*coalesce||"false") // coalesce
             }\
 ##endfor // operations
 
@@ -313,7 +313,12 @@ public:
                    dataTypeName == "double" ||
                    dataTypeName == "void") {
             dataType.type = DataType::Type::Generic;
-        } else if (dataTypeName == "std::string" || dataTypeName == "std::wstring") {
+        } else if (dataTypeName == "std::string" || dataTypeName == "std::wstring" ||
+                   dataTypeName == "std::string_view" ||
+                   dataTypeName == "ngrest::pool::string" || dataTypeName == "::ngrest::pool::string" ||
+                   dataTypeName == "ngrest::StringRef" || dataTypeName == "::ngrest::StringRef" ||
+                   ((dataTypeName == "pool::string" || dataTypeName == "StringRef")
+                    && currentNs.substr(0, 10) == "::ngrest::")) {
             dataType.type = DataType::Type::String;
         } else if (parseCompositeDataType(interface.typedefs, dataType)) {
             dataType.type = DataType::Type::Typedef;
@@ -789,6 +794,9 @@ public:
                 if (tmp.back() == ';') // to prevent skipping of meta comments after ctor
                     file.unget();
                 ignoreFunction();
+            } else if (tmp == "virtual") {
+                // overridden function of ngrest::Service - not an operation
+                ignoreFunction();
             } else if (tmp == "enum") {
                 // enum -ignore
                 LogWarning() << "Enum in service definition: ignored";